@@ -7,5 +7,6 @@
 #include <Sauce/Common/IniParser.h>
 #include <Sauce/Common/ResourceManager.h>
 #include <Sauce/Common/tinyxml2.h>
+#include <Sauce/Common/WorkerPool.h>
 
 #endif // SAUCE_COMMON_H
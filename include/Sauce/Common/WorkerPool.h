@@ -0,0 +1,57 @@
+#ifndef SAUCE_WORKER_POOL_H
+#define SAUCE_WORKER_POOL_H
+
+#include <Sauce/Config.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+/**
+ * \brief Pool of worker threads for data parallel jobs.
+ *
+ * The threads are created once and sleep between jobs.
+ * The calling thread takes part in every job.
+ */
+class SAUCE_API WorkerPool
+{
+public:
+	/**
+	 * Creates a pool with \p threadCount worker threads.
+	 * 0 creates one thread per hardware thread, minus the calling thread.
+	 */
+	WorkerPool(const uint threadCount = 0);
+	~WorkerPool();
+
+	/**
+	 * Calls \p func(begin, end) over the range [0, \p count), split into chunks of
+	 * \p grainSize elements, on the workers and the calling thread. Returns when every
+	 * chunk is done. Must not be called from several threads at once.
+	 */
+	void parallelFor(const uint count, const uint grainSize, const function<void(uint, uint)> &func);
+
+	/**
+	 * Returns the number of worker threads, not counting the calling thread.
+	 */
+	uint getThreadCount() const { return m_threads.size(); }
+
+private:
+	void workerMain();
+	void runChunks();
+
+	vector<thread> m_threads;
+	mutex m_mutex;
+	condition_variable m_wakeCondition;
+	condition_variable m_doneCondition;
+
+	// Current job
+	const function<void(uint, uint)> *m_func;
+	uint m_count;
+	uint m_grainSize;
+	atomic<uint> m_nextIndex;
+	Uint64 m_jobId;
+	uint m_pendingWorkers;
+	bool m_quit;
+};
+
+END_SAUCE_NAMESPACE
+
+#endif // SAUCE_WORKER_POOL_H
@@ -14,6 +14,11 @@
 #if defined(_DEBUG) && !defined(SAUCE_DEBUG) 
 	#define SAUCE_DEBUG
 #endif
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+	#define SAUCE_USE_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define SAUCE_USE_NEON
+#endif
 
 /*********************************************************************
 **	Library export preprocessor										**
@@ -45,6 +50,8 @@
 	#include <sstream>
 	#include <thread>
 	#include <mutex>
+	#include <condition_variable>
+	#include <atomic>
 	#include <assert.h>
 	#include <fstream>
 	#include <sstream>
@@ -136,7 +143,9 @@ struct GraphicsBackend
 	{
 		SAUCE_OPEN_GL,
 		SAUCE_DIRECT_X,
-		SAUCE_VULKAN
+		SAUCE_VULKAN,
+		SAUCE_NULL,			///< Headless context that discards all work. For benchmarking without a GPU
+		SAUCE_RECORDING		///< Headless context that records all work. See HeadlessContext
 	};
 
 	GraphicsBackend(const Type type = SAUCE_OPEN_GL, const int major = 3, const int minor = 1) :
@@ -176,6 +185,9 @@ namespace util
 	SAUCE_API string boolToStr(const bool);
 	SAUCE_API string asciiToStr(const uchar);
 	
+	// Sort an array of 64-bit keys in ascending order (in-place radix sort)
+	SAUCE_API void radixSort(Uint64 *keys, const uint count);
+
 	// File paths
 	SAUCE_API bool fileExists(string filePath);
 	SAUCE_API string getAbsoluteFilePath(const string &assetPath);
@@ -4,7 +4,10 @@
 #include <Sauce/Math.h>
 #include <Sauce/Graphics/GraphicsContext.h>
 #include <Sauce/Graphics/OpenGL/OpenGLContext.h>
+#include <Sauce/Graphics/Headless/HeadlessContext.h>
 #include <Sauce/Graphics/BlendState.h>
+#include <Sauce/Graphics/CommandBuffer.h>
+#include <Sauce/Graphics/FrameGraph.h>
 #include <Sauce/Graphics/Animation.h>
 #include <Sauce/Graphics/Spritebatch.h>
 #include <Sauce/Graphics/Font.h>
@@ -12,8 +15,10 @@
 #include <Sauce/Graphics/Pixmap.h>
 #include <Sauce/Graphics/Shader.h>
 #include <Sauce/Graphics/Sprite.h>
+#include <Sauce/Graphics/StaticSpriteLayer.h>
 #include <Sauce/Graphics/Texture.h>
 #include <Sauce/Graphics/TextureAtlas.h>
+#include <Sauce/Graphics/AutoAtlas.h>
 #include <Sauce/Graphics/Textureregion.h>
 #include <Sauce/Graphics/Vertex.h>
 #include <Sauce/Graphics/Vertexbuffer.h>
@@ -0,0 +1,136 @@
+#ifndef SAUCE_AUTO_ATLAS_H
+#define SAUCE_AUTO_ATLAS_H
+
+#include <Sauce/Common.h>
+#include <Sauce/Graphics/Texture.h>
+#include <Sauce/Graphics/Pixmap.h>
+#include <Sauce/Graphics/TextureRegion.h>
+
+#include <future>
+
+BEGIN_SAUCE_NAMESPACE
+
+/*********************************************************************
+**	Auto atlas														**
+**********************************************************************/
+
+/**
+ * \brief Packs small textures into shared atlas pages at runtime.
+ *
+ * Textures are queued the first time they are looked up with find(), and packed
+ * with a RectanglePacker on a background thread when update() is called. Until
+ * the pack is done, find() reports the texture as not packed, so the caller keeps
+ * using the original texture. When a page fills up, textures that have not been
+ * used for a while are evicted and the page is repacked. If that's not enough,
+ * the textures go to a new page, and when there is no room for more pages the
+ * least recently used page is cleared. A texture is copied again when its version
+ * changes. Render target textures are never packed, as drawing to them doesn't change it.
+ */
+class SAUCE_API AutoAtlas
+{
+public:
+	AutoAtlas(GraphicsContext *graphicsContext, const uint pageSize = 2048, const uint maxTextureSize = 64, const uint maxPageCount = 4);
+	~AutoAtlas();
+
+	/**
+	 * Looks up where \p region of \p texture is in the atlas.
+	 * Returns the page texture and sets \p pageRegion if the texture is packed. Otherwise
+	 * returns an invalid handle, and queues the texture for packing if it is small enough.
+	 * \param texture Texture to look up.
+	 * \param region Region of the texture. Regions outside [0, 1] are not atlased, as they need texture wrapping.
+	 * \param pageRegion Set to the region in the page texture.
+	 */
+	TextureHandle find(const TextureHandle texture, const TextureRegion &region, TextureRegion &pageRegion);
+
+	/**
+	 * Applies the packs that are done and starts packing the queued textures.
+	 * SpriteBatch calls this in begin().
+	 */
+	void update();
+
+	/**
+	 * Set the number of updates a texture may go unused before it can be evicted from a full page.
+	 */
+	void setEvictionAge(const uint updateCount) { m_evictionAge = updateCount; }
+	uint getEvictionAge() const { return m_evictionAge; }
+
+	uint getPageCount() const { return m_pages.size(); }
+	uint getPageSize() const { return m_pageSize; }
+	uint getMaxTextureSize() const { return m_maxTextureSize; }
+
+private:
+	struct Entry
+	{
+		Entry() :
+			page(-1),
+			packed(false),
+			rejected(false),
+			version(0),
+			lastUsed(0)
+		{
+			texture.value = 0;
+		}
+
+		TextureHandle texture;
+		shared_ptr<Pixmap> pixmap;
+		int page;
+		bool packed;
+		bool rejected;
+		uint version; // Version of the texture when the pixmap was copied
+		TextureRegion region;
+		uint lastUsed;
+	};
+
+	struct PackResult
+	{
+		PackResult() :
+			valid(false)
+		{
+		}
+
+		bool valid;
+		vector<pair<TextureHandle, Rect<uint>>> rectangles;
+		vector<uchar> pixels;
+	};
+
+	struct Page
+	{
+		Page() :
+			packing(false),
+			full(false),
+			dirty(false)
+		{
+		}
+
+		shared_ptr<Texture2D> texture;
+		vector<TextureHandle> textures;
+		future<PackResult> pack;
+		bool packing;
+		bool full;
+		bool dirty;
+	};
+
+	static PackResult packPage(const vector<pair<TextureHandle, shared_ptr<Pixmap>>> &textures, const uint pageSize);
+
+	int getPageForQueuedTexture();
+	void startPack(const uint pageIndex);
+	void applyPack(const uint pageIndex, const PackResult &result);
+	void removeFromPage(const TextureHandle texture);
+
+	GraphicsContext *m_graphicsContext;
+	uint m_pageSize;
+	uint m_maxTextureSize;
+	uint m_maxPageCount;
+	uint m_evictionAge;
+	uint m_updateCount;
+
+	// Entries are keyed by handle value rather than by texture pointer, so a texture
+	// allocated where a deleted one used to be doesn't find the deleted one's entry
+	unordered_map<Uint32, Entry> m_entries;
+	vector<TextureHandle> m_queue;
+	vector<Page> m_pages;
+};
+
+END_SAUCE_NAMESPACE
+
+#endif // SAUCE_AUTO_ATLAS_H
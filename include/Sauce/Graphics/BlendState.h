@@ -39,6 +39,9 @@ public:
 	BlendState(const BlendFactor src, const BlendFactor dst);
 	BlendState(const BlendFactor csrc, const BlendFactor cdst, const BlendFactor asrc, const BlendFactor adst);
 
+	bool operator==(const BlendState &other) const;
+	bool operator!=(const BlendState &other) const;
+
 private:
 	BlendFactor m_src, m_dst, m_alphaSrc, m_alphaDst;
 };
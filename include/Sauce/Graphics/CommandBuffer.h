@@ -0,0 +1,241 @@
+#ifndef SAUCE_COMMAND_BUFFER_H
+#define SAUCE_COMMAND_BUFFER_H
+
+#include <Sauce/Common.h>
+#include <Sauce/Graphics/GraphicsContext.h>
+#include <Sauce/Graphics/BlendState.h>
+#include <Sauce/Graphics/Vertex.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+class Texture2D;
+class Shader;
+class RenderTarget2D;
+class VertexBuffer;
+class IndexBuffer;
+
+/*********************************************************************
+**	Command buffer													**
+**********************************************************************/
+
+/**
+ * \brief Records draw commands to be executed by a GraphicsContext later.
+ *
+ * Draws, state changes and render target pushes are recorded into linear arrays
+ * without touching the graphics context, so a command buffer can be recorded on a
+ * worker thread as long as only one thread records it at a time. execute() must be
+ * called on the thread owning the graphics context.
+ *
+ * Vertex and index data passed to the draw functions are copied into the buffer.
+ * Vertex buffers, index buffers and render targets are referenced, and must stay alive
+ * for as long as the commands are executed. Shaders and textures are kept alive by
+ * the buffer.
+ *
+ * Each draw gets a sort key made of its layer, blend state, shader and texture.
+ * sort() orders the draws by key, grouping draws with the same state to minimize state
+ * changes. Draws are never moved across render target pushes, pops or clears, and draws
+ * with the same key keep their submission order. Once recorded (and sorted), a buffer
+ * can be executed any number of times, so static passes can be recorded once.
+ */
+class SAUCE_API CommandBuffer
+{
+public:
+	CommandBuffer();
+
+	/**
+	 * Set the shader of the draws recorded after this call.
+	 * \param shader Shader to draw with. If null, the default shader is used.
+	 */
+	void setShader(shared_ptr<Shader> shader);
+
+	/**
+	 * Set the texture of the draws recorded after this call.
+	 */
+	void setTexture(shared_ptr<Texture2D> texture);
+
+	/**
+	 * Set the blend state of the draws recorded after this call.
+	 */
+	void setBlendState(const BlendState &blendState);
+
+	/**
+	 * Set the transformation matrix of the draws recorded after this call.
+	 * The matrix is multiplied with the top of the context's matrix stack when executed.
+	 */
+	void setTransformationMatrix(const Matrix4 &matrix);
+
+	/**
+	 * Set the layer of the draws recorded after this call.
+	 * Draws on lower layers are drawn first when the buffer is sorted.
+	 */
+	void setLayer(const uchar layer);
+
+	/**
+	 * Records a render target push. Everything recorded until the matching
+	 * popRenderTarget() is rendered to \p renderTarget.
+	 */
+	void pushRenderTarget(RenderTarget2D *renderTarget);
+	void popRenderTarget();
+
+	/**
+	 * Records a clear of the current render target.
+	 * \param mask Decides what channels in the back buffer to clear.
+	 * \param fillColor Decides what value to clear to.
+	 */
+	void clear(const uint mask, const Color &fillColor = Color(0, 0, 0, 0));
+
+	/**
+	 * Records primitives drawn from interleaved vertex data. The data is copied.
+	 * \param type Types of primitives to render.
+	 * \param fmt Format of the vertex data.
+	 * \param vertexData Vertex data, tightly packed as described by \p fmt.
+	 * \param vertexCount Number of vertices to render.
+	 */
+	void drawPrimitives(const GraphicsContext::PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount);
+
+	/**
+	 * Records an indexed primitive drawn from interleaved vertex data. The data is copied.
+	 * \param type Types of primitives to render.
+	 * \param fmt Format of the vertex data.
+	 * \param vertexData Vertex data, tightly packed as described by \p fmt.
+	 * \param vertexCount Number of vertices.
+	 * \param indices Array of indices.
+	 * \param indexCount Number of indices.
+	 */
+	void drawIndexedPrimitives(const GraphicsContext::PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount, const uint *indices, const uint indexCount);
+
+	/**
+	 * Records primitives drawn from a vertex buffer.
+	 * \param type Types of primitives to render.
+	 * \param vbo Vertex buffer object.
+	 */
+	void drawPrimitives(const GraphicsContext::PrimitiveType type, const VertexBuffer *vbo);
+
+	/**
+	 * Records a range of an index buffer drawn from a vertex buffer.
+	 * \param type Types of primitives to render.
+	 * \param vbo Vertex buffer object.
+	 * \param ibo Index buffer object.
+	 * \param indexStart First index to render.
+	 * \param indexCount Number of indices to render.
+	 */
+	void drawIndexedPrimitives(const GraphicsContext::PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo, const uint indexStart, const uint indexCount);
+
+	/**
+	 * Sorts the draws by their sort keys. Draws are only reordered between
+	 * render target pushes, pops and clears.
+	 */
+	void sort();
+
+	/**
+	 * Executes the commands with \p graphicsContext. The state of the context
+	 * is restored afterwards. The commands are kept, so they can be executed again.
+	 */
+	void execute(GraphicsContext *graphicsContext) const;
+
+	/**
+	 * Removes all commands and resets the recording state.
+	 */
+	void reset();
+
+	/**
+	 * Returns the number of recorded commands.
+	 */
+	uint getCommandCount() const { return m_commands.size(); }
+
+	/**
+	 * Returns the sort key of command \p index, in recording order.
+	 * Commands that are not draws have a key of 0.
+	 */
+	Uint64 getSortKey(const uint index) const;
+
+	// Max number of commands that can be sorted
+	static const uint MAX_SORTED_COMMANDS = 1 << 24;
+
+private:
+	enum CommandType
+	{
+		DRAW,
+		DRAW_INDEXED,
+		DRAW_BUFFER,
+		DRAW_INDEXED_BUFFER,
+		PUSH_RENDER_TARGET,
+		POP_RENDER_TARGET,
+		CLEAR
+	};
+
+	struct Command
+	{
+		Command() :
+			type(DRAW),
+			primitiveType(GraphicsContext::PRIMITIVE_TRIANGLES),
+			layer(0),
+			shader(0),
+			texture(0),
+			blendState(0),
+			transform(0),
+			format(0),
+			vertexOffset(0),
+			vertexCount(0),
+			indexOffset(0),
+			indexCount(0),
+			vertexBuffer(nullptr),
+			indexBuffer(nullptr),
+			renderTarget(nullptr),
+			clearMask(0)
+		{
+		}
+
+		CommandType type;
+		GraphicsContext::PrimitiveType primitiveType;
+		uchar layer;
+
+		// Indices into the state tables
+		uint shader;
+		uint texture;
+		uint blendState;
+		uint transform;
+		uint format;
+
+		// Ranges of the vertex and index data, or of the index buffer
+		uint vertexOffset;
+		uint vertexCount;
+		uint indexOffset;
+		uint indexCount;
+
+		const VertexBuffer *vertexBuffer;
+		const IndexBuffer *indexBuffer;
+		RenderTarget2D *renderTarget;
+		uint clearMask;
+		Color clearColor;
+	};
+
+	Command &addDraw(const CommandType type, const GraphicsContext::PrimitiveType primitiveType);
+	uint addFormat(const VertexFormat &fmt);
+	static bool isDraw(const Command &command);
+
+	vector<Command> m_commands;
+	vector<uint> m_order;
+
+	// State tables. Commands refer to states by index
+	vector<shared_ptr<Shader>> m_shaders;
+	vector<shared_ptr<Texture2D>> m_textures;
+	vector<BlendState> m_blendStates;
+	vector<Matrix4> m_transforms;
+	vector<VertexFormat> m_formats;
+
+	// Vertex and index data of the draws
+	vector<char> m_vertexData;
+	vector<uint> m_indices;
+
+	// Recording state
+	uint m_shader;
+	uint m_texture;
+	uint m_blendState;
+	uint m_transform;
+	uchar m_layer;
+};
+
+END_SAUCE_NAMESPACE
+
+#endif // SAUCE_COMMAND_BUFFER_H
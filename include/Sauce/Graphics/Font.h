@@ -2,6 +2,7 @@
 #define SAUCE_FONT_H
 
 #include <Sauce/Common.h>
+#include <Sauce/Graphics/Sprite.h>
 
 BEGIN_SAUCE_NAMESPACE
 
@@ -147,6 +148,9 @@ protected:
 
 	map<int, CharDescr*> m_chars;
 	vector<shared_ptr<Texture2D>> m_pages;
+
+	// Glyphs of the page being drawn in drawInternal()
+	vector<GlyphQuad> m_glyphs;
 };
 
 template SAUCE_API class shared_ptr<Font>;
@@ -0,0 +1,261 @@
+#ifndef SAUCE_FRAME_GRAPH_H
+#define SAUCE_FRAME_GRAPH_H
+
+#include <Sauce/Common.h>
+#include <Sauce/Graphics/GraphicsContext.h>
+#include <Sauce/Graphics/Pixmap.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+class RenderTarget2D;
+
+/*********************************************************************
+**	Frame graph														**
+**********************************************************************/
+
+/**
+ * \brief Orders and executes render target passes declared up front.
+ *
+ * Each pass declares the render targets it reads and the render target it writes, and
+ * is given a function that draws the pass. compile() orders the passes so that every
+ * pass runs after the passes writing the targets it reads. Passes writing the same target
+ * keep their declaration order. A pass that draws on top of what earlier passes wrote must
+ * also read the target.
+ *
+ * Passes whose output is never used are culled. A pass is kept if it writes no target
+ * (it draws to the current render target, usually the screen), if it writes an imported
+ * target or a target marked with setOutput(), or if a kept pass reads what it writes.
+ *
+ * Transient targets created with createRenderTarget() only exist while they are in use.
+ * Targets with the same size and pixel format whose lifetimes don't overlap share the same
+ * RenderTarget2D, and the render targets are pooled across frames. The contents of a
+ * transient target are undefined when it is first written, so the first pass writing it
+ * should clear it.
+ *
+ * compile() does not touch the graphics context, so the ordering, culling and aliasing
+ * can be inspected without a GPU. A frame graph is typically reset and declared again
+ * every frame, which is cheap as the render targets stay in the pool.
+ */
+class SAUCE_API FrameGraph
+{
+public:
+	typedef function<void(GraphicsContext*)> PassFunction;
+
+	FrameGraph();
+	~FrameGraph();
+
+	/**
+	 * Declares a transient render target.
+	 * \param name Name of the target. Used in error messages.
+	 * \param width Width of the target.
+	 * \param height Height of the target.
+	 * \param fmt Pixel format of the target.
+	 * \return Index of the target.
+	 */
+	uint createRenderTarget(const string &name, const uint width, const uint height, const PixelFormat &fmt = PixelFormat());
+
+	/**
+	 * Declares a render target owned by the caller. Passes writing it are never culled.
+	 * \return Index of the target.
+	 */
+	uint importRenderTarget(const string &name, RenderTarget2D *renderTarget);
+
+	/**
+	 * Declares a pass.
+	 * \param name Name of the pass. Used in error messages.
+	 * \param function Function drawing the pass. The target the pass writes is
+	 * pushed on the graphics context while it is called.
+	 * \return Index of the pass.
+	 */
+	uint addPass(const string &name, PassFunction function);
+
+	/**
+	 * Declares that \p pass reads render target \p renderTarget.
+	 */
+	void read(const uint pass, const uint renderTarget);
+
+	/**
+	 * Declares that \p pass writes render target \p renderTarget. A pass writes at most one target.
+	 */
+	void write(const uint pass, const uint renderTarget);
+
+	/**
+	 * Keeps the passes writing transient target \p renderTarget, even if no pass reads it.
+	 * The target is not shared with other targets, so it can be read after execute().
+	 */
+	void setOutput(const uint renderTarget);
+
+	/**
+	 * Orders the passes, culls the unused ones and assigns the transient targets to render targets.
+	 * Returns false if the passes depend on each other in a cycle.
+	 */
+	bool compile();
+
+	/**
+	 * Executes the passes in order, compiling the graph first if needed.
+	 */
+	void execute(GraphicsContext *graphicsContext);
+
+	/**
+	 * Removes the passes and targets. The pooled render targets are kept.
+	 */
+	void reset();
+
+	/**
+	 * Returns the render target of \p renderTarget. Transient targets only have a render
+	 * target from execute() until the graph is reset, and if they are used. After execute()
+	 * only the contents of targets marked with setOutput() are defined.
+	 */
+	RenderTarget2D *getRenderTarget(const uint renderTarget) const;
+
+	/**
+	 * Returns the passes in execution order, without the culled passes. Valid after compile().
+	 */
+	const vector<uint> &getExecutionOrder() const { return m_order; }
+
+	/**
+	 * Returns true if \p pass was culled. Valid after compile().
+	 */
+	bool isCulled(const uint pass) const { return m_passes[pass].culled; }
+
+	/**
+	 * Returns the index of the render target \p renderTarget is assigned to, or -1
+	 * if it is not used. Transient targets with the same index share a render target.
+	 * Valid after compile().
+	 */
+	int getPhysicalTarget(const uint renderTarget) const { return m_renderTargets[renderTarget].physicalTarget; }
+
+	struct Statistics
+	{
+		Statistics() :
+			passCount(0),
+			culledPassCount(0),
+			transientTargetCount(0),
+			physicalTargetCount(0),
+			transientBytes(0),
+			physicalBytes(0),
+			pooledTargetCount(0)
+		{
+		}
+
+		uint passCount;
+		uint culledPassCount;
+		uint transientTargetCount;	///< Transient targets used by the passes that were kept
+		uint physicalTargetCount;	///< Render targets the transient targets were assigned to
+		uint transientBytes;		///< Size of the transient targets without aliasing
+		uint physicalBytes;			///< Size of the render targets they were assigned to
+		uint pooledTargetCount;		///< Render targets in the pool
+	};
+
+	/**
+	 * Returns the statistics of the last compile.
+	 */
+	const Statistics &getStatistics() const { return m_statistics; }
+
+	/**
+	 * Set the number of frames a pooled render target may go unused before it is deleted.
+	 */
+	void setEvictionAge(const uint frameCount) { m_evictionAge = frameCount; }
+	uint getEvictionAge() const { return m_evictionAge; }
+
+private:
+	struct TargetDesc
+	{
+		TargetDesc(const uint width, const uint height, const PixelFormat &fmt) :
+			width(width),
+			height(height),
+			components(fmt.getComponents()),
+			dataType(fmt.getDataType())
+		{
+		}
+
+		bool operator<(const TargetDesc &other) const;
+		uint getSizeInBytes() const;
+
+		uint width;
+		uint height;
+		PixelFormat::Components components;
+		PixelFormat::DataType dataType;
+	};
+
+	struct Target
+	{
+		Target(const string &name, const TargetDesc &desc) :
+			name(name),
+			desc(desc),
+			imported(nullptr),
+			output(false),
+			physicalTarget(-1),
+			firstUse(-1),
+			lastUse(-1)
+		{
+		}
+
+		string name;
+		TargetDesc desc;
+		RenderTarget2D *imported;
+		bool output;
+		vector<uint> writers; // In declaration order
+
+		// Set by compile()
+		int physicalTarget;
+		int firstUse;
+		int lastUse;
+	};
+
+	struct Pass
+	{
+		Pass(const string &name, PassFunction function) :
+			name(name),
+			function(function),
+			write(-1),
+			culled(false)
+		{
+		}
+
+		string name;
+		PassFunction function;
+		vector<uint> reads;
+		int write;
+		bool culled;
+	};
+
+	struct PhysicalTarget
+	{
+		PhysicalTarget(const TargetDesc &desc) :
+			desc(desc),
+			renderTarget(nullptr)
+		{
+		}
+
+		TargetDesc desc;
+		RenderTarget2D *renderTarget; // Set by execute()
+	};
+
+	struct PooledTarget
+	{
+		RenderTarget2D *renderTarget;
+		uint lastUsed;
+	};
+
+	bool orderPasses();
+	void cullPasses();
+	void assignPhysicalTargets();
+
+	vector<Target> m_renderTargets;
+	vector<Pass> m_passes;
+	vector<uint> m_order;
+	vector<PhysicalTarget> m_physicalTargets;
+	bool m_compiled;
+	Statistics m_statistics;
+
+	// Render targets kept across frames. The first targets of each desc are handed out first,
+	// so the unused ones are at the back
+	map<TargetDesc, vector<PooledTarget>> m_pool;
+	uint m_frame;
+	uint m_evictionAge;
+};
+
+END_SAUCE_NAMESPACE
+
+#endif // SAUCE_FRAME_GRAPH_H
@@ -5,13 +5,15 @@
 #include <Sauce/Graphics/Shader.h>
 #include <Sauce/Graphics/BlendState.h>
 #include <Sauce/Graphics/TextureRegion.h>
+#include <Sauce/Graphics/Vertex.h>
 
 BEGIN_SAUCE_NAMESPACE
 
-class Vertex;
+struct SpriteInstance;
 class RenderTarget2D;
 class VertexBuffer;
 class IndexBuffer;
+class StaticIndexBuffer;
 
 /**
  * \brief Handles primitive rendering to the screen.
@@ -20,6 +22,8 @@ class SAUCE_API GraphicsContext
 {
 	friend class Game;
 	friend class Window;
+	friend class VertexBuffer;
+	friend class IndexBuffer;
 public:
 
 	// State
@@ -28,25 +32,40 @@ public:
 		State() :
 			width(0),
 			height(0),
-			texture(nullptr),
-			shader(nullptr),
+			texture(0),
+			shader(0),
+			projection(0),
 			blendState(BlendState::PRESET_ALPHA_BLEND),
-			renderTarget(nullptr)
+			renderTarget(nullptr),
+			matrixBase(1),
+			matrixTop(0)
 		{
-			transformationMatrixStack.push(Matrix4());
 		}
 
 		uint width;
 		uint height;
-		shared_ptr<Texture2D> texture;
-		shared_ptr<Shader> shader;
+
+		// Slots of the texture, shader and projection matrix in the context's stacks of them.
+		// A state shares the slot of the state below until it sets a value of its own
+		uint texture;
+		uint shader;
+		uint projection;
+
 		BlendState blendState;
 		RenderTarget2D *renderTarget;
-		stack<Matrix4> transformationMatrixStack;
-		Matrix4 projectionMatrix;
+
+		// The transformation matrices live in the context's matrix stack. A state owns
+		// the slots from matrixBase and up, and shares the slots below with the states under it
+		uint matrixBase;
+		uint matrixTop; // Slot of the top matrix
 	};
 
 	// TODO: For every set*, add a push*/pop* which uses the state stack
+	/**
+	 * Pushes a copy of the current state. Pushing and popping states is O(1),
+	 * doesn't allocate once the stacks have grown to the depth used, and doesn't
+	 * copy the texture, shader or matrices of the state.
+	 */
 	void pushState();
 	void popState();
 
@@ -90,7 +109,7 @@ public:
 	 */
 	RenderTarget2D *getRenderTarget() const
 	{
-		return m_stateStack.top().renderTarget;
+		return m_currentState->renderTarget;
 	}
 	
 	/**
@@ -109,6 +128,12 @@ public:
 	* Gets the top transformation matrix
 	*/
 	Matrix4 topMatrix() const;
+
+	/**
+	 * Returns the projection matrix multiplied with the top transformation matrix.
+	 * The product is cached until either of the matrices changes.
+	 */
+	const Matrix4 &getModelViewProjectionMatrix();
 	
 	/**
 	 *	Clear matrix stack
@@ -125,7 +150,10 @@ public:
 	/**
 	 * Gets the current texture.
 	 */
-	shared_ptr<Texture2D> getTexture() const;
+	const shared_ptr<Texture2D> &getTexture() const
+	{
+		return m_textureStack[m_currentState->texture];
+	}
 
 	/**
 	 * Set shader. Every vertex and fragment rendered after this will
@@ -137,7 +165,10 @@ public:
 	/**
 	 * Returns the current shader.
 	 */
-	shared_ptr<Shader> getShader() const;
+	const shared_ptr<Shader> &getShader() const
+	{
+		return m_shaderStack[m_currentState->shader];
+	}
 
 	/**
 	 * Set blend state. Every pixel rendered after this will use a 
@@ -163,12 +194,20 @@ public:
 	 */
 	void setProjectionMatrix(const Matrix4 matrix);
 
+	/**
+	 * Returns the projection matrix
+	 */
+	const Matrix4 &getProjectionMatrix() const
+	{
+		return m_projectionStack[m_currentState->projection];
+	}
+
 	/**
 	 * Returns the width of the viewport.
 	 */
 	uint getWidth() const
 	{
-		return m_stateStack.top().width;
+		return m_currentState->width;
 	}
 
 	/**
@@ -176,7 +215,7 @@ public:
 	 */
 	uint getHeight() const
 	{
-		return m_stateStack.top().height;
+		return m_currentState->height;
 	}
 
 	/**
@@ -184,7 +223,7 @@ public:
 	*/
 	Vector2I getSize() const
 	{
-		return Vector2I(m_stateStack.top().width, m_stateStack.top().height);
+		return Vector2I(m_currentState->width, m_currentState->height);
 	}
 
 	/**
@@ -247,7 +286,7 @@ public:
 	 * Renders a circle.
 	 * \param pos Center of the circle.
 	 * \param radius Radius of the circle.
-	 * \param segments Number of triangle segments to divide the circle into.
+	 * \param segments Number of triangle segments to divide the circle into, or AUTO_SEGMENTS.
 	 * \param color %Color of the circle.
 	 */
 	void drawCircleGradient(const Vector2F &pos, const float radius, const uint segments, const Color &center = Color::White, const Color &outer = Color::White);
@@ -258,12 +297,43 @@ public:
 	 * \param x Center x position of the circle.
 	 * \param y Center y position of the circle.
 	 * \param radius Radius of the circle.
-	 * \param segments Number of triangle segments to divide the circle into.
+	 * \param segments Number of triangle segments to divide the circle into, or AUTO_SEGMENTS.
 	 * \param color %Color of the circle.
 	 */
 	void drawCircleGradient(const float x, const float y, const float radius, const uint segments, const Color &center = Color::White, const Color &outer = Color::White);
 	void drawCircle(const float x, const float y, const float radius, const uint segments, const Color &color = Color::White);
 
+	/**
+	 * Pass as the segment count of the curved shapes to pick it from the radius on screen.
+	 */
+	static const uint AUTO_SEGMENTS = 0;
+
+	/**
+	 * Renders a rectangle with rounded corners.
+	 * \param x Left x position of the rectangle.
+	 * \param y Top y position of the rectangle.
+	 * \param width Width of the rectangle.
+	 * \param height Height of the rectangle.
+	 * \param radius Radius of the corners. Clamped to half the width and height.
+	 * \param segments Number of segments of a full circle of the corners, or AUTO_SEGMENTS.
+	 * \param color %Color of the rectangle.
+	 */
+	void drawRoundedRectangle(const float x, const float y, const float width, const float height, const float radius, const uint segments, const Color &color = Color::White);
+	void drawRoundedRectangle(const Rect<float> &rect, const float radius, const uint segments, const Color &color = Color::White);
+
+	/**
+	 * Renders an arc of a circle outline.
+	 * \param x Center x position of the circle.
+	 * \param y Center y position of the circle.
+	 * \param radius Radius of the circle.
+	 * \param startAngle Angle to start the arc at, in radians.
+	 * \param endAngle Angle to end the arc at, in radians.
+	 * \param segments Number of segments of the full circle, or AUTO_SEGMENTS.
+	 * \param color %Color of the arc.
+	 */
+	void drawArc(const float x, const float y, const float radius, const float startAngle, const float endAngle, const uint segments, const Color &color = Color::White);
+	void drawArc(const Vector2F &pos, const float radius, const float startAngle, const float endAngle, const uint segments, const Color &color = Color::White);
+
 	/**
 	 * Draws an arrow from a starting point to an ending point.
 	 * \param x0 Starting x-coordinate
@@ -275,6 +345,26 @@ public:
 	void drawArrow(const float x0, const float y0, const float x1, const float y1, const Color &color = Color::White);
 	void drawArrow(const Vector2F p0, const Vector2F p1, const Color &color = Color::White) { drawArrow(p0.x, p0.y, p1.x, p1.y, color); }
 
+	/**
+	 * Draws the primitives batched by the draw functions above.
+	 *
+	 * drawRectangle, drawRectangleOutline, drawCircle, drawCircleGradient, drawRoundedRectangle,
+	 * drawArc and drawArrow append their vertices to a batch instead of drawing right away. Consecutive shapes
+	 * drawn with the same texture, shader, blend state, matrices and render target share
+	 * one batch, with strips and fans converted to indexed triangles. The batch is drawn
+	 * when a shape is drawn with a different state, before any other draw, clear or GL
+	 * state change, before a uniform of its shader or the contents or sampling of its
+	 * texture change, and at the end of the frame. Call this before touching GL directly.
+	 */
+	void flushPrimitives();
+
+	/**
+	 * Enables or disables the batching of the shape draw functions. Enabled by default.
+	 * When disabled, every shape is drawn with its own draw call.
+	 */
+	void setPrimitiveBatchingEnabled(const bool enabled);
+	bool isPrimitiveBatchingEnabled() const { return m_primitiveBatchingEnabled; }
+
 	void *getSDLHandle() const
 	{
 		return m_context;
@@ -282,6 +372,14 @@ public:
 
 	Vertex *getVertices(const uint vertexCount);
 
+	/**
+	 * Returns a static index buffer of quad indices, where quad i uses vertices [4i, 4i + 4).
+	 * The buffer is shared by all batches and grown on demand to hold at least \p quadCount quads,
+	 * so quad geometry only needs to upload vertex data.
+	 * \param quadCount Number of quads the buffer needs to index.
+	 */
+	const IndexBuffer *getQuadIndexBuffer(const uint quadCount);
+
 protected:
 	GraphicsContext();
 	virtual ~GraphicsContext();
@@ -289,13 +387,87 @@ protected:
 	void *m_context;
 	Window *m_window;
 
-	stack<State> m_stateStack;
+	// Transformation matrix stack slot. Slots are linked to the slot below them,
+	// as the matrices of a state are not always right above those of the state below
+	struct MatrixStackEntry
+	{
+		Matrix4 matrix;
+		uint previous;
+	};
+
+	// The stacks are contiguous arrays which only grow. Slot 0 of the
+	// matrix stack is the identity matrix at the bottom of every state
+	vector<State> m_stateStack;
+	uint m_stateDepth;
 	State *m_currentState;
+	vector<MatrixStackEntry> m_matrixStack;
+	uint m_matrixCount;
+
+	// A state takes at most one slot in each of these stacks, so they are as large as the state
+	// stack. Slot 0 belongs to the bottom state. Only setting a value touches the shared_ptrs
+	vector<shared_ptr<Texture2D>> m_textureStack;
+	uint m_textureCount;
+	vector<shared_ptr<Shader>> m_shaderStack;
+	uint m_shaderCount;
+	vector<Matrix4> m_projectionStack;
+	uint m_projectionCount;
+
+	Matrix4 m_modelViewProjection;
+	bool m_modelViewProjectionDirty;
 
 	vector<Vertex> m_vertices; // Vertices for when needed
+	vector<VertexPCT> m_shapeVertices; // Vertices for the shapes with a variable vertex count
+	vector<float> m_shapePositions; // Positions of the shape vertices, as x, y pairs
+
+	/**
+	 * Returns the points of a unit circle divided into \p segments segments, as segments + 1
+	 * cos, sin pairs. The last point is the first one again. The tables of the counts
+	 * AUTO_SEGMENTS picks are computed once. Other tables are valid until the next call.
+	 */
+	const float *getUnitCircle(const uint segments);
+
+	/**
+	 * Returns \p segments, or the segment count of a circle of \p radius
+	 * on screen if \p segments is AUTO_SEGMENTS.
+	 */
+	uint getSegmentCount(const float radius, const uint segments);
+
+	unordered_map<uint, vector<float>> m_unitCircles;
+	vector<float> m_unitCircleScratch; // Table of the last segment count that isn't cached
+	vector<char> m_packedVertices; // Vertex data packed by the Vertex overloads of the draw functions
+
+	// Batch of shapes waiting to be drawn, and the state they were drawn with
+	struct PrimitiveBatch
+	{
+		PrimitiveBatch() :
+			type(PRIMITIVE_TRIANGLES),
+			blendState(BlendState::PRESET_ALPHA_BLEND),
+			renderTarget(nullptr)
+		{
+		}
+
+		PrimitiveType type; // PRIMITIVE_TRIANGLES or PRIMITIVE_LINES
+		shared_ptr<Texture2D> texture;
+		shared_ptr<Shader> shader;
+		BlendState blendState;
+		RenderTarget2D *renderTarget;
+		Matrix4 transformationMatrix;
+		Matrix4 projectionMatrix;
+		vector<VertexPCT> vertices;
+		vector<uint> indices;
+	};
+
+	void batchPrimitives(const PrimitiveType type, const VertexPCT *vertices, const uint vertexCount);
+
+	PrimitiveBatch m_primitiveBatch;
+	vector<VertexPCT> m_flushVertices; // The batch is moved here while it is drawn
+	vector<uint> m_flushIndices;
+	bool m_primitiveBatchingEnabled;
 
 	static shared_ptr<Shader> s_defaultShader;
 	static shared_ptr<Texture2D> s_defaultTexture;
+	StaticIndexBuffer *m_quadIndexBuffer; // Deleted by the backend, as deleting it calls its buffer functions
+	uint m_quadIndexBufferCapacity;
 
 public:
 	/**
@@ -385,13 +557,26 @@ public:
 	
 	/**
 	 * Renders an indexed primitive to the screen.
+	 * Packs the vertices and draws them with the interleaved vertex data overload.
 	 * \param type Types of primitives to render.
 	 * \param vertices Array of vertices to render.
 	 * \param vertexCount Number of vertices to render.
 	 * \param indices Array of indices.
 	 * \param indexCount Number of indices.
 	 */
-	virtual void drawIndexedPrimitives(const PrimitiveType type, const Vertex *vertices, const uint vertexCount, const uint *indices, const uint indexCount) = 0;
+	void drawIndexedPrimitives(const PrimitiveType type, const Vertex *vertices, const uint vertexCount, const uint *indices, const uint indexCount);
+
+	/**
+	 * Renders an indexed primitive to the screen from interleaved vertex data.
+	 * The data is uploaded as it is, so arrays of POD vertices like VertexPCT can be drawn without copying.
+	 * \param type Types of primitives to render.
+	 * \param fmt Format of the vertex data.
+	 * \param vertexData Vertex data, tightly packed as described by \p fmt.
+	 * \param vertexCount Number of vertices to render.
+	 * \param indices Array of indices.
+	 * \param indexCount Number of indices.
+	 */
+	virtual void drawIndexedPrimitives(const PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount, const uint *indices, const uint indexCount) = 0;
 
 	/**
 	 * Renders an indexed primitive to the screen using vertex and index buffers.
@@ -401,13 +586,34 @@ public:
 	 */
 	virtual void drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo) = 0;
 
+	/**
+	 * Renders a range of an index buffer to the screen using vertex and index buffers.
+	 * \param type Types of primitives to render.
+	 * \param vbo Vertex buffer object.
+	 * \param ibo Index buffer object.
+	 * \param indexStart First index to render.
+	 * \param indexCount Number of indices to render.
+	 */
+	virtual void drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo, const uint indexStart, const uint indexCount) = 0;
+
 	/**
 	 * Renders primitives to the screen.
+	 * Packs the vertices and draws them with the interleaved vertex data overload.
 	 * \param type Types of primitives to render.
 	 * \param vertices Array of vertices to render.
 	 * \param vertexCount Number of vertices to render.
 	 */
-	virtual void drawPrimitives(const PrimitiveType type, const Vertex *vertices, const uint vertexCount) = 0;
+	void drawPrimitives(const PrimitiveType type, const Vertex *vertices, const uint vertexCount);
+
+	/**
+	 * Renders primitives to the screen from interleaved vertex data.
+	 * The data is uploaded as it is, so arrays of POD vertices like VertexPCT can be drawn without copying.
+	 * \param type Types of primitives to render.
+	 * \param fmt Format of the vertex data.
+	 * \param vertexData Vertex data, tightly packed as described by \p fmt.
+	 * \param vertexCount Number of vertices to render.
+	 */
+	virtual void drawPrimitives(const PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount) = 0;
 
 	/**
 	 * Renders primitives to the screen.
@@ -416,6 +622,32 @@ public:
 	 */
 	virtual void drawPrimitives(const PrimitiveType type, const VertexBuffer *vbo) = 0;
 
+	/**
+	 * Returns true if drawSpriteInstances() is supported by this context.
+	 */
+	virtual bool isInstancingSupported() const = 0;
+
+	/**
+	 * Renders textured sprite quads from instance records.
+	 * The quads are expanded on the GPU by the built-in sprite instancing shader,
+	 * which is used in place of the current shader.
+	 * \param instances Array of sprite instances to render.
+	 * \param instanceCount Number of instances to render.
+	 */
+	virtual void drawSpriteInstances(const SpriteInstance *instances, const uint instanceCount) = 0;
+
+	/**
+	 * Returns the number of texture slots of the multi-texture shader, or 0 if there is no such shader.
+	 */
+	virtual uint getTextureSlotCount() const = 0;
+
+	/**
+	 * Returns the built-in multi-texture shader. It has one sampler per texture slot,
+	 * named u_Texture0, u_Texture1, ..., and draws VertexPCTS vertices, where the
+	 * third texture coordinate is the slot to sample.
+	 */
+	virtual shared_ptr<Shader> getMultiTextureShader() const = 0;
+
 	virtual Texture2D *createTexture(const Pixmap &pixmap) = 0;
 	Texture2D *createTexture(const uint width, const uint height, const void *data = 0, const PixelFormat &format = PixelFormat());
 	Texture2D *createTexture(const PixelFormat &format = PixelFormat());
@@ -424,8 +656,29 @@ public:
 	virtual Shader *createShader(const string &vertexSource, const string &fragmentSource, const string &geometrySource) = 0;
 	virtual RenderTarget2D *createRenderTarget(const uint width, const uint height, const uint targetCount = 1, const PixelFormat &fmt = PixelFormat()) = 0;
 
+	/**
+	 * Shows the frame drawn to the window and clears the back buffer for the next one.
+	 * Called by Game at the end of every frame.
+	 */
+	virtual void swapBuffers() = 0;
+
 protected:
 	virtual Window *createWindow(const string &title, const int x, const int y, const int w, const int h, const Uint32 flags) = 0;
+
+	/**
+	 * Buffer storage of VertexBuffer and IndexBuffer. Buffers are referred
+	 * to by the id returned by createBuffer(), which is never 0.
+	 */
+	enum BufferTarget
+	{
+		VERTEX_BUFFER_TARGET,
+		INDEX_BUFFER_TARGET
+	};
+
+	virtual uint createBuffer() = 0;
+	virtual void deleteBuffer(const uint buffer) = 0;
+	virtual void setBufferData(const BufferTarget target, const uint buffer, const void *data, const uint size, const bool dynamic) = 0;
+	virtual void setBufferSubData(const BufferTarget target, const uint buffer, const uint offset, const void *data, const uint size) = 0;
 };
 
 END_SAUCE_NAMESPACE
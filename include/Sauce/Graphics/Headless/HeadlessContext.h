@@ -0,0 +1,267 @@
+#pragma once
+
+#include <Sauce/Common.h>
+#include <Sauce/Graphics/GraphicsContext.h>
+#include <Sauce/Graphics/Shader.h>
+#include <Sauce/Graphics/Texture.h>
+#include <Sauce/Graphics/RenderTarget.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+class HeadlessContext;
+
+/**
+ * \brief Texture without GPU storage. Keeps its pixels in memory.
+ */
+class SAUCE_API HeadlessTexture2D : public Texture2D
+{
+public:
+	HeadlessTexture2D(HeadlessContext *graphicsContext, const Pixmap &pixmap);
+
+	Pixmap getPixmap() const;
+	void updatePixmap(const Pixmap &pixmap);
+	void updatePixmap(const uint x, const uint y, const Pixmap &pixmap);
+	void clear();
+
+private:
+	void updateFiltering();
+
+	HeadlessContext *m_graphicsContext;
+	vector<uchar> m_data;
+};
+
+/**
+ * \brief Shader that ignores its sources and uniforms. Setting a uniform still
+ * draws the shapes batched with the shader, as a GL shader would.
+ */
+class SAUCE_API HeadlessShader : public Shader
+{
+public:
+	void bindFragLocation(const uint /*location*/, const string &/*name*/) { }
+
+	void link() { }
+
+	void setUniform1i(const string &/*name*/, const int /*v0*/) { flushPrimitives(); }
+	void setUniform2i(const string &/*name*/, const int /*v0*/, const int /*v1*/) { flushPrimitives(); }
+	void setUniform3i(const string &/*name*/, const int /*v0*/, const int /*v1*/, const int /*v2*/) { flushPrimitives(); }
+	void setUniform4i(const string &/*name*/, const int /*v0*/, const int /*v1*/, const int /*v2*/, const int /*v3*/) { flushPrimitives(); }
+
+	void setUniform1iv(const string &/*name*/, const uint /*count*/, const int * /*v*/) { flushPrimitives(); }
+	void setUniform2iv(const string &/*name*/, const uint /*count*/, const int * /*v*/) { flushPrimitives(); }
+	void setUniform3iv(const string &/*name*/, const uint /*count*/, const int * /*v*/) { flushPrimitives(); }
+	void setUniform4iv(const string &/*name*/, const uint /*count*/, const int * /*v*/) { flushPrimitives(); }
+
+	void setUniform1ui(const string &/*name*/, const uint /*v0*/) { flushPrimitives(); }
+	void setUniform2ui(const string &/*name*/, const uint /*v0*/, const uint /*v1*/) { flushPrimitives(); }
+	void setUniform3ui(const string &/*name*/, const uint /*v0*/, const uint /*v1*/, const uint /*v2*/) { flushPrimitives(); }
+	void setUniform4ui(const string &/*name*/, const uint /*v0*/, const uint /*v1*/, const uint /*v2*/, const uint /*v3*/) { flushPrimitives(); }
+
+	void setUniform1f(const string &/*name*/, const float /*v0*/) { flushPrimitives(); }
+	void setUniform2f(const string &/*name*/, const float /*v0*/, const float /*v1*/) { flushPrimitives(); }
+	void setUniform2f(const string &/*name*/, const float * /*v*/) { flushPrimitives(); }
+	void setUniform3f(const string &/*name*/, const float /*v0*/, const float /*v1*/, const float /*v2*/) { flushPrimitives(); }
+	void setUniform4f(const string &/*name*/, const float /*v0*/, const float /*v1*/, const float /*v2*/, const float /*v3*/) { flushPrimitives(); }
+	void setUniform4f(const string &/*name*/, const float * /*v*/) { flushPrimitives(); }
+	void setUniformMatrix4f(const string &/*name*/, const float * /*v0*/) { flushPrimitives(); }
+	void setSampler2D(const string &/*name*/, shared_ptr<Texture2D> /*texture*/) { flushPrimitives(); }
+
+	void setUniformColor(const string &/*name*/, const Color &/*color*/) { flushPrimitives(); }
+	void setUniformColorRGB(const string &/*name*/, const ColorRGB &/*color*/) { flushPrimitives(); }
+};
+
+/**
+ * \brief Render target of headless textures. Binding it is recorded by its context.
+ */
+class SAUCE_API HeadlessRenderTarget2D : public RenderTarget2D
+{
+public:
+	HeadlessRenderTarget2D(HeadlessContext *graphicsContext, const uint width, const uint height, const uint targetCount = 1, const PixelFormat &fmt = PixelFormat());
+
+private:
+	void bind();
+	void unbind();
+
+	HeadlessContext *m_graphicsContext;
+};
+
+/**
+ * \brief Graphics context that runs without a GPU.
+ *
+ * Implements every backend function of GraphicsContext without calling GL, so the CPU
+ * side of the renderer (SpriteBatch, Font, the draw* functions, ...) can be benchmarked
+ * and tested on machines without a GPU. Textures keep their pixels in memory, shaders
+ * and render targets do nothing, and vertex and index buffers skip their uploads.
+ *
+ * In NULL mode all work is discarded. In RECORDING mode every draw, clear, render target
+ * change and buffer or texture upload is appended to a log of calls, together with the state it
+ * was issued with, which can be inspected with getCalls(). The log only holds the calls of the
+ * current frame, while the counters keep counting until clearCalls().
+ *
+ * Selected with GraphicsBackend::SAUCE_NULL or GraphicsBackend::SAUCE_RECORDING, or
+ * created directly. Only one headless context may exist at a time. The window it creates
+ * is a hidden SDL window, so set SDL_VIDEODRIVER=dummy on machines without a display.
+ */
+class SAUCE_API HeadlessContext : public GraphicsContext
+{
+	friend class Game;
+public:
+	enum Mode
+	{
+		NULL_MODE,		///< Discard all work
+		RECORDING_MODE	///< Record calls to the log
+	};
+
+	/**
+	 * A recorded call.
+	 */
+	struct Call
+	{
+		enum Type
+		{
+			DRAW_PRIMITIVES,
+			DRAW_INDEXED_PRIMITIVES,
+			DRAW_SPRITE_INSTANCES,
+			CLEAR,
+			BIND_RENDER_TARGET,
+			UNBIND_RENDER_TARGET,
+			UPLOAD_VERTEX_BUFFER,
+			UPLOAD_INDEX_BUFFER,
+			UPLOAD_TEXTURE
+		};
+
+		Call(const Type type);
+
+		Type type;
+
+		// Draws
+		PrimitiveType primitiveType;
+		uint vertexCount;
+		uint indexCount;
+		uint instanceCount;
+		VertexFormat format;
+
+		// State of draws. The texture is the one bound for the draw, the default texture if none is set
+		const Texture2D *texture;
+		const Shader *shader;
+		BlendState blendState;
+		Matrix4 modelViewProjection;
+		const RenderTarget2D *renderTarget; // Render target drawn to, or bound/unbound
+
+		// Number of bytes uploaded by the call. Draws from memory upload their vertices and indices
+		uint uploadedBytes;
+
+		// Clears
+		uint clearMask;
+		Color clearColor;
+	};
+
+	HeadlessContext(const Mode mode = NULL_MODE);
+	~HeadlessContext();
+
+	Mode getMode() const { return m_mode; }
+
+	/**
+	 * Returns the calls recorded this frame.
+	 */
+	const vector<Call> &getCalls() const { return m_calls; }
+
+	/**
+	 * Returns the number of recorded draws.
+	 */
+	uint getDrawCount() const { return m_drawCount; }
+
+	/**
+	 * Returns the number of bytes uploaded by the recorded calls.
+	 */
+	uint getUploadedBytes() const { return m_uploadedBytes; }
+
+	/**
+	 * Returns the number of recorded draws that changed the texture, shader or
+	 * blend state from the previous draw.
+	 */
+	uint getStateChangeCount() const { return m_stateChangeCount; }
+
+	/**
+	 * Clears the log and the counters.
+	 */
+	void clearCalls();
+
+	/**
+	 * Records a call that is not a draw, like an upload of \p size bytes by
+	 * a buffer or texture, or a render target being bound.
+	 */
+	void record(const Call::Type type, const uint uploadedBytes = 0, const RenderTarget2D *renderTarget = nullptr);
+
+	void enable(const Capability cap);
+	void disable(const Capability cap);
+	void enableScissor(const int /*x*/, const int /*y*/, const int /*w*/, const int /*h*/) { }
+	void disableScissor() { }
+	bool isEnabled(const Capability cap);
+	void setPointSize(const float /*pointSize*/) { }
+	void setLineWidth(const float /*lineWidth*/) { }
+	void setViewportSize(const uint /*w*/, const uint /*h*/) { }
+	void clear(const uint mask, const Color &fillColor = Color(0, 0, 0, 0));
+	void saveScreenshot(string /*path*/) { }
+
+	Matrix4 createOrtographicMatrix(const float left, const float right, const float top, const float bottom, const float n = -1.0f, const float f = 1.0f) const;
+	Matrix4 createPerspectiveMatrix(const float fov, const float aspectRatio, const float zNear, const float zFar) const;
+	Matrix4 createLookAtMatrix(const Vector3F &position, const Vector3F &fwd) const;
+
+	// The Vertex overloads are adapters in GraphicsContext
+	using GraphicsContext::drawIndexedPrimitives;
+	using GraphicsContext::drawPrimitives;
+
+	void drawIndexedPrimitives(const PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount, const uint *indices, const uint indexCount);
+	void drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo);
+	void drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo, const uint indexStart, const uint indexCount);
+	void drawPrimitives(const PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount);
+	void drawPrimitives(const PrimitiveType type, const VertexBuffer *vbo);
+
+	/**
+	 * Instancing is reported as supported in RECORDING_MODE, so the instanced paths can be tested.
+	 */
+	bool isInstancingSupported() const { return m_mode == RECORDING_MODE; }
+	void drawSpriteInstances(const SpriteInstance *instances, const uint instanceCount);
+
+	/**
+	 * The multi-texture path is not available, as there are no texture units.
+	 */
+	uint getTextureSlotCount() const { return 0; }
+	shared_ptr<Shader> getMultiTextureShader() const { return nullptr; }
+
+	Texture2D *createTexture(const Pixmap &pixmap);
+	Shader *createShader(const string &vertexSource, const string &fragmentSource, const string &geometrySource);
+	RenderTarget2D *createRenderTarget(const uint width, const uint height, const uint targetCount = 1, const PixelFormat &fmt = PixelFormat());
+
+	/**
+	 * Ends the frame and clears the log of calls, so that a game running on the RECORDING
+	 * backend doesn't grow it without bound. Inspect the calls of a frame in onDraw().
+	 */
+	void swapBuffers();
+
+private:
+	Window *createWindow(const string &title, const int x, const int y, const int w, const int h, const Uint32 flags);
+
+	// Buffers have no storage. Uploads are recorded
+	uint createBuffer() { return ++m_bufferCount; }
+	void deleteBuffer(const uint /*buffer*/) { }
+	void setBufferData(const BufferTarget target, const uint buffer, const void *data, const uint size, const bool dynamic);
+	void setBufferSubData(const BufferTarget target, const uint buffer, const uint offset, const void *data, const uint size);
+
+	void recordDraw(Call &call, const uint uploadedBytes);
+
+	static HeadlessContext *s_current;
+
+	const Mode m_mode;
+	uint m_capabilities;
+	uint m_bufferCount;
+
+	vector<Call> m_calls;
+	Call m_previousDraw; // Compared to each draw to count state changes
+	bool m_hasPreviousDraw;
+	uint m_drawCount;
+	uint m_uploadedBytes;
+	uint m_stateChangeCount;
+};
+
+END_SAUCE_NAMESPACE
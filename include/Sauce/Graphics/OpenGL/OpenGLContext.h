@@ -15,16 +15,89 @@ class IndexBuffer;
 class SAUCE_API OpenGLContext : public GraphicsContext
 {
 	friend class Game;
+	friend class OpenGLTexture2D;
 private:
 	OpenGLContext(const int major, const int minor);
 	~OpenGLContext();
 
 	void setupContext();
 
+	// Number of texture units tracked by the shadow state
+	static const uint MAX_TEXTURE_UNITS = 32;
+
+	// Shadow copy of the bound GL state. setupContext() only issues the GL calls that change it
+	struct GLState
+	{
+		GLState();
+
+		GLenum blendSrc, blendDst, blendAlphaSrc, blendAlphaDst;
+		GLuint program;
+		uint activeTextureUnit;
+		GLuint textures[MAX_TEXTURE_UNITS];
+	};
+
+	/**
+	 * Binds \p texture to texture unit \p unit, unless it is already bound.
+	 */
+	static void bindTexture(const uint unit, const GLuint texture);
+
+	/**
+	 * Binds \p texture to the active texture unit, unless it is already bound.
+	 */
+	static void bindTexture(const GLuint texture);
+
+	/**
+	 * Removes \p texture from the shadow state. Called when a texture is deleted,
+	 * as GL unbinds it from all texture units.
+	 */
+	static void unbindTexture(const GLuint texture);
+
+	static GLState s_glState;
+	static uint s_issuedStateCalls;
+	static uint s_skippedStateCalls;
+
+	// Vertex array objects are cached per vertex format and buffer binding
+	struct VertexArrayKey
+	{
+		VertexArrayKey(const VertexFormat &fmt, const GLuint vertexBuffer, const GLuint indexBuffer);
+
+		bool operator<(const VertexArrayKey &other) const;
+
+		GLuint vertexBuffer;
+		GLuint indexBuffer;
+		int elementCounts[VERTEX_ATTRIB_MAX];
+		DataType dataTypes[VERTEX_ATTRIB_MAX];
+	};
+
+	/**
+	 * Binds the vertex array object for drawing vertices in format \p fmt from the
+	 * given buffers. The vertex array is created and its attributes set up on first use.
+	 */
+	void bindVertexArray(const VertexFormat &fmt, const GLuint vertexBuffer, const GLuint indexBuffer);
+
+	/**
+	 * Deletes the cached vertex arrays using \p buffer. Called when a buffer is deleted,
+	 * as GL may reuse its name for a new buffer.
+	 */
+	static void deleteVertexArrays(const GLuint buffer);
+
+	static map<VertexArrayKey, GLuint> s_vertexArrays;
+	static GLuint s_currentVertexArray;
+	static uint s_vertexArrayCacheHits;
+	static uint s_vertexArrayCacheMisses;
+
+	// Vertex array for drawSpriteInstances()
 	static GLuint s_vao;
 	static GLuint s_vbo;
 	static GLuint s_ibo;
 
+	// Built-in shader for drawSpriteInstances()
+	static shared_ptr<Shader> s_spriteInstanceShader;
+
+	// Built-in multi-texture shader and its number of texture slots
+	static shared_ptr<Shader> s_multiTextureShader;
+	static uint s_textureSlotCount;
+
 public:
 	/**
 	 * Enables the capability \p cap.
@@ -84,15 +157,20 @@ public:
 	Matrix4 createPerspectiveMatrix(const float fov, const float aspectRatio, const float zNear, const float zFar) const;
 	Matrix4 createLookAtMatrix(const Vector3F &position, const Vector3F &fwd) const;
 	
+	// The Vertex overloads are adapters in GraphicsContext
+	using GraphicsContext::drawIndexedPrimitives;
+	using GraphicsContext::drawPrimitives;
+
 	/**
-	 * Renders an indexed primitive to the screen.
+	 * Renders an indexed primitive to the screen from interleaved vertex data.
 	 * \param type Types of primitives to render.
-	 * \param vertices Array of vertices to render.
+	 * \param fmt Format of the vertex data.
+	 * \param vertexData Vertex data, tightly packed as described by \p fmt.
 	 * \param vertexCount Number of vertices to render.
 	 * \param indices Array of indices.
 	 * \param indexCount Number of indices.
 	 */
-	void drawIndexedPrimitives(const PrimitiveType type, const Vertex *vertices, const uint vertexCount, const uint *indices, const uint indexCount);
+	void drawIndexedPrimitives(const PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount, const uint *indices, const uint indexCount);
 
 	/**
 	 * Renders an indexed primitive to the screen using vertex and index buffers.
@@ -103,12 +181,23 @@ public:
 	void drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo);
 
 	/**
-	 * Renders primitives to the screen.
+	 * Renders a range of an index buffer to the screen using vertex and index buffers.
 	 * \param type Types of primitives to render.
-	 * \param vertices Array of vertices to render.
+	 * \param vbo Vertex buffer object.
+	 * \param ibo Index buffer object.
+	 * \param indexStart First index to render.
+	 * \param indexCount Number of indices to render.
+	 */
+	void drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo, const uint indexStart, const uint indexCount);
+
+	/**
+	 * Renders primitives to the screen from interleaved vertex data.
+	 * \param type Types of primitives to render.
+	 * \param fmt Format of the vertex data.
+	 * \param vertexData Vertex data, tightly packed as described by \p fmt.
 	 * \param vertexCount Number of vertices to render.
 	 */
-	void drawPrimitives(const PrimitiveType type, const Vertex *vertices, const uint vertexCount);
+	void drawPrimitives(const PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount);
 
 	/**
 	 * Renders primitives to the screen.
@@ -117,15 +206,74 @@ public:
 	 */
 	void drawPrimitives(const PrimitiveType type, const VertexBuffer *vbo);
 
+	/**
+	 * Returns true if drawSpriteInstances() is supported (OpenGL 3.3 and up).
+	 */
+	bool isInstancingSupported() const;
+
+	/**
+	 * Renders textured sprite quads from instance records.
+	 * \param instances Array of sprite instances to render.
+	 * \param instanceCount Number of instances to render.
+	 */
+	void drawSpriteInstances(const SpriteInstance *instances, const uint instanceCount);
+
+	/**
+	 * Returns the number of state changes (blend function, program, uniforms and
+	 * texture bindings) sent to GL.
+	 */
+	uint getIssuedStateCallCount() const { return s_issuedStateCalls; }
+
+	/**
+	 * Returns the number of state changes skipped because GL already had the state.
+	 */
+	uint getSkippedStateCallCount() const { return s_skippedStateCalls; }
+
+	/**
+	 * Returns the number of draws that found their vertex array object in the cache.
+	 */
+	uint getVertexArrayCacheHits() const { return s_vertexArrayCacheHits; }
+
+	/**
+	 * Returns the number of draws that had to create a vertex array object.
+	 */
+	uint getVertexArrayCacheMisses() const { return s_vertexArrayCacheMisses; }
+
+	/**
+	 * Returns the number of cached vertex array objects.
+	 */
+	uint getVertexArrayCount() const { return s_vertexArrays.size(); }
+
+	/**
+	 * Returns the number of texture slots of the multi-texture shader.
+	 * This is the number of texture units, up to MAX_TEXTURE_SLOTS.
+	 */
+	uint getTextureSlotCount() const { return s_textureSlotCount; }
+
+	/**
+	 * Returns the built-in multi-texture shader.
+	 */
+	shared_ptr<Shader> getMultiTextureShader() const { return s_multiTextureShader; }
+
+	// Max number of texture slots of the multi-texture shader
+	static const uint MAX_TEXTURE_SLOTS = 16;
+
 	Texture2D *createTexture(const Pixmap &pixmap);
 	Shader *createShader(const string &vertexSource, const string &fragmentSource, const string &geometrySource);
 	RenderTarget2D *createRenderTarget(const uint width, const uint height, const uint targetCount = 1, const PixelFormat &fmt = PixelFormat());
 
+	void swapBuffers();
+
 	string getGLSLVersion() const;
 
 private:
 	Window *createWindow(const string &title, const int x, const int y, const int w, const int h, const Uint32 flags);
 
+	uint createBuffer();
+	void deleteBuffer(const uint buffer);
+	void setBufferData(const BufferTarget target, const uint buffer, const void *data, const uint size, const bool dynamic);
+	void setBufferSubData(const BufferTarget target, const uint buffer, const uint offset, const void *data, const uint size);
+
 	const int m_majorVersion, m_minorVersion;
 };
 
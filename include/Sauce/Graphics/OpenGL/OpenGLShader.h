@@ -58,7 +58,9 @@ private:
 			type(0),
 			loc(0),
 			count(0),
-			data(0)
+			data(0),
+			textureUnit(-1),
+			dirty(true)
 		{
 		}
 
@@ -71,10 +73,17 @@ private:
 		int loc;
 		int count;
 		void *data;
+		int textureUnit; // Texture unit of sampler uniforms
+		bool dirty; // True if the value has changed since it was uploaded
 	};
 
+	// Copies \p size bytes of \p data into \p uniform, and queues it for upload if the value changed
+	void setUniformData(Uniform *uniform, const void *data, const size_t size);
+
 	GLuint m_id, m_vertShaderID, m_fragShaderID;
 	map<string, Uniform*> m_uniforms;
+	vector<Uniform*> m_dirtyUniforms;
+	vector<Uniform*> m_samplers;
 
 	static string s_glslVersion;
 };
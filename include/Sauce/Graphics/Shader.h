@@ -44,6 +44,13 @@ public:
 
 	virtual void setUniformColor(const string &name, const Color &color) = 0;
 	virtual void setUniformColorRGB(const string &name, const ColorRGB &color) = 0;
+
+protected:
+	// Draws the shapes batched with this shader. Called before a uniform is changed
+	void flushPrimitives();
+
+private:
+	GraphicsContext *m_batchingContext; // Context with a pending shape batch using this shader
 };
 
 template SAUCE_API class shared_ptr<Shader>;
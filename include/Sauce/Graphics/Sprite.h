@@ -3,20 +3,55 @@
 
 #include <Sauce/Common.h>
 #include <Sauce/Graphics/TextureRegion.h>
+#include <Sauce/Graphics/Texture.h>
+#include <Sauce/Graphics/Vertex.h>
 
 BEGIN_SAUCE_NAMESPACE
 
-class Texture2D;
+/**
+ * Packed sprite vertex. Position, color and texture coord.
+ */
+typedef VertexPCT SpriteVertex;
 
+/**
+ * Packed sprite instance (48 bytes). One per sprite in SpriteBatch's instanced path.
+ * The quad is expanded on the GPU by the built-in sprite instancing shader.
+ */
+struct SpriteInstance
+{
+	float transform[6];	///< 2x3 affine transform {a, b, tx, c, d, ty} of the unit quad. Holds position, size, origin, scale and angle
+	float uv[4];		///< Texture region {u0, v0, u1, v1}
+	uchar color[4];		///< Color {r, g, b, a}
+	float z;			///< Depth buffer z. 0 unless the sprites are depth tested
+};
+
+/**
+ * Packed glyph quad. Axis-aligned, so it is only the corners of the quad and its texture region.
+ * Submitted in runs with SpriteBatch::drawGlyphRun().
+ */
+struct GlyphQuad
+{
+	float x0, y0, x1, y1;	///< Top-left and bottom-right corners
+	float u0, v0, u1, v1;	///< Texture region
+};
+
+/**
+ * \brief A textured, transformed quad.
+ *
+ * Sprites are plain data: the texture is stored as a TextureHandle, so copying
+ * a sprite is a memcpy. A sprite does not keep its texture alive. Keep a
+ * shared_ptr to the texture for as long as it is drawn, as sprites whose
+ * texture has been deleted are skipped.
+ */
 class SAUCE_API Sprite
 {
 	friend class SpriteBatch;
+	friend class StaticSpriteLayer;
 public:
 	Sprite(shared_ptr<Texture2D> texture = 0, const Rect<float> &rectangle = Rect<float>(0, 0, 0, 0), const Vector2F &origin = Vector2F(0.0f, 0.0f), const float angle = 0.0f, const TextureRegion &region = TextureRegion(), const Color &color = Color::White, const float depth = 0.0f, const Vector2F scale = Vector2F(1.0f, 1.0f));
 	//Sprite(const Resource<Texture2D> texture, const Rect &rectangle, const TextureRegion &region = TextureRegion(), const Color &color = Color(255), const float depth = 0.0f);
 	//Sprite(const Resource<Texture2D> texture, const Rect &rectangle, const TextureRegion &region = TextureRegion(), const Color &color = Color(255), const float depth = 0.0f);
 	//Sprite(const Resource<Texture2D> texture, const Vector2F &center, const TextureRegion &region = TextureRegion(), const Color &color = Color(255), const float depth = 0.0f);
-	~Sprite();
 	
 	void setPosition(const Vector2F &pos);
 	void setPosition(const float x, const float y);
@@ -59,11 +94,17 @@ public:
 	float getRotation() const;
 	Color getColor() const;
 	TextureRegion getRegion() const;
-	void setTexture(shared_ptr<Texture2D> texture) { m_texture = texture; }
+	void setTexture(shared_ptr<Texture2D> texture);
 	shared_ptr<Texture2D> getTexture() const;
+	TextureHandle getTextureHandle() const { return m_texture; }
+
+	/**
+	 * Packs the sprite into an instance record (with z = 0).
+	 */
+	void getInstance(SpriteInstance *instance) const;
 
 private:
-	shared_ptr<Texture2D> m_texture;
+	TextureHandle m_texture;
 	TextureRegion m_textureRegion;
 	Vector2F m_position;
 	Vector2F m_size;
@@ -73,10 +114,15 @@ private:
 	float m_angle;
 	Color m_color;
 
-	// Returns the transformed vertices
-	void getVertices(Vertex *vertices, uint *indices, const uint indexOffset = 0) const;
+	// Returns the 2x3 affine transform {a, b, tx, c, d, ty} taking the unit quad to the sprite corners
+	void getAffineTransform(float *transform) const;
+
+	// Writes the 4 transformed vertices of the sprite
+	void getVertices(SpriteVertex *vertices) const;
 };
 
+static_assert(is_trivially_copyable<Sprite>::value, "Sprite must be trivially copyable");
+
 END_SAUCE_NAMESPACE
 
 #endif // SAUCE_SPRITE_H
@@ -8,10 +8,59 @@
 #include <Sauce/Graphics/texture.h>
 #include <Sauce/Graphics/shader.h>
 #include <Sauce/Graphics/font.h>
+#include <Sauce/Graphics/sprite.h>
+
+/**
+ * Default max number of sprites a SpriteBatch holds before it flushes.
+ * 0 means the batch grows as needed. Memory-constrained builds can define a limit.
+ */
+#ifndef SAUCE_SPRITE_BATCH_MAX_SPRITES
+	#define SAUCE_SPRITE_BATCH_MAX_SPRITES 0
+#endif
 
 BEGIN_SAUCE_NAMESPACE
 
 class Sprite;
+class AutoAtlas;
+
+/**
+ * \brief Assigns textures to a fixed number of texture slots.
+ *
+ * Used by SpriteBatch to bind several textures per draw call.
+ */
+class SAUCE_API TextureSlotTable
+{
+public:
+	TextureSlotTable(const uint slotCount = 1);
+
+	/**
+	 * Set the number of slots. Clears the table.
+	 */
+	void setSlotCount(const uint slotCount);
+	uint getSlotCount() const { return m_slotCount; }
+
+	/**
+	 * Returns the slot of \p texture, assigning it the next free slot if it has none.
+	 * Returns -1 if the texture has no slot and all slots are taken.
+	 */
+	int getSlot(const TextureHandle texture);
+
+	/**
+	 * Frees all slots.
+	 */
+	void clear();
+
+	/**
+	 * Returns the number of slots in use, and the texture of a slot.
+	 */
+	uint getTextureCount() const { return m_textures.size(); }
+	TextureHandle getTexture(const uint slot) const { return m_textures[slot]; }
+
+private:
+	vector<TextureHandle> m_textures;
+	uint m_slotCount;
+	uint m_lastSlot;
+};
 
 /*********************************************************************
 **	Batch															**
@@ -19,16 +68,16 @@ class Sprite;
 class SAUCE_API SpriteBatch
 {
 public:
-	SpriteBatch(const uint maxSprites = 2048);
+	SpriteBatch(const uint initialCapacity = 2048);
 	~SpriteBatch();
 
 	enum SpriteSortMode
 	{
-		BACK_TO_FRONT,
-		DEFERRED,
-		FRONT_TO_BACK,
-		IMMEDIATE,
-		TEXTURE
+		BACK_TO_FRONT,	///< Sprites are drawn from lowest to highest depth, in submission order within each depth
+		DEFERRED,		///< Sprites are drawn from lowest to highest depth, grouped by texture within each depth
+		FRONT_TO_BACK,	///< Sprites are drawn from highest to lowest depth with depth testing. Intended for opaque sprites. Expects the depth buffer to be cleared to 1
+		IMMEDIATE,		///< Sprites are drawn as soon as drawSprite() is called. State is applied in begin()
+		TEXTURE			///< Sprites are grouped by texture, in submission order, as long as the result looks the same
 	};
 
 	struct State
@@ -47,27 +96,202 @@ public:
 		shared_ptr<Shader> shader;
 	};
 
+	/**
+	 * Counters for the sprites drawn since begin(). Filled in as the batch draws,
+	 * so reading them is free. Flushes add to the counters of the batch.
+	 */
+	struct Stats
+	{
+		Stats() :
+			drawCallCount(0),
+			textureBindCount(0),
+			spriteCount(0),
+			culledSpriteCount(0),
+			vertexCount(0),
+			indexCount(0),
+			bytesUploaded(0),
+			sortTime(0.0),
+			vertexGenerationTime(0.0)
+		{
+		}
+
+		uint drawCallCount;			///< Number of draw calls
+		uint textureBindCount;		///< Number of times the texture was changed between draw calls
+		uint spriteCount;			///< Number of sprites drawn
+		uint culledSpriteCount;		///< Number of sprites skipped by culling
+		uint vertexCount;			///< Number of vertices drawn
+		uint indexCount;			///< Number of indices drawn
+		Uint64 bytesUploaded;		///< Bytes of vertex, index and instance data uploaded
+		double sortTime;			///< CPU time spent sorting, in microseconds
+		double vertexGenerationTime;///< CPU time spent generating vertices or instances, in microseconds
+	};
+
 	void begin(GraphicsContext *graphicsContext, const State &state = State());
 	void drawSprite(const Sprite &sprite);
+
+	/**
+	 * Draws a run of axis-aligned glyph quads sharing a texture, color and depth.
+	 * Sorts like one sprite per glyph, but the run is only looked up and keyed once.
+	 * In IMMEDIATE mode the run is drawn with one draw call. Used by Font.
+	 */
+	void drawGlyphRun(const TextureHandle texture, const GlyphQuad *glyphs, const uint glyphCount, const Color &color, const float depth = 0.0f);
+
 	void drawText(const Vector2F &pos, const string &text, Font *font);
 	void end();
 	void flush();
 
 	State getState() const { return m_state; }
-	uint getTextureSwapCount() const;
+
+	/**
+	 * Returns the counters of the sprites drawn since begin().
+	 * After end() these are the counters of the whole batch.
+	 */
+	const Stats &getStats() const { return m_stats; }
+
+	/**
+	 * Set the max number of sprites the batch holds before it flushes.
+	 * 0 means the batch grows as needed.
+	 */
+	void setMaxSpriteCount(const uint maxSprites);
+	uint getMaxSpriteCount() const { return m_maxSpriteCount; }
+
+	/**
+	 * Returns the number of sprites the batch can hold without allocating.
+	 * The capacity grows in chunks and is kept between batches.
+	 */
+	uint getCapacity() const;
+
+	/**
+	 * Set a worker pool to split vertex generation in end() across.
+	 * Draw calls are still made from the calling thread. nullptr generates
+	 * the vertices on the calling thread.
+	 */
+	void setWorkerPool(WorkerPool *workerPool) { m_workerPool = workerPool; }
+	WorkerPool *getWorkerPool() const { return m_workerPool; }
+
+	/**
+	 * Enable the instanced path. Each sprite is then packed into one SpriteInstance
+	 * record and the quads are expanded on the GPU. The classic path is used
+	 * when the state has a custom shader, in IMMEDIATE mode, or if the graphics
+	 * context doesn't support instancing.
+	 */
+	void setInstancingEnabled(const bool enabled) { m_instancingEnabled = enabled; }
+	bool isInstancingEnabled() const { return m_instancingEnabled; }
+
+	/**
+	 * Enable viewport culling. drawSprite() then skips sprites whose bounds are
+	 * outside the viewport, as seen through State::transformationMatix. The
+	 * bounds are conservative, so no visible sprite is skipped. The visible area
+	 * is computed in begin().
+	 */
+	void setCullingEnabled(const bool enabled) { m_cullingEnabled = enabled; }
+	bool isCullingEnabled() const { return m_cullingEnabled; }
+
+	/**
+	 * Set the number of textures to bind per draw call. With more than one
+	 * slot, draw calls are only split when the slots are full, and the sprites
+	 * are drawn with the graphics context's multi-texture shader. The count is
+	 * capped to GraphicsContext::getTextureSlotCount(). Not used with a custom
+	 * shader or the instanced path. Default is 1.
+	 */
+	void setTextureSlotCount(const uint slotCount) { m_textureSlotCount = slotCount; }
+	uint getTextureSlotCount() const { return m_textureSlotCount; }
+
+	/**
+	 * Set an auto atlas to draw small textures from. Sprites are then remapped
+	 * to the atlas page and region of their texture once it has been packed,
+	 * so sprites with different small textures can share draw calls. The atlas
+	 * is updated in begin(). Not used in IMMEDIATE mode. nullptr disables it.
+	 */
+	void setAutoAtlas(AutoAtlas *autoAtlas) { m_autoAtlas = autoAtlas; }
+	AutoAtlas *getAutoAtlas() const { return m_autoAtlas; }
 
 private:
+	void addSpriteChunk();
+	Sprite &getSprite(const uint index) const;
+	void applyState();
+	void updateCullBounds();
+	void setTexture(const shared_ptr<Texture2D> &texture);
+	void drawSortedSprites();
+	void generateVertices(const uint begin, const uint end) const;
+	void generateInstances(const uint begin, const uint end) const;
+	void generateSlotVertices(const uint begin, const uint end) const;
+	void addRunTextures();
+	bool reserveSprite();
+	Uint64 getSortKey(const Sprite &sprite, const Texture2D *texture);
+	uint getTextureBatch(const Sprite &sprite, const Texture2D *texture);
 
 	// SpriteBatch state
 	State m_state;
 
-	// Vertex & index buffers
-	Vertex *m_vertices;
-	uint *m_indices;
-	Sprite *m_sprites;
+	// Sprites. Stored in fixed-size chunks that are kept between batches
+	vector<Sprite*> m_spriteChunks;
 	uint m_spriteCount;
-	const uint m_maxSpriteCount;
+	uint m_maxSpriteCount;
 	GraphicsContext *m_graphicsContext;
+
+	// Vertices. Grown to the sprite capacity in end(). Uploaded to m_vertexBuffer
+	// once per batch and indexed with the graphics context's shared quad index buffer
+	SpriteVertex *m_vertices;
+	uint m_vertexCapacity;
+	DynamicVertexBuffer *m_vertexBuffer;
+
+	// Vertices for the multi-texture path
+	VertexPCTS *m_slotVertices;
+	uint m_slotVertexCapacity;
+
+	// Texture slots for the multi-texture path. Runs are built with m_textureSlotTable,
+	// m_textureSlots holds the slot of each sorted sprite and m_runTextures holds the
+	// textures of each run (one per slot, invalid handles for unused slots)
+	uint m_textureSlotCount;
+	TextureSlotTable m_textureSlotTable;
+	vector<uchar> m_textureSlots;
+	vector<TextureHandle> m_runTextures;
+	vector<string> m_textureSlotNames;
+
+	// Instance buffer for the instanced path. Grown to the sprite capacity in end()
+	SpriteInstance *m_instances;
+	uint m_instanceCapacity;
+	bool m_instancingEnabled;
+	vector<float> m_depthZ;
+
+	// Sort keys (at least one per sprite of capacity). The low 20 bits of a key is the sprite index.
+	// The high 44 bits depend on the sort mode:
+	//   DEFERRED:      [depth:32][texture id:12]
+	//   BACK_TO_FRONT: [depth:32][0:12]
+	//   FRONT_TO_BACK: [inverted depth:32][texture id:12]
+	//   TEXTURE:       [texture batch:44]
+	Uint64 *m_sortKeys;
+	uint m_sortKeyCapacity;
+	unordered_map<const Texture2D*, uint> m_textureIds;
+	const Texture2D *m_prevTexture;
+	uint m_prevTextureId;
+
+	// Texture batches used by the TEXTURE sort mode
+	struct TextureBatch
+	{
+		const Texture2D *texture;
+		Vector2F min, max;
+	};
+	vector<TextureBatch> m_textureBatches;
+
+	// Index of the first sprite of every run of sprites drawn together, plus
+	// the sprite count. Built in end()
+	vector<uint> m_runStarts;
+
+	// Worker pool for vertex generation
+	WorkerPool *m_workerPool;
+
+	// Counters since begin(), and the last texture set on the graphics context
+	Stats m_stats;
+	const Texture2D *m_boundTexture;
+
+	// Viewport culling. The bounds are { maxX, maxY, -minX, -minY } in sprite space
+	bool m_cullingEnabled;
+	float m_cullBounds[4];
+
+	// Atlas for small textures
+	AutoAtlas *m_autoAtlas;
 };
 
 END_SAUCE_NAMESPACE
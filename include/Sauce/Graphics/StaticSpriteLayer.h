@@ -0,0 +1,115 @@
+#ifndef SAUCE_STATIC_SPRITE_LAYER_H
+#define SAUCE_STATIC_SPRITE_LAYER_H
+
+#include <Sauce/Common.h>
+#include <Sauce/Graphics/Sprite.h>
+#include <Sauce/Graphics/SpriteBatch.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+class StaticVertexBuffer;
+
+/*********************************************************************
+**	Static sprite layer												**
+**********************************************************************/
+
+/**
+ * \brief Retained set of sprites drawn from cached geometry.
+ *
+ * The sprites are sorted by depth, then texture (like SpriteBatch::DEFERRED), and their
+ * geometry is kept in a static vertex buffer. Each run of sprites sharing a
+ * texture is drawn with one draw call. The buffers are only touched when the layer is
+ * drawn after a change: sprites that keep their depth and texture are updated in place,
+ * one region of the buffers at a time, while adding or removing sprites or changing the
+ * depth or texture of a sprite rebuilds the layer.
+ */
+class SAUCE_API StaticSpriteLayer
+{
+public:
+	StaticSpriteLayer();
+	~StaticSpriteLayer();
+
+	/**
+	 * Adds a sprite to the layer.
+	 * \return Id of the sprite within the layer.
+	 */
+	uint addSprite(const Sprite &sprite);
+
+	/**
+	 * Removes the sprite with id \p id.
+	 */
+	void removeSprite(const uint id);
+
+	/**
+	 * Replaces the sprite with id \p id and marks it dirty.
+	 */
+	void setSprite(const uint id, const Sprite &sprite);
+	const Sprite &getSprite(const uint id) const;
+
+	/**
+	 * Removes all sprites.
+	 */
+	void clear();
+
+	uint getSpriteCount() const { return m_spriteCount; }
+
+	/**
+	 * Draws the layer. The sort mode of \p state is ignored.
+	 */
+	void draw(GraphicsContext *graphicsContext, const SpriteBatch::State &state = SpriteBatch::State());
+
+	/**
+	 * Returns the number of draw calls draw() makes.
+	 */
+	uint getDrawCallCount() const { return m_runs.size(); }
+
+private:
+	void rebuild(GraphicsContext *graphicsContext);
+	void updateDirtyRegions();
+
+	struct Entry
+	{
+		Entry() :
+			alive(false),
+			slot(0),
+			builtDepth(0.0f)
+		{
+			builtTexture.value = 0;
+		}
+
+		Sprite sprite;
+		bool alive;
+
+		// Slot in the buffers, and the texture and depth the slot was sorted with
+		uint slot;
+		TextureHandle builtTexture;
+		float builtDepth;
+	};
+
+	struct Run
+	{
+		shared_ptr<Texture2D> texture;
+		uint indexStart;
+		uint indexCount;
+	};
+
+	// Sprites by id
+	vector<Entry> m_entries;
+	vector<uint> m_freeIds;
+	uint m_spriteCount;
+
+	// Cached geometry. Slot i holds vertices [i * 4, i * 4 + 4), indexed by quad i of the shared quad index buffer
+	vector<uint> m_slotIds;
+	vector<SpriteVertex> m_vertices;
+	vector<Run> m_runs;
+	StaticVertexBuffer *m_vertexBuffer;
+
+	// Dirty state
+	vector<bool> m_dirtyRegions;
+	bool m_hasDirtyRegions;
+	bool m_needsRebuild;
+};
+
+END_SAUCE_NAMESPACE
+
+#endif // SAUCE_STATIC_SPRITE_LAYER_H
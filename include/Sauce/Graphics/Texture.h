@@ -6,11 +6,90 @@
 
 BEGIN_SAUCE_NAMESPACE
 
+class Texture2D;
+class GraphicsContext;
+
+/**
+ * Compact reference to a Texture2D (20 bits of registry slot and 12 bits of generation).
+ * A value of 0 means no texture. The slot's generation changes when the texture is
+ * deleted, so handles to deleted textures resolve to nullptr instead of dangling.
+ */
+struct TextureHandle
+{
+	Uint32 value;
+
+	bool isValid() const { return value != 0; }
+	bool operator==(const TextureHandle &other) const { return value == other.value; }
+	bool operator!=(const TextureHandle &other) const { return value != other.value; }
+};
+
+/**
+ * \brief Hands out TextureHandles for textures owned by shared_ptrs.
+ *
+ * A texture is registered the first time a handle to it is requested, and is
+ * removed from the registry when it is deleted. Looking up a handle is an
+ * array access and a generation check.
+ */
+class SAUCE_API TextureRegistry
+{
+	friend class Texture2D;
+public:
+	/**
+	 * Returns the handle of \p texture, registering it if needed.
+	 * Returns an invalid handle if \p texture is nullptr.
+	 */
+	static TextureHandle add(const shared_ptr<Texture2D> &texture);
+
+	/**
+	 * Returns the texture of \p handle, or nullptr if the texture has been deleted.
+	 * Does not keep the texture alive.
+	 */
+	static Texture2D *get(const TextureHandle handle);
+
+	/**
+	 * Returns a shared_ptr to the texture of \p handle, or nullptr if the texture has been deleted.
+	 */
+	static shared_ptr<Texture2D> lock(const TextureHandle handle);
+
+	/**
+	 * Returns the number of registered textures.
+	 */
+	static uint getTextureCount();
+
+private:
+	struct Entry
+	{
+		Entry() :
+			texture(nullptr),
+			generation(1)
+		{
+		}
+
+		Texture2D *texture;
+		weak_ptr<Texture2D> owner;
+		Uint32 generation;
+	};
+
+	static Entry *getEntry(const TextureHandle handle);
+	static void remove(const TextureHandle handle);
+
+	// Slots are stored in fixed-size chunks so that entries never move
+	static Entry *s_chunks[];
+	static uint s_slotCount;
+
+	// Free slots are reused in the order they were freed, so that a slot's generation
+	// advances as slowly as possible. Slots whose generation would wrap are retired
+	static queue<uint> s_freeSlots;
+	static uint s_retiredSlotCount;
+	static mutex s_mutex;
+};
+
 class SAUCE_API Texture2D
 {
 	friend class RenderTarget2D;
 	friend class GraphicsContext;
 	friend class Shader;
+	friend class TextureRegistry;
 public:
 	Texture2D();
 	virtual ~Texture2D();
@@ -55,9 +134,29 @@ public:
 
 	void exportToFile(string path);
 
+	/**
+	 * Returns the registry handle of the texture. Invalid until the texture
+	 * has been registered with TextureRegistry::add().
+	 */
+	TextureHandle getHandle() const { return m_handle; }
+
+	/**
+	 * Returns a number that changes every time the pixels are updated or cleared.
+	 */
+	uint getVersion() const { return m_version; }
+
+	/**
+	 * Returns true if the texture belongs to a render target. Its pixels then
+	 * change when it is drawn to, which doesn't change the version.
+	 */
+	bool isRenderTarget() const { return m_renderTarget; }
+
 protected:
 	virtual void updateFiltering() = 0;
 
+	// Draws the shapes batched with this texture. Called before the texture is changed
+	void flushPrimitives();
+
 	TextureFilter m_filter;
 	TextureWrapping m_wrapping;
 
@@ -67,6 +166,12 @@ protected:
 	uint m_width;
 	uint m_height;
 	PixelFormat m_pixelFormat;
+	uint m_version;
+
+private:
+	TextureHandle m_handle;
+	bool m_renderTarget;
+	GraphicsContext *m_batchingContext; // Context with a pending shape batch using this texture
 };
 
 template class SAUCE_API shared_ptr<Texture2D>;
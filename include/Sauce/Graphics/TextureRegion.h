@@ -11,10 +11,6 @@ public:
 	TextureRegion();
 	TextureRegion(const Vector2F &uv0, const Vector2F &uv1);
 	TextureRegion(const float u0, const float v0, const float u1, const float v1);
-	TextureRegion(const TextureRegion &other);
-	~TextureRegion();
-
-	TextureRegion &operator=(const TextureRegion &other);
 
 	void setRegion(const Vector2F &uv0, const Vector2F &uv1);
 	void setRegion(const float u0, const float v0, const float u1, const float v1);
@@ -35,10 +35,14 @@ enum VertexAttribute
 **	Vertex format													**
 **********************************************************************/
 class Vertex;
+struct VertexPCT;
+template<typename... Attributes> struct VertexLayout;
 class SAUCE_API VertexFormat
 {
 	friend class Game;
 	friend class Vertex;
+	friend struct VertexPCT;
+	template<typename... Attributes> friend struct VertexLayout;
 	friend class VertexBuffer;
 public:
 	VertexFormat();
@@ -84,6 +88,192 @@ private:
 	uint m_vertexByteSize;
 };
 
+/*********************************************************************
+**	Vertex layout													**
+**********************************************************************/
+
+/**
+ * Data type of a C++ type.
+ */
+template<typename T> struct VertexDataType;
+template<> struct VertexDataType<float> { static const DataType value = SAUCE_FLOAT; };
+template<> struct VertexDataType<uint> { static const DataType value = SAUCE_UINT; };
+template<> struct VertexDataType<int> { static const DataType value = SAUCE_INT; };
+template<> struct VertexDataType<ushort> { static const DataType value = SAUCE_USHORT; };
+template<> struct VertexDataType<short> { static const DataType value = SAUCE_SHORT; };
+template<> struct VertexDataType<uchar> { static const DataType value = SAUCE_UBYTE; };
+template<> struct VertexDataType<char> { static const DataType value = SAUCE_BYTE; };
+
+/**
+ * Vertex attribute with \p ElementCount elements of type \p T. Used with VertexLayout.
+ */
+template<VertexAttribute Attribute, int ElementCount, typename T>
+struct Attr
+{
+	static_assert(ElementCount >= 1 && ElementCount <= 4, "Attr: Element count must be in the range [1, 4]");
+
+	static const VertexAttribute attribute = Attribute;
+	static const int elementCount = ElementCount;
+	static const DataType dataType = VertexDataType<T>::value;
+	static const uint sizeInBytes = ElementCount * sizeof(T);
+};
+
+// Byte offset of attribute A in a list of Attrs. Internal
+template<VertexAttribute A, typename... Attributes>
+struct VertexLayoutOffset
+{
+	static const uint value = 0;
+	static const bool found = false;
+};
+
+template<VertexAttribute A, typename First, typename... Rest>
+struct VertexLayoutOffset<A, First, Rest...>
+{
+	static const bool found = First::attribute == A || VertexLayoutOffset<A, Rest...>::found;
+	static const uint value = First::attribute == A ? 0 : First::sizeInBytes + VertexLayoutOffset<A, Rest...>::value;
+};
+
+// Total size and attribute order of a list of Attrs. Internal
+template<typename... Attributes>
+struct VertexLayoutInfo
+{
+	static const uint stride = 0;
+	static const bool sorted = true;
+	static const int firstAttribute = VERTEX_ATTRIB_MAX;
+};
+
+template<typename First, typename... Rest>
+struct VertexLayoutInfo<First, Rest...>
+{
+	static const uint stride = First::sizeInBytes + VertexLayoutInfo<Rest...>::stride;
+	static const bool sorted = VertexLayoutInfo<Rest...>::sorted && int(First::attribute) < VertexLayoutInfo<Rest...>::firstAttribute;
+	static const int firstAttribute = First::attribute;
+};
+
+/**
+ * \brief Vertex format known at compile time.
+ *
+ * For example VertexLayout<Attr<VERTEX_POSITION, 3, float>, Attr<VERTEX_TEX_COORD, 2, float>>.
+ * Offsets and the stride are compile-time constants. The attributes must be
+ * listed in VertexAttribute order, which is the order VertexFormat lays them out in.
+ * Use SAUCE_CHECK_VERTEX_LAYOUT to check that a vertex struct matches a layout.
+ */
+template<typename... Attributes>
+struct VertexLayout
+{
+	static_assert(sizeof...(Attributes) > 0, "VertexLayout: Needs at least one attribute");
+	static_assert(VertexLayoutInfo<Attributes...>::sorted, "VertexLayout: Attributes must be listed in VertexAttribute order");
+
+	static const uint stride = VertexLayoutInfo<Attributes...>::stride;
+
+	/**
+	 * Returns the byte offset of attribute \p A. Fails to compile if the layout doesn't have it.
+	 */
+	template<VertexAttribute A>
+	static constexpr uint offset()
+	{
+		static_assert(VertexLayoutOffset<A, Attributes...>::found, "VertexLayout: Attribute is not in the layout");
+		return VertexLayoutOffset<A, Attributes...>::value;
+	}
+
+	/**
+	 * Calls \p function(attribute, elementCount, dataType, offset) for every attribute.
+	 * The calls are expanded at compile time, so there is no loop or switch.
+	 */
+	template<typename Function>
+	static void forEachAttribute(Function function)
+	{
+		const int expand[] = { (function(Attributes::attribute, Attributes::elementCount, Attributes::dataType, VertexLayoutOffset<Attributes::attribute, Attributes...>::value), 0)... };
+		(void) expand;
+	}
+
+	/**
+	 * Returns the layout as a VertexFormat, for the draw calls and vertex buffers.
+	 * Built once, without going through VertexFormat::set().
+	 */
+	static const VertexFormat &getFormat()
+	{
+		static const VertexFormat format = createFormat();
+		return format;
+	}
+
+private:
+	static VertexFormat createFormat()
+	{
+		VertexFormat format;
+		forEachAttribute([&format](const VertexAttribute attribute, const int elementCount, const DataType dataType, const uint offset)
+		{
+			format.m_attributes[attribute].elementCount = elementCount;
+			format.m_attributes[attribute].dataType = dataType;
+			format.m_attributes[attribute].offset = offset;
+		});
+		format.m_vertexByteSize = stride;
+		return format;
+	}
+};
+
+/**
+ * Checks at compile time that \p member of vertex struct \p Struct is where \p Layout puts \p attribute.
+ * Check the size with static_assert(sizeof(Struct) == Layout::stride, ...).
+ */
+#define SAUCE_CHECK_VERTEX_LAYOUT(Layout, Struct, attribute, member) \
+	static_assert(offsetof(Struct, member) == Layout::offset<attribute>(), #Struct "::" #member " does not match the vertex layout")
+
+/*********************************************************************
+**	POD vertex types												**
+**********************************************************************/
+
+/**
+ * Position (2 floats), color (4 ubytes), texture coord (2 floats).
+ * Laid out like getFormat(), so arrays of it can be drawn and uploaded as they are.
+ */
+struct SAUCE_API VertexPCT
+{
+	float x, y;
+	uchar r, g, b, a;
+	float u, v;
+
+	void set(const float x, const float y, const Color &color, const float u = 0.0f, const float v = 0.0f)
+	{
+		this->x = x; this->y = y;
+		r = color.getR(); g = color.getG(); b = color.getB(); a = color.getA();
+		this->u = u; this->v = v;
+	}
+
+	typedef VertexLayout<Attr<VERTEX_POSITION, 2, float>, Attr<VERTEX_COLOR, 4, uchar>, Attr<VERTEX_TEX_COORD, 2, float>> Layout;
+	static const VertexFormat &getFormat() { return Layout::getFormat(); }
+};
+
+static_assert(sizeof(VertexPCT) == VertexPCT::Layout::stride, "VertexPCT does not match its layout");
+SAUCE_CHECK_VERTEX_LAYOUT(VertexPCT::Layout, VertexPCT, VERTEX_POSITION, x);
+SAUCE_CHECK_VERTEX_LAYOUT(VertexPCT::Layout, VertexPCT, VERTEX_COLOR, r);
+SAUCE_CHECK_VERTEX_LAYOUT(VertexPCT::Layout, VertexPCT, VERTEX_TEX_COORD, u);
+
+/**
+ * Position (2 floats), color (4 ubytes), texture coord (2 floats) and texture slot (1 float).
+ * The slot is the third texture coordinate. Drawn by the multi-texture shader.
+ */
+struct SAUCE_API VertexPCTS
+{
+	float x, y;
+	uchar r, g, b, a;
+	float u, v, slot;
+
+	typedef VertexLayout<Attr<VERTEX_POSITION, 2, float>, Attr<VERTEX_COLOR, 4, uchar>, Attr<VERTEX_TEX_COORD, 3, float>> Layout;
+	static const VertexFormat &getFormat() { return Layout::getFormat(); }
+};
+
+static_assert(sizeof(VertexPCTS) == VertexPCTS::Layout::stride, "VertexPCTS does not match its layout");
+SAUCE_CHECK_VERTEX_LAYOUT(VertexPCTS::Layout, VertexPCTS, VERTEX_POSITION, x);
+SAUCE_CHECK_VERTEX_LAYOUT(VertexPCTS::Layout, VertexPCTS, VERTEX_COLOR, r);
+SAUCE_CHECK_VERTEX_LAYOUT(VertexPCTS::Layout, VertexPCTS, VERTEX_TEX_COORD, u);
+static_assert(offsetof(VertexPCTS, slot) == sizeof(VertexPCT), "VertexPCTS must start with the fields of VertexPCT");
+
+/**
+ * Largest vertex a VertexFormat can describe. Every attribute has at most 4 elements of at most 4 bytes.
+ */
+const uint VERTEX_MAX_SIZE_IN_BYTES = VERTEX_ATTRIB_MAX * 4 * sizeof(float);
+
 /*********************************************************************
 **	Vertex															**
 **********************************************************************/
@@ -130,15 +320,22 @@ public:
 	void set4ub(const VertexAttribute attrib, const uchar v0, const uchar v1, const uchar v2, const uchar v3);
 	void set4b(const VertexAttribute attrib, const char v0, const char v1, const char v2, const char v3);
 
-	void setData(const char *data) const;
+	void setData(const char *data);
 	void getData(char *data) const;
+
+	/**
+	 * Packs \p vertexCount vertices into interleaved vertex data in the format of the first vertex.
+	 * \p data is only grown, so it can be reused between calls without allocating.
+	 */
+	static void pack(const Vertex *vertices, const uint vertexCount, vector<char> &data);
 	
 	Vertex &operator=(const Vertex &other);
 
 	void print();
 
 private:
-	char *m_data;
+	// Stored in place, so vertices can be created and copied without allocating
+	char m_data[VERTEX_MAX_SIZE_IN_BYTES];
 	VertexFormat m_format;
 };
 
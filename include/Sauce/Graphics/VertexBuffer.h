@@ -6,6 +6,7 @@
 BEGIN_SAUCE_NAMESPACE
 
 class Vertex;
+class GraphicsContext;
 
 /*********************************************************************
 **	Vertex buffer													**
@@ -18,10 +19,19 @@ public:
 	void setData(const Vertex *vertices, const uint vertexCount);
 	char *getData() const;
 
+	// Set vertices from interleaved vertex data in the format fmt
+	void setData(const VertexFormat &fmt, const void *vertexData, const uint vertexCount);
+
+	// Replace vertices [startIdx, startIdx + vertexCount) with interleaved vertex data in the buffer's format
+	void setSubData(const uint startIdx, const void *vertexData, const uint vertexCount);
+
 	// Get vertex/vertex format/vertex count
 	VertexFormat getVertexFormat() const;
 	uint getSize() const { return m_size; }
 
+	// Get the graphics context storing the buffer
+	GraphicsContext *getGraphicsContext() const { return m_graphicsContext; }
+
 protected:
 
 	enum BufferType
@@ -30,9 +40,12 @@ protected:
 		DYNAMIC_BUFFER = GL_DYNAMIC_DRAW
 	};
 
-	VertexBuffer(const BufferType type);
+	VertexBuffer(GraphicsContext *graphicsContext, const BufferType type);
 	~VertexBuffer();
 
+	// Graphics context storing the buffer
+	GraphicsContext *m_graphicsContext;
+
 	// Buffer ID
 	GLuint m_id;
 
@@ -50,8 +63,8 @@ private:
 class SAUCE_API DynamicVertexBuffer : public VertexBuffer
 {
 public:
-	DynamicVertexBuffer();
-	DynamicVertexBuffer(const Vertex *vertices, const uint vertexCount);
+	DynamicVertexBuffer(GraphicsContext *graphicsContext);
+	DynamicVertexBuffer(GraphicsContext *graphicsContext, const Vertex *vertices, const uint vertexCount);
 
 	void modifyData(const uint startIdx, Vertex *vertex, const uint vertexCount);
 };
@@ -59,8 +72,8 @@ public:
 class SAUCE_API StaticVertexBuffer : public VertexBuffer
 {
 public:
-	StaticVertexBuffer();
-	StaticVertexBuffer(const Vertex *vertices, const uint vertexCount);
+	StaticVertexBuffer(GraphicsContext *graphicsContext);
+	StaticVertexBuffer(GraphicsContext *graphicsContext, const Vertex *vertices, const uint vertexCount);
 };
 
 /*********************************************************************
@@ -74,9 +87,15 @@ public:
 	void setData(const uint *indices, const uint indexCount);
 	char *getData() const;
 
+	// Replace indices [startIdx, startIdx + indexCount)
+	void setSubData(const uint startIdx, const uint *indices, const uint indexCount);
+
 	// Get size
 	uint getSize() const { return m_size; }
 
+	// Get the graphics context storing the buffer
+	GraphicsContext *getGraphicsContext() const { return m_graphicsContext; }
+
 protected:
 
 	enum BufferType
@@ -85,9 +104,12 @@ protected:
 		DYNAMIC_BUFFER = GL_DYNAMIC_DRAW
 	};
 
-	IndexBuffer(const BufferType type);
+	IndexBuffer(GraphicsContext *graphicsContext, const BufferType type);
 	~IndexBuffer();
 
+	// Graphics context storing the buffer
+	GraphicsContext *m_graphicsContext;
+
 	// Buffer ID
 	GLuint m_id;
 
@@ -102,8 +124,8 @@ private:
 class SAUCE_API DynamicIndexBuffer : public IndexBuffer
 {
 public:
-	DynamicIndexBuffer();
-	DynamicIndexBuffer(const uint *vertices, const uint indexCount);
+	DynamicIndexBuffer(GraphicsContext *graphicsContext);
+	DynamicIndexBuffer(GraphicsContext *graphicsContext, const uint *vertices, const uint indexCount);
 
 	void modifyData(const uint startIdx, uint *indices, const uint indexCount);
 };
@@ -111,8 +133,8 @@ public:
 class SAUCE_API StaticIndexBuffer : public IndexBuffer
 {
 public:
-	StaticIndexBuffer();
-	StaticIndexBuffer(const uint *vertices, const uint indexCount);
+	StaticIndexBuffer(GraphicsContext *graphicsContext);
+	StaticIndexBuffer(GraphicsContext *graphicsContext, const uint *vertices, const uint indexCount);
 };
 
 END_SAUCE_NAMESPACE
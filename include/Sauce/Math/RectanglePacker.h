@@ -13,7 +13,8 @@ class SAUCE_API RectanglePacker
 	friend class TextureAtlas;
 public:
 	RectanglePacker() :
-		m_maxWidth(2048)
+		m_maxWidth(2048),
+		m_maxHeight(0)
 	{
 	}
 
@@ -22,6 +23,12 @@ public:
 		m_maxWidth = width;
 	}
 
+	// Max canvas height. pack() returns an invalid result if the rectangles don't fit. 0 means no limit
+	void setMaxHeight(const int height)
+	{
+		m_maxHeight = height;
+	}
+
 
 	class SAUCE_API Entry : public Rect<uint>
 	{
@@ -93,6 +100,7 @@ public:
 private:
 	vector<Entry> m_rectangles;
 	int m_maxWidth;
+	int m_maxHeight;
 };
 
 END_SAUCE_NAMESPACE
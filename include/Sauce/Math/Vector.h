@@ -735,16 +735,6 @@ public:
 	}
  
 	// Operators
-	inline Vector4& operator=(const Vector4& v2)
-	{
-		if(this == &v2) return *this;
-		x = v2.x;
-		y = v2.y;
-		z = v2.z;
-		w = v2.w;
-		return *this;
-	}
-
 	inline Vector4& operator+=(const Vector4& v2)
 	{
 		x += v2.x;
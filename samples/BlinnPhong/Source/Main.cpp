@@ -103,13 +103,20 @@ Vector2F CUBE_TEX_COORDS[36] = {
 	Vector2F(0.0f, 1.0f)
 };
 
+struct CubeVertex
+{
+	float x, y, z;
+	float u, v;
+};
+
+typedef VertexLayout<Attr<VERTEX_POSITION, 3, float>, Attr<VERTEX_TEX_COORD, 2, float>> CubeVertexLayout;
+static_assert(sizeof(CubeVertex) == CubeVertexLayout::stride, "CubeVertex does not match its vertex layout");
+SAUCE_CHECK_VERTEX_LAYOUT(CubeVertexLayout, CubeVertex, VERTEX_POSITION, x);
+SAUCE_CHECK_VERTEX_LAYOUT(CubeVertexLayout, CubeVertex, VERTEX_TEX_COORD, u);
+
 void drawCube(GraphicsContext* graphicsContext, const float x, const float y, const float z, const float w, const float h, const float d)
 {
-	VertexFormat format;
-	format.set(VERTEX_POSITION, 3, SAUCE_FLOAT);
-	format.set(VERTEX_TEX_COORD, 2, SAUCE_FLOAT);
-	
-	Vertex *vertices = format.createVertices(36);
+	CubeVertex vertices[36];
 
 	Matrix4 mat;
 	mat.translate(x, y, z);
@@ -117,14 +124,12 @@ void drawCube(GraphicsContext* graphicsContext, const float x, const float y, co
 	for(int i = 0; i < 36; i++) {
 		Vector4F pos = mat * CUBE_VERTICES[i];
 		Vector2F tex = CUBE_TEX_COORDS[i];
-		vertices[i].set3f(VERTEX_POSITION, pos.x, pos.y, pos.z);
-		vertices[i].set2f(VERTEX_TEX_COORD, tex.x, tex.y);
+		vertices[i].x = pos.x; vertices[i].y = pos.y; vertices[i].z = pos.z;
+		vertices[i].u = tex.x; vertices[i].v = tex.y;
 	}
 
 	// Draw triangles
-	graphicsContext->drawPrimitives(GraphicsContext::PRIMITIVE_TRIANGLES, vertices, 36);
-
-	delete[] vertices;
+	graphicsContext->drawPrimitives(GraphicsContext::PRIMITIVE_TRIANGLES, CubeVertexLayout::getFormat(), vertices, 36);
 }
 
 class Simple3DGame : public Game
@@ -16,9 +16,9 @@ private:
 	Resource<Texture2D> m_sceneTexture;
 	Resource<Texture2D> m_tileTexture;
 
-	RenderTarget2D* m_occludersRenderTarget;
-	RenderTarget2D* m_shadowMapRenderTarget;
-	RenderTarget2D* m_shadowsRenderTarget;
+	// The render targets are transient targets of the frame graph. The occluder and shadow
+	// map targets of every light have the same size, so all lights share the same two targets
+	FrameGraph m_frameGraph;
 
 	Resource<Shader> m_shadowMapShader;
 	Resource<Shader> m_shadowRenderShader;
@@ -60,7 +60,6 @@ public:
 	ShadowCastingGame() :
 		Game("ShadowCasting"),
 		m_spriteBatch(0),
-		m_occludersRenderTarget(0),
 		m_debugState(DEBUG_STATE_NONE)
 	{
 	}
@@ -95,19 +94,8 @@ public:
 
 	void setLightMapResolution(const int size)
 	{
-		Vector2I viewSize = getWindow()->getSize();
-		
-		delete m_occludersRenderTarget;
-		delete m_shadowMapRenderTarget;
-		delete m_shadowsRenderTarget;
-
-		GraphicsContext *graphicsContext = getWindow()->getGraphicsContext();
-		m_occludersRenderTarget = graphicsContext->createRenderTarget(size, size);
-		m_shadowMapRenderTarget = graphicsContext->createRenderTarget(size, 1);
-		m_shadowsRenderTarget   = graphicsContext->createRenderTarget(viewSize.x, viewSize.y);
-		m_shadowMapRenderTarget->getTexture()->setWrapping(Texture2D::REPEAT);
-
-		m_lightMapSize = size;
+		// The frame graph creates targets of the new size, and deletes the old ones when they go unused
+		m_lightMapSize = max(size, 1);
 	}
 
 	void onKeyEvent(KeyEvent *e)
@@ -162,51 +150,54 @@ public:
 		// Draw scene
 		drawScene(context);
 
+		// Declare the passes of this frame
+		m_frameGraph.reset();
+		const uint shadows = m_frameGraph.createRenderTarget("Shadows", (uint) viewSize.x, (uint) viewSize.y);
+
 		// Fill shadows render target with black
-		context->pushRenderTarget(m_shadowsRenderTarget);
-		context->clear(GraphicsContext::COLOR_BUFFER, Color(20, 20, 20, 255));
-		context->popRenderTarget();
+		const uint clearPass = m_frameGraph.addPass("Clear shadows", [](GraphicsContext *context)
+		{
+			context->clear(GraphicsContext::COLOR_BUFFER, Color(20, 20, 20, 255));
+		});
+		m_frameGraph.write(clearPass, shadows);
 
 		// Draw lights
+		uint occluders = 0, shadowMap = 0;
 		for(Light *l : m_lights)
 		{
-			drawLight(l, m_shadowsRenderTarget, context);
+			addLightPasses(l, shadows, occluders, shadowMap);
 		}
 
-		// Debug draw
-		switch(m_debugState)
+		// Draw the debug view and the shadows to the screen. The debug view shows the targets of the last light
+		const uint compositePass = m_frameGraph.addPass("Composite", [this, shadows, occluders, shadowMap, viewSize](GraphicsContext *context)
 		{
-			case SHOW_OCCLUDER_MAP:
+			RenderTarget2D *debugTarget = nullptr;
+			switch(m_debugState)
 			{
-				context->setTexture(0); context->drawRectangle(0, 0, m_lightMapSize, m_lightMapSize, Color(0, 0, 0, 255));
-				context->setTexture(m_occludersRenderTarget->getTexture()); context->drawRectangle(0, 0, m_lightMapSize, m_lightMapSize);
+				case SHOW_OCCLUDER_MAP: debugTarget = m_frameGraph.getRenderTarget(occluders); break;
+				case SHOW_SHADOW_MAP: debugTarget = m_frameGraph.getRenderTarget(shadowMap); break;
+				case SHOW_SHADOW_RENDER: debugTarget = m_frameGraph.getRenderTarget(shadows); break;
+				default: break;
 			}
-			break;
 
-			case SHOW_SHADOW_MAP:
+			if(debugTarget)
 			{
 				context->setTexture(0); context->drawRectangle(0, 0, m_lightMapSize, m_lightMapSize, Color(0, 0, 0, 255));
-				context->setTexture(m_shadowMapRenderTarget->getTexture()); context->drawRectangle(0, 0, m_lightMapSize, m_lightMapSize);
+				context->setTexture(debugTarget->getTexture()); context->drawRectangle(0, 0, m_lightMapSize, m_lightMapSize);
 			}
-			break;
 
-			case SHOW_SHADOW_RENDER:
-			{
-				context->setTexture(0); context->drawRectangle(0, 0, m_lightMapSize, m_lightMapSize, Color(0, 0, 0, 255));
-				context->setTexture(m_shadowsRenderTarget->getTexture()); context->drawRectangle(0, 0, m_lightMapSize, m_lightMapSize);
-			}
-			break;
+			// Draw shadows
+			context->setBlendState(BlendState::PRESET_MULTIPLY);
+			context->setTexture(m_frameGraph.getRenderTarget(shadows)->getTexture());
+			context->drawRectangle(0, 0, viewSize.x, viewSize.y);
+			context->setTexture(0);
+			context->setBlendState(BlendState::PRESET_ALPHA_BLEND);
+		});
+		m_frameGraph.read(compositePass, shadows);
+		if(m_debugState == SHOW_OCCLUDER_MAP && !m_lights.empty()) m_frameGraph.read(compositePass, occluders);
+		if(m_debugState == SHOW_SHADOW_MAP && !m_lights.empty()) m_frameGraph.read(compositePass, shadowMap);
 
-			default:
-				break;
-		}
-
-		// Draw shadows
-		context->setBlendState(BlendState::PRESET_MULTIPLY);
-		context->setTexture(m_shadowsRenderTarget->getTexture());
-		context->drawRectangle(0, 0, viewSize.x, viewSize.y);
-		context->setTexture(0);
-		context->setBlendState(BlendState::PRESET_ALPHA_BLEND);
+		m_frameGraph.execute(context);
 
 		// Draw info
 		drawInfo(context);
@@ -231,37 +222,51 @@ public:
 		context->setTexture(0);
 	}
 
-	void drawLight(Light *light, RenderTarget2D *dest, GraphicsContext *context)
+	void addLightPasses(Light *light, const uint dest, uint &occluders, uint &shadowMap)
 	{
-		context->disable(GraphicsContext::BLEND);
+		occluders = m_frameGraph.createRenderTarget("Occluders", m_lightMapSize, m_lightMapSize);
+		shadowMap = m_frameGraph.createRenderTarget("Shadow map", m_lightMapSize, 1);
+		const uint occludersTarget = occluders, shadowMapTarget = shadowMap;
 
 		// Draw occluders to render target
-		context->pushRenderTarget(m_occludersRenderTarget);
-		context->clear(GraphicsContext::COLOR_BUFFER);
-		context->setTexture(m_sceneTexture);
-		context->drawRectangle(((Vector2F(light->radius * 0.5f) - light->position) / light->radius) * m_lightMapSize, m_sceneTexture->getSize() * m_lightMapSize / light->radius);
-		context->popRenderTarget();
+		const uint occludersPass = m_frameGraph.addPass("Occluders", [this, light](GraphicsContext *context)
+		{
+			context->disable(GraphicsContext::BLEND);
+			context->clear(GraphicsContext::COLOR_BUFFER);
+			context->setTexture(m_sceneTexture);
+			context->drawRectangle(((Vector2F(light->radius * 0.5f) - light->position) / light->radius) * m_lightMapSize, m_sceneTexture->getSize() * m_lightMapSize / light->radius);
+		});
+		m_frameGraph.write(occludersPass, occludersTarget);
 
 		// Create 1D shadow map
-		context->pushRenderTarget(m_shadowMapRenderTarget);
-		context->setShader(m_shadowMapShader);
-		m_shadowMapShader->setUniform2f("u_Resolution", m_lightMapSize, m_lightMapSize);
-		m_shadowMapShader->setUniform1f("u_Scale", 1.0f);
-		m_shadowMapShader->setSampler2D("u_Texture", m_occludersRenderTarget->getTexture());
-		context->drawRectangle(0.0f, 0.0f, m_lightMapSize, m_shadowMapRenderTarget->getHeight());
-		context->popRenderTarget();
-
-		// Render the shadows
-		context->pushRenderTarget(dest);
-		context->enable(GraphicsContext::BLEND);
-		context->setBlendState(BlendState::PRESET_ADDITIVE);
-		context->setShader(m_shadowRenderShader);
-		m_shadowRenderShader->setUniform2f("u_Resolution", m_lightMapSize, m_lightMapSize);
-		m_shadowRenderShader->setUniform3f("u_Color", light->color.getR() / 255.0f, light->color.getG() / 255.0f, light->color.getB() / 255.0f);
-		m_shadowRenderShader->setUniform1f("u_SoftShadows", 1.0f);
-		m_shadowRenderShader->setSampler2D("u_Texture", m_shadowMapRenderTarget->getTexture());
-		context->drawRectangle(light->position - Vector2F(light->radius * 0.5f), Vector2F(light->radius));
-		context->popRenderTarget();
+		const uint shadowMapPass = m_frameGraph.addPass("Shadow map", [this, occludersTarget, shadowMapTarget](GraphicsContext *context)
+		{
+			RenderTarget2D *shadowMapRenderTarget = m_frameGraph.getRenderTarget(shadowMapTarget);
+			shadowMapRenderTarget->getTexture()->setWrapping(Texture2D::REPEAT);
+			context->setShader(m_shadowMapShader);
+			m_shadowMapShader->setUniform2f("u_Resolution", m_lightMapSize, m_lightMapSize);
+			m_shadowMapShader->setUniform1f("u_Scale", 1.0f);
+			m_shadowMapShader->setSampler2D("u_Texture", m_frameGraph.getRenderTarget(occludersTarget)->getTexture());
+			context->drawRectangle(0.0f, 0.0f, m_lightMapSize, shadowMapRenderTarget->getHeight());
+		});
+		m_frameGraph.read(shadowMapPass, occludersTarget);
+		m_frameGraph.write(shadowMapPass, shadowMapTarget);
+
+		// Render the shadows. The lights are added on top of each other, so the pass reads its target too
+		const uint shadowsPass = m_frameGraph.addPass("Shadows", [this, light, shadowMapTarget](GraphicsContext *context)
+		{
+			context->enable(GraphicsContext::BLEND);
+			context->setBlendState(BlendState::PRESET_ADDITIVE);
+			context->setShader(m_shadowRenderShader);
+			m_shadowRenderShader->setUniform2f("u_Resolution", m_lightMapSize, m_lightMapSize);
+			m_shadowRenderShader->setUniform3f("u_Color", light->color.getR() / 255.0f, light->color.getG() / 255.0f, light->color.getB() / 255.0f);
+			m_shadowRenderShader->setUniform1f("u_SoftShadows", 1.0f);
+			m_shadowRenderShader->setSampler2D("u_Texture", m_frameGraph.getRenderTarget(shadowMapTarget)->getTexture());
+			context->drawRectangle(light->position - Vector2F(light->radius * 0.5f), Vector2F(light->radius));
+		});
+		m_frameGraph.read(shadowsPass, shadowMapTarget);
+		m_frameGraph.read(shadowsPass, dest);
+		m_frameGraph.write(shadowsPass, dest);
 	}
 
 	void drawInfo(GraphicsContext *context)
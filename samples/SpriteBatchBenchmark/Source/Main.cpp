@@ -0,0 +1,385 @@
+/* Include the SauceEngine framework */
+#include <Sauce/Sauce.h>
+using namespace sauce;
+
+// Number of sprites in each benchmark
+const uint SPRITE_COUNTS[] = { 1000, 10000, 100000 };
+const uint BENCHMARK_COUNT = sizeof(SPRITE_COUNTS) / sizeof(SPRITE_COUNTS[0]);
+
+// Number of frames each benchmark is measured over
+const uint FRAMES_PER_BENCHMARK = 100;
+
+// Number of iterations of the sort micro-benchmarks
+const uint SORT_ITERATIONS = 20;
+
+// Sort modes to compare draw call counts for
+const SpriteBatch::SpriteSortMode SORT_MODES[] = { SpriteBatch::DEFERRED, SpriteBatch::BACK_TO_FRONT, SpriteBatch::FRONT_TO_BACK, SpriteBatch::TEXTURE, SpriteBatch::IMMEDIATE };
+const char *SORT_MODE_NAMES[] = { "DEFERRED", "BACK_TO_FRONT", "FRONT_TO_BACK", "TEXTURE", "IMMEDIATE" };
+const uint SORT_MODE_COUNT = sizeof(SORT_MODES) / sizeof(SORT_MODES[0]);
+
+// Number of sprites used to compare sort modes
+const uint SORT_MODE_SPRITE_COUNT = 10000;
+
+// Texture slot counts to compare draw call counts for, in BACK_TO_FRONT mode
+const uint TEXTURE_SLOT_COUNTS[] = { 1, 8, 16 };
+const uint TEXTURE_SLOT_COUNT_COUNT = sizeof(TEXTURE_SLOT_COUNTS) / sizeof(TEXTURE_SLOT_COUNTS[0]);
+
+/**
+ * This sample measures the CPU cost of SpriteBatch.
+ * It compares the old depth/texture grouping (nested maps of lists)
+ * to the packed sort key grouping used by SpriteBatch::end(), and
+ * measures a full begin()/drawSprite()/end() frame at 1k, 10k and 100k sprites.
+ * Finally it reports the number of draw calls each sort mode needs, and
+ * how many draw calls multi-texture batching saves.
+ *
+ * Run with -headless to benchmark on the recording backend, without a GPU.
+ * The draws recorded by the graphics context are then checked against the
+ * numbers SpriteBatch reports, and the game quits when it is done.
+ */
+class SpriteBatchBenchmarkGame : public Game
+{
+	struct Result
+	{
+		Result() :
+			mapGroupingTime(0.0),
+			sortKeyGroupingTime(0.0),
+			frameTime(0.0),
+			frameCount(0)
+		{
+		}
+
+		double mapGroupingTime;
+		double sortKeyGroupingTime;
+		double frameTime;
+		uint frameCount;
+	};
+
+	SpriteBatch *m_spriteBatch;
+	Resource<Font> m_font;
+	vector<shared_ptr<Texture2D>> m_textures;
+	vector<Sprite> m_sprites;
+	Result m_results[BENCHMARK_COUNT];
+	uint m_currentBenchmark;
+	uint m_drawCallCounts[SORT_MODE_COUNT];
+	uint m_textureSlotDrawCallCounts[TEXTURE_SLOT_COUNT_COUNT];
+	bool m_sortModesMeasured;
+
+	// Set when running headless
+	HeadlessContext *m_headlessContext;
+	uint m_failedCheckCount;
+
+public:
+	SpriteBatchBenchmarkGame(const GraphicsBackend &graphicsBackend) :
+		Game("SpriteBatchBenchmark", SAUCE_DEFAULT_ORGANIZATION, graphicsBackend),
+		m_spriteBatch(0),
+		m_currentBenchmark(0),
+		m_sortModesMeasured(false),
+		m_headlessContext(0),
+		m_failedCheckCount(0)
+	{
+	}
+
+	void onStart(GameEvent *e)
+	{
+		GraphicsContext *graphicsContext = getWindow()->getGraphicsContext();
+		m_headlessContext = dynamic_cast<HeadlessContext*>(graphicsContext);
+		m_font = Resource<Font>("Arial");
+
+		// Create a few small textures
+		for(uint i = 0; i < 16; ++i)
+		{
+			uchar pixel[4] = { uchar(i * 16), uchar(255 - i * 16), 128, 255 };
+			m_textures.push_back(shared_ptr<Texture2D>(graphicsContext->createTexture(1, 1, pixel)));
+		}
+
+		// Create sprites with random positions, textures and a few depth layers
+		Random random(1234);
+		const uint maxSprites = SPRITE_COUNTS[BENCHMARK_COUNT - 1];
+		m_sprites.reserve(maxSprites);
+		for(uint i = 0; i < maxSprites; ++i)
+		{
+			Sprite sprite(m_textures[random.nextInt(m_textures.size() - 1)]);
+			sprite.setPosition(float(random.nextDouble(1280.0)), float(random.nextDouble(720.0)));
+			sprite.setSize(8.0f, 8.0f);
+			sprite.setDepth(float(random.nextInt(7)));
+			m_sprites.push_back(sprite);
+		}
+
+		m_spriteBatch = new SpriteBatch(maxSprites);
+
+		// Run the grouping micro-benchmarks
+		for(uint i = 0; i < BENCHMARK_COUNT; ++i)
+		{
+			m_results[i].mapGroupingTime = benchmarkMapGrouping(SPRITE_COUNTS[i]);
+			m_results[i].sortKeyGroupingTime = benchmarkSortKeyGrouping(SPRITE_COUNTS[i]);
+			LOG("%i sprites: map grouping %.3f ms, sort key grouping %.3f ms", SPRITE_COUNTS[i], m_results[i].mapGroupingTime * 1000.0, m_results[i].sortKeyGroupingTime * 1000.0);
+		}
+
+		Game::onStart(e);
+	}
+
+	void onEnd(GameEvent *e)
+	{
+		delete m_spriteBatch;
+		Game::onEnd(e);
+	}
+
+	/**
+	 * Grouping as SpriteBatch::end() did it before: a map of depths
+	 * to a map of textures to a list of sprites, rebuilt every frame.
+	 */
+	double benchmarkMapGrouping(const uint spriteCount)
+	{
+		Timer timer;
+		timer.start();
+		uint runCount = 0;
+		for(uint iteration = 0; iteration < SORT_ITERATIONS; ++iteration)
+		{
+			map<float, map<shared_ptr<Texture2D>, list<const Sprite*>>> layerTextureMap;
+			for(uint i = 0; i < spriteCount; ++i)
+			{
+				const Sprite *sprite = &m_sprites[i];
+				layerTextureMap[sprite->getDepth()][sprite->getTexture()].push_back(sprite);
+			}
+
+			for(map<float, map<shared_ptr<Texture2D>, list<const Sprite*>>>::iterator itr = layerTextureMap.begin(); itr != layerTextureMap.end(); ++itr)
+			{
+				runCount += itr->second.size();
+			}
+		}
+		timer.stop();
+		return timer.getElapsedTime() / SORT_ITERATIONS;
+	}
+
+	/**
+	 * Grouping as SpriteBatch::end() does it now: one packed 64-bit key
+	 * per sprite sorted with util::radixSort, then a walk over the runs.
+	 */
+	double benchmarkSortKeyGrouping(const uint spriteCount)
+	{
+		vector<Uint64> keys(spriteCount);
+		Timer timer;
+		timer.start();
+		uint runCount = 0;
+		for(uint iteration = 0; iteration < SORT_ITERATIONS; ++iteration)
+		{
+			unordered_map<const Texture2D*, uint> textureIds;
+			for(uint i = 0; i < spriteCount; ++i)
+			{
+				const Sprite &sprite = m_sprites[i];
+				const float depth = sprite.getDepth();
+				Uint32 depthBits;
+				memcpy(&depthBits, &depth, sizeof(depthBits));
+				depthBits = (depthBits & 0x80000000) ? ~depthBits : (depthBits | 0x80000000);
+				const uint textureId = textureIds.insert(make_pair(sprite.getTexture().get(), uint(textureIds.size()))).first->second;
+				keys[i] = (Uint64(depthBits) << 32) | (Uint64(textureId) << 20) | i;
+			}
+
+			util::radixSort(&keys[0], spriteCount);
+
+			for(uint i = 0; i < spriteCount; ++i)
+			{
+				if(i + 1 == spriteCount || (keys[i] >> 20) != (keys[i + 1] >> 20)) runCount++;
+			}
+		}
+		timer.stop();
+		return timer.getElapsedTime() / SORT_ITERATIONS;
+	}
+
+	void onTick(TickEvent *e)
+	{
+		Game::onTick(e);
+	}
+
+	void onDraw(DrawEvent *e)
+	{
+		GraphicsContext *graphicsContext = e->getGraphicsContext();
+
+		// Measure a full sprite batch frame
+		if(m_currentBenchmark < BENCHMARK_COUNT)
+		{
+			Result &result = m_results[m_currentBenchmark];
+			const uint spriteCount = SPRITE_COUNTS[m_currentBenchmark];
+
+			Timer timer;
+			timer.start();
+			m_spriteBatch->begin(graphicsContext);
+			for(uint i = 0; i < spriteCount; ++i)
+			{
+				m_spriteBatch->drawSprite(m_sprites[i]);
+			}
+			m_spriteBatch->end();
+			timer.stop();
+
+			result.frameTime += timer.getElapsedTime();
+			if(++result.frameCount == FRAMES_PER_BENCHMARK)
+			{
+				LOG("%i sprites: %.3f ms per frame", spriteCount, result.frameTime / result.frameCount * 1000.0);
+				m_currentBenchmark++;
+			}
+		}
+		else if(!m_sortModesMeasured)
+		{
+			// Measure draw calls per sort mode
+			for(uint i = 0; i < SORT_MODE_COUNT; ++i)
+			{
+				// FRONT_TO_BACK expects the depth buffer to be cleared to 1
+				graphicsContext->clear(GraphicsContext::DEPTH_BUFFER, Color(255, 255, 255, 255));
+
+				const uint recordedDrawCount = getRecordedDrawCount();
+				m_spriteBatch->begin(graphicsContext, SpriteBatch::State(SORT_MODES[i]));
+				for(uint j = 0; j < SORT_MODE_SPRITE_COUNT; ++j)
+				{
+					m_spriteBatch->drawSprite(m_sprites[j]);
+				}
+				m_spriteBatch->end();
+
+				m_drawCallCounts[i] = m_spriteBatch->getStats().drawCallCount;
+				LOG("%s: %i draw calls for %i sprites", SORT_MODE_NAMES[i], m_drawCallCounts[i], SORT_MODE_SPRITE_COUNT);
+				checkRecordedDrawCount(SORT_MODE_NAMES[i], getRecordedDrawCount() - recordedDrawCount);
+			}
+
+			// Measure draw calls per texture slot count
+			for(uint i = 0; i < TEXTURE_SLOT_COUNT_COUNT; ++i)
+			{
+				m_spriteBatch->setTextureSlotCount(TEXTURE_SLOT_COUNTS[i]);
+				const uint recordedDrawCount = getRecordedDrawCount();
+				m_spriteBatch->begin(graphicsContext, SpriteBatch::State(SpriteBatch::BACK_TO_FRONT));
+				for(uint j = 0; j < SORT_MODE_SPRITE_COUNT; ++j)
+				{
+					m_spriteBatch->drawSprite(m_sprites[j]);
+				}
+				m_spriteBatch->end();
+				checkRecordedDrawCount("Multi-texture", getRecordedDrawCount() - recordedDrawCount);
+
+				m_textureSlotDrawCallCounts[i] = m_spriteBatch->getStats().drawCallCount;
+				LOG("%i texture slots: %i draw calls for %i sprites (%.1fx fewer)", TEXTURE_SLOT_COUNTS[i], m_textureSlotDrawCallCounts[i], SORT_MODE_SPRITE_COUNT, float(m_textureSlotDrawCallCounts[0]) / m_textureSlotDrawCallCounts[i]);
+			}
+			m_spriteBatch->setTextureSlotCount(1);
+			m_sortModesMeasured = true;
+
+			// There is nothing to look at when running headless
+			if(m_headlessContext)
+			{
+				checkShapeBatching(graphicsContext);
+				LOG("Headless checks done, %i failed", m_failedCheckCount);
+				end();
+			}
+		}
+
+		// Show results
+		graphicsContext->clear(GraphicsContext::COLOR_BUFFER);
+		m_spriteBatch->begin(graphicsContext);
+		for(uint i = 0; i < BENCHMARK_COUNT; ++i)
+		{
+			const Result &result = m_results[i];
+			stringstream ss;
+			ss.precision(3);
+			ss << fixed << SPRITE_COUNTS[i] << " sprites: map grouping " << result.mapGroupingTime * 1000.0 << " ms, sort key grouping " << result.sortKeyGroupingTime * 1000.0 << " ms";
+			if(result.frameCount > 0)
+			{
+				ss << ", frame " << result.frameTime / result.frameCount * 1000.0 << " ms";
+			}
+			m_font->draw(m_spriteBatch, 10.0f, 10.0f + i * 30.0f, ss.str());
+		}
+
+		if(m_sortModesMeasured)
+		{
+			for(uint i = 0; i < SORT_MODE_COUNT; ++i)
+			{
+				stringstream ss;
+				ss << SORT_MODE_NAMES[i] << ": " << m_drawCallCounts[i] << " draw calls for " << SORT_MODE_SPRITE_COUNT << " sprites";
+				m_font->draw(m_spriteBatch, 10.0f, 10.0f + (BENCHMARK_COUNT + i + 1) * 30.0f, ss.str());
+			}
+
+			for(uint i = 0; i < TEXTURE_SLOT_COUNT_COUNT; ++i)
+			{
+				stringstream ss;
+				ss << "BACK_TO_FRONT, " << TEXTURE_SLOT_COUNTS[i] << " texture slots: " << m_textureSlotDrawCallCounts[i] << " draw calls for " << SORT_MODE_SPRITE_COUNT << " sprites";
+				m_font->draw(m_spriteBatch, 10.0f, 10.0f + (BENCHMARK_COUNT + SORT_MODE_COUNT + i + 2) * 30.0f, ss.str());
+			}
+		}
+		m_spriteBatch->end();
+
+		Game::onDraw(e);
+	}
+
+	/**
+	 * Returns the number of draws recorded by the headless context, or 0 when not running headless.
+	 */
+	uint getRecordedDrawCount() const
+	{
+		return m_headlessContext ? m_headlessContext->getDrawCount() : 0;
+	}
+
+	/**
+	 * Checks that the last sprite batch made as many draws as the context recorded.
+	 */
+	void checkRecordedDrawCount(const char *name, const uint recordedDrawCount)
+	{
+		if(m_headlessContext && recordedDrawCount != m_spriteBatch->getStats().drawCallCount)
+		{
+			LOG("%s: SpriteBatch reports %i draw calls, but %i were recorded", name, m_spriteBatch->getStats().drawCallCount, recordedDrawCount);
+			m_failedCheckCount++;
+		}
+	}
+
+	/**
+	 * Checks that two batched shapes are drawn separately when a uniform of their
+	 * shader or the pixels of their texture change between them.
+	 */
+	void checkShapeBatching(GraphicsContext *graphicsContext)
+	{
+		shared_ptr<Shader> shader(graphicsContext->createShader("", "", ""));
+		graphicsContext->setShader(shader);
+		uint recordedDrawCount = getRecordedDrawCount();
+		shader->setUniform1f("u_x", 1.0f);
+		graphicsContext->drawRectangle(0.0f, 0.0f, 8.0f, 8.0f);
+		shader->setUniform1f("u_x", 2.0f);
+		graphicsContext->drawRectangle(8.0f, 0.0f, 8.0f, 8.0f);
+		graphicsContext->flushPrimitives();
+		checkShapeDrawCount("Uniform change", getRecordedDrawCount() - recordedDrawCount);
+		graphicsContext->setShader(0);
+
+		graphicsContext->setTexture(m_textures[0]);
+		recordedDrawCount = getRecordedDrawCount();
+		graphicsContext->drawRectangle(0.0f, 0.0f, 8.0f, 8.0f);
+		uchar pixel[4] = { 255, 255, 255, 255 };
+		m_textures[0]->updatePixmap(Pixmap(1, 1, pixel));
+		graphicsContext->drawRectangle(8.0f, 0.0f, 8.0f, 8.0f);
+		graphicsContext->flushPrimitives();
+		checkShapeDrawCount("Texture update", getRecordedDrawCount() - recordedDrawCount);
+		graphicsContext->setTexture(0);
+	}
+
+	/**
+	 * Checks that two shapes were drawn with two draw calls.
+	 */
+	void checkShapeDrawCount(const char *name, const uint recordedDrawCount)
+	{
+		if(recordedDrawCount != 2)
+		{
+			LOG("%s: expected 2 draw calls between two shapes, but %i were recorded", name, recordedDrawCount);
+			m_failedCheckCount++;
+		}
+	}
+};
+
+/* Main entry point. This is where our program first starts executing. */
+int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, INT)
+{
+	// Run on the recording backend with -headless. The window is
+	// never shown, so it doesn't need a display either
+	GraphicsBackend graphicsBackend;
+	for(int i = 0; i < __argc; i++)
+	{
+		if(string(__argv[i]) == "-headless")
+		{
+			graphicsBackend = GraphicsBackend(GraphicsBackend::SAUCE_RECORDING);
+			SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+		}
+	}
+
+	SpriteBatchBenchmarkGame game(graphicsBackend);
+	return game.run();
+}
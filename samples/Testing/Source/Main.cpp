@@ -324,8 +324,8 @@ public:
 			indices[i * 6 + 5] = i * 4 + 3;
 		}
 
-		tileVBO = new StaticVertexBuffer(vertices, WORLD_WIDTH * WORLD_HEIGHT * 4);
-		tileIBO = new StaticIndexBuffer(indices, WORLD_WIDTH * WORLD_HEIGHT * 6);
+		tileVBO = new StaticVertexBuffer(getWindow()->getGraphicsContext(), vertices, WORLD_WIDTH * WORLD_HEIGHT * 4);
+		tileIBO = new StaticIndexBuffer(getWindow()->getGraphicsContext(), indices, WORLD_WIDTH * WORLD_HEIGHT * 6);
 
 		//delete[] vertices;
 		//delete[] indices;
@@ -396,8 +396,8 @@ public:
 			buildingCount++;
 		}
 
-		buildingVBO = new StaticVertexBuffer(vertices, buildingCount * 4);
-		buildingIBO = new StaticIndexBuffer(indices, buildingCount * 6);
+		buildingVBO = new StaticVertexBuffer(getWindow()->getGraphicsContext(), vertices, buildingCount * 4);
+		buildingIBO = new StaticIndexBuffer(getWindow()->getGraphicsContext(), indices, buildingCount * 6);
 
 		//delete[] vertices;
 		//delete[] indices;
@@ -437,8 +437,8 @@ public:
 			unitCount++;
 		}
 
-		unitVBO = new StaticVertexBuffer(vertices, unitCount * 4);
-		unitIBO = new StaticIndexBuffer(indices, unitCount * 6);
+		unitVBO = new StaticVertexBuffer(getWindow()->getGraphicsContext(), vertices, unitCount * 4);
+		unitIBO = new StaticIndexBuffer(getWindow()->getGraphicsContext(), indices, unitCount * 6);
 	}
 
 	void onTick(TickEvent *e)
@@ -155,16 +155,13 @@ int Game::run()
 		GraphicsContext *graphicsContext = 0;
 		switch(m_graphicsBackend.type)
 		{
+			case GraphicsBackend::SAUCE_NULL: graphicsContext = new HeadlessContext(HeadlessContext::NULL_MODE); break;
+			case GraphicsBackend::SAUCE_RECORDING: graphicsContext = new HeadlessContext(HeadlessContext::RECORDING_MODE); break;
 			default: graphicsContext = new OpenGLContext(m_graphicsBackend.major, m_graphicsBackend.minor); break;
 		}
 		Window *mainWindow = graphicsContext->createWindow(m_name.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 720, windowFlags);
 		m_windows.push_back(mainWindow);
 
-		// Setup default vertex format
-		VertexFormat::s_vct.set(VERTEX_POSITION, 2, SAUCE_FLOAT);
-		VertexFormat::s_vct.set(VERTEX_COLOR, 4, SAUCE_UBYTE);
-		VertexFormat::s_vct.set(VERTEX_TEX_COORD, 2, SAUCE_FLOAT);
-
 		// Initialize input handler
 		m_inputManager = new InputManager("InputConfig.xml");
 
@@ -439,8 +436,8 @@ int Game::run()
 				DrawEvent e(alpha, graphicsContext);
 				onEvent(&e);
 			}
-			SDL_GL_SwapWindow(mainWindow->getSDLHandle());
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			graphicsContext->flushPrimitives();
+			graphicsContext->swapBuffers();
 
 			// Add fps sample
 			if(deltaTime != 0.0f)
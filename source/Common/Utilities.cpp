@@ -107,6 +107,101 @@ string util::asciiToStr(const uchar value)
 	return s;
 }
 
+// In-place MSD radix sort (American flag sort) on one byte of the key
+static void radixSortPass(Uint64 *keys, const uint count, const int shift)
+{
+	// Small buckets are faster to finish with insertion sort
+	if(count <= 32)
+	{
+		for(uint i = 1; i < count; ++i)
+		{
+			const Uint64 key = keys[i];
+			uint j = i;
+			for(; j > 0 && keys[j - 1] > key; --j)
+			{
+				keys[j] = keys[j - 1];
+			}
+			keys[j] = key;
+		}
+		return;
+	}
+
+	// Count the number of keys in each bucket
+	uint counts[256] = { 0 };
+	for(uint i = 0; i < count; ++i)
+	{
+		counts[(keys[i] >> shift) & 0xFF]++;
+	}
+
+	// If all keys share this byte there is nothing to permute
+	if(counts[(keys[0] >> shift) & 0xFF] == count)
+	{
+		if(shift > 0) radixSortPass(keys, count, shift - 8);
+		return;
+	}
+
+	// Find the start and end of every bucket
+	uint heads[256], tails[256];
+	uint offset = 0;
+	for(uint b = 0; b < 256; ++b)
+	{
+		heads[b] = offset;
+		offset += counts[b];
+		tails[b] = offset;
+	}
+
+	// Swap every key into its bucket
+	for(uint b = 0; b < 256; ++b)
+	{
+		while(heads[b] < tails[b])
+		{
+			Uint64 key = keys[heads[b]];
+			uint bucket = (key >> shift) & 0xFF;
+			while(bucket != b)
+			{
+				swap(key, keys[heads[bucket]++]);
+				bucket = (key >> shift) & 0xFF;
+			}
+			keys[heads[b]++] = key;
+		}
+	}
+
+	// Sort each bucket on the next byte
+	if(shift > 0)
+	{
+		offset = 0;
+		for(uint b = 0; b < 256; ++b)
+		{
+			if(counts[b] > 1)
+			{
+				radixSortPass(keys + offset, counts[b], shift - 8);
+			}
+			offset += counts[b];
+		}
+	}
+}
+
+void util::radixSort(Uint64 *keys, const uint count)
+{
+	if(count < 2) return;
+
+	// Find the most significant byte where the keys differ
+	Uint64 diff = 0;
+	for(uint i = 1; i < count; ++i)
+	{
+		diff |= keys[i] ^ keys[0];
+	}
+	if(diff == 0) return;
+
+	int shift = 56;
+	while(((diff >> shift) & 0xFF) == 0)
+	{
+		shift -= 8;
+	}
+
+	radixSortPass(keys, count, shift);
+}
+
 string util::getAbsoluteFilePath(const string &path)
 {
 	if(path.substr(0, 2) == ":/")
@@ -0,0 +1,120 @@
+//     _____                        ______             _            
+//    / ____|                      |  ____|           (_)           
+//   | (___   __ _ _   _  ___ ___  | |__   _ __   __ _ _ _ __   ___ 
+//    \___ \ / _` | | | |/ __/ _ \ |  __| | '_ \ / _` | | '_ \ / _ \
+//    ____) | (_| | |_| | (_|  __/ | |____| | | | (_| | | | | |  __/
+//   |_____/ \__,_|\__,_|\___\___| |______|_| |_|\__, |_|_| |_|\___|
+//                                                __/ |             
+//                                               |___/              
+// Made by Marcus "Bitsauce" Loo Vergara
+// 2011-2018 (C)
+
+#include <Sauce/Common.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+WorkerPool::WorkerPool(const uint threadCount) :
+	m_func(nullptr),
+	m_count(0),
+	m_grainSize(1),
+	m_nextIndex(0),
+	m_jobId(0),
+	m_pendingWorkers(0),
+	m_quit(false)
+{
+	uint count = threadCount;
+	if(count == 0)
+	{
+		const uint hardwareThreads = thread::hardware_concurrency();
+		count = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	for(uint i = 0; i < count; ++i)
+	{
+		m_threads.push_back(thread(&WorkerPool::workerMain, this));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for(uint i = 0; i < m_threads.size(); ++i)
+	{
+		m_threads[i].join();
+	}
+}
+
+void WorkerPool::parallelFor(const uint count, const uint grainSize, const function<void(uint, uint)> &func)
+{
+	if(count == 0) return;
+
+	// Not worth waking the workers for a single chunk
+	const uint chunkSize = max(grainSize, 1u);
+	if(m_threads.empty() || count <= chunkSize)
+	{
+		func(0, count);
+		return;
+	}
+
+	// Post job
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_func = &func;
+		m_count = count;
+		m_grainSize = chunkSize;
+		m_nextIndex = 0;
+		m_pendingWorkers = m_threads.size();
+		m_jobId++;
+	}
+	m_wakeCondition.notify_all();
+
+	// Help out
+	runChunks();
+
+	// Wait for every worker to finish with the job, so
+	// none of them can be looking at it when we return
+	unique_lock<mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this] { return m_pendingWorkers == 0; });
+	m_func = nullptr;
+}
+
+void WorkerPool::workerMain()
+{
+	Uint64 jobId = 0;
+	while(true)
+	{
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [this, jobId] { return m_quit || m_jobId != jobId; });
+			if(m_quit) return;
+			jobId = m_jobId;
+		}
+
+		runChunks();
+
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if(--m_pendingWorkers == 0)
+			{
+				m_doneCondition.notify_one();
+			}
+		}
+	}
+}
+
+void WorkerPool::runChunks()
+{
+	while(true)
+	{
+		const uint begin = m_nextIndex.fetch_add(m_grainSize);
+		if(begin >= m_count) break;
+		(*m_func)(begin, min(begin + m_grainSize, m_count));
+	}
+}
+
+END_SAUCE_NAMESPACE
@@ -0,0 +1,338 @@
+//     _____                        ______             _            
+//    / ____|                      |  ____|           (_)           
+//   | (___   __ _ _   _  ___ ___  | |__   _ __   __ _ _ _ __   ___ 
+//    \___ \ / _` | | | |/ __/ _ \ |  __| | '_ \ / _` | | '_ \ / _ \
+//    ____) | (_| | |_| | (_|  __/ | |____| | | | (_| | | | | |  __/
+//   |_____/ \__,_|\__,_|\___\___| |______|_| |_|\__, |_|_| |_|\___|
+//                                                __/ |             
+//                                               |___/              
+// Made by Marcus "Bitsauce" Loo Vergara
+// 2011-2018 (C)
+
+#include <Sauce/Common.h>
+#include <Sauce/graphics.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+// Border around each texture in a page. Filled with the texture's edge pixels to avoid bleeding
+const uint ATLAS_BORDER = 1;
+
+AutoAtlas::AutoAtlas(GraphicsContext *graphicsContext, const uint pageSize, const uint maxTextureSize, const uint maxPageCount) :
+	m_graphicsContext(graphicsContext),
+	m_pageSize(pageSize),
+	m_maxTextureSize(min(maxTextureSize, pageSize - ATLAS_BORDER * 2)),
+	m_maxPageCount(max(maxPageCount, 1u)),
+	m_evictionAge(300),
+	m_updateCount(0)
+{
+}
+
+AutoAtlas::~AutoAtlas()
+{
+	// Wait for packs in progress
+	for(uint i = 0; i < m_pages.size(); ++i)
+	{
+		if(m_pages[i].packing)
+		{
+			m_pages[i].pack.wait();
+		}
+	}
+}
+
+TextureHandle AutoAtlas::find(const TextureHandle textureHandle, const TextureRegion &region, TextureRegion &pageRegion)
+{
+	TextureHandle pageTexture = { 0 };
+	const Texture2D *texture = TextureRegistry::get(textureHandle);
+	if(!texture) return pageTexture;
+
+	unordered_map<Uint32, Entry>::iterator itr = m_entries.find(textureHandle.value);
+	if(itr != m_entries.end() && itr->second.version != texture->getVersion())
+	{
+		// The pixels have changed since they were copied. Take the texture out of
+		// its page, and copy and queue it again like a texture used for the first time
+		removeFromPage(textureHandle);
+		m_entries.erase(itr);
+		itr = m_entries.end();
+	}
+
+	if(itr == m_entries.end())
+	{
+		// First use of the texture. Queue it if it is small enough
+		Entry entry;
+		entry.texture = textureHandle;
+		entry.version = texture->getVersion();
+		entry.rejected = texture->isRenderTarget() || texture->getWidth() > m_maxTextureSize || texture->getHeight() > m_maxTextureSize;
+		if(!entry.rejected)
+		{
+			entry.pixmap = shared_ptr<Pixmap>(new Pixmap(texture->getPixmap()));
+			const PixelFormat format = entry.pixmap->getFormat();
+			entry.rejected = format.getComponents() != PixelFormat::RGBA || format.getDataType() != PixelFormat::UNSIGNED_BYTE;
+			if(entry.rejected)
+			{
+				entry.pixmap.reset();
+			}
+			else
+			{
+				m_queue.push_back(textureHandle);
+			}
+		}
+		itr = m_entries.insert(make_pair(textureHandle.value, entry)).first;
+	}
+
+	Entry &entry = itr->second;
+	entry.lastUsed = m_updateCount;
+	if(!entry.packed) return pageTexture;
+
+	// Texture wrapping doesn't work in an atlas
+	if(region.uv0.x < 0.0f || region.uv0.x > 1.0f || region.uv0.y < 0.0f || region.uv0.y > 1.0f ||
+	   region.uv1.x < 0.0f || region.uv1.x > 1.0f || region.uv1.y < 0.0f || region.uv1.y > 1.0f)
+	{
+		return pageTexture;
+	}
+
+	// Map the region into the texture's region of the page
+	const Vector2F size = entry.region.uv1 - entry.region.uv0;
+	pageRegion.uv0.set(entry.region.uv0.x + region.uv0.x * size.x, entry.region.uv0.y + region.uv0.y * size.y);
+	pageRegion.uv1.set(entry.region.uv0.x + region.uv1.x * size.x, entry.region.uv0.y + region.uv1.y * size.y);
+	return m_pages[entry.page].texture->getHandle();
+}
+
+void AutoAtlas::update()
+{
+	m_updateCount++;
+
+	// Forget textures that have been deleted
+	for(unordered_map<Uint32, Entry>::iterator itr = m_entries.begin(); itr != m_entries.end();)
+	{
+		if(!TextureRegistry::get(itr->second.texture))
+		{
+			removeFromPage(itr->second.texture);
+			itr = m_entries.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+
+	// Apply finished packs
+	for(uint i = 0; i < m_pages.size(); ++i)
+	{
+		Page &page = m_pages[i];
+		if(page.packing && page.pack.wait_for(chrono::seconds(0)) == future_status::ready)
+		{
+			page.packing = false;
+			applyPack(i, page.pack.get());
+		}
+	}
+
+	// Place queued textures in pages
+	vector<TextureHandle> queue;
+	queue.swap(m_queue);
+	for(uint i = 0; i < queue.size(); ++i)
+	{
+		// Skip textures that are gone, or that were queued again while already queued
+		unordered_map<Uint32, Entry>::iterator itr = m_entries.find(queue[i].value);
+		if(itr == m_entries.end() || itr->second.page >= 0) continue;
+
+		const int pageIndex = getPageForQueuedTexture();
+		if(pageIndex < 0)
+		{
+			// All pages are busy. Try again next update
+			m_queue.push_back(queue[i]);
+			continue;
+		}
+
+		Page &page = m_pages[pageIndex];
+		itr->second.page = pageIndex;
+		page.textures.push_back(queue[i]);
+		page.dirty = true;
+	}
+
+	// Start packing pages that changed
+	for(uint i = 0; i < m_pages.size(); ++i)
+	{
+		if(m_pages[i].dirty && !m_pages[i].packing)
+		{
+			startPack(i);
+		}
+	}
+}
+
+int AutoAtlas::getPageForQueuedTexture()
+{
+	// Use the first page with room
+	for(uint i = 0; i < m_pages.size(); ++i)
+	{
+		if(!m_pages[i].packing && !m_pages[i].full)
+		{
+			return i;
+		}
+	}
+
+	// Add a page
+	if(m_pages.size() < m_maxPageCount)
+	{
+		m_pages.push_back(Page());
+		m_pages.back().texture = shared_ptr<Texture2D>(m_graphicsContext->createTexture(m_pageSize, m_pageSize));
+		TextureRegistry::add(m_pages.back().texture);
+		return m_pages.size() - 1;
+	}
+
+	// Clear the least recently used page
+	int lruPage = -1;
+	uint lruLastUsed = 0;
+	for(uint i = 0; i < m_pages.size(); ++i)
+	{
+		if(m_pages[i].packing) continue;
+
+		uint lastUsed = 0;
+		for(uint j = 0; j < m_pages[i].textures.size(); ++j)
+		{
+			lastUsed = max(lastUsed, m_entries[m_pages[i].textures[j].value].lastUsed);
+		}
+
+		if(lruPage < 0 || lastUsed < lruLastUsed)
+		{
+			lruPage = i;
+			lruLastUsed = lastUsed;
+		}
+	}
+
+	if(lruPage >= 0)
+	{
+		// The textures are queued again the next time they are used
+		Page &page = m_pages[lruPage];
+		for(uint j = 0; j < page.textures.size(); ++j)
+		{
+			m_entries.erase(page.textures[j].value);
+		}
+		page.textures.clear();
+		page.full = false;
+	}
+	return lruPage;
+}
+
+void AutoAtlas::startPack(const uint pageIndex)
+{
+	Page &page = m_pages[pageIndex];
+	page.dirty = false;
+	if(page.textures.empty()) return;
+
+	vector<pair<TextureHandle, shared_ptr<Pixmap>>> textures;
+	for(uint i = 0; i < page.textures.size(); ++i)
+	{
+		textures.push_back(make_pair(page.textures[i], m_entries[page.textures[i].value].pixmap));
+	}
+
+	page.packing = true;
+	page.pack = async(launch::async, &AutoAtlas::packPage, textures, m_pageSize);
+}
+
+AutoAtlas::PackResult AutoAtlas::packPage(const vector<pair<TextureHandle, shared_ptr<Pixmap>>> &textures, const uint pageSize)
+{
+	RectanglePacker rectanglePacker;
+	rectanglePacker.setMaxWidth(pageSize);
+	rectanglePacker.setMaxHeight(pageSize);
+	for(uint i = 0; i < textures.size(); ++i)
+	{
+		const Pixmap *pixmap = textures[i].second.get();
+		rectanglePacker.addRectangle(util::intToStr(i), pixmap->getWidth() + ATLAS_BORDER * 2, pixmap->getHeight() + ATLAS_BORDER * 2, (void*) &textures[i]);
+	}
+
+	PackResult result;
+	const RectanglePacker::Result packerResult = rectanglePacker.pack();
+	if(!packerResult.valid) return result;
+
+	// Copy the textures into the page, extending their edges into the border
+	result.valid = true;
+	result.pixels.resize(pageSize * pageSize * 4, 0);
+	for(map<string, RectanglePacker::Entry>::const_iterator itr = packerResult.rectangles.begin(); itr != packerResult.rectangles.end(); ++itr)
+	{
+		const RectanglePacker::Entry &rect = itr->second;
+		const pair<TextureHandle, shared_ptr<Pixmap>> &texture = *(const pair<TextureHandle, shared_ptr<Pixmap>>*) rect.getData();
+		const Pixmap *pixmap = texture.second.get();
+		const int width = pixmap->getWidth(), height = pixmap->getHeight();
+		for(int y = -int(ATLAS_BORDER); y < height + int(ATLAS_BORDER); y++)
+		{
+			const int sourceY = min(max(y, 0), height - 1);
+			for(int x = -int(ATLAS_BORDER); x < width + int(ATLAS_BORDER); x++)
+			{
+				const int sourceX = min(max(x, 0), width - 1);
+				const uint pagePos = ((rect.getX() + ATLAS_BORDER + x) + (rect.getY() + ATLAS_BORDER + y) * pageSize) * 4;
+				memcpy(&result.pixels[pagePos], pixmap->getData() + (sourceX + sourceY * width) * 4, 4);
+			}
+		}
+		result.rectangles.push_back(make_pair(texture.first, Rect<uint>(rect.getX() + ATLAS_BORDER, rect.getY() + ATLAS_BORDER, width, height)));
+	}
+	return result;
+}
+
+void AutoAtlas::applyPack(const uint pageIndex, const PackResult &result)
+{
+	Page &page = m_pages[pageIndex];
+	if(!result.valid)
+	{
+		// The page is full. Evict textures that have not been used lately, and
+		// queue the textures that were never packed so they can go to another page
+		bool evicted = false;
+		vector<TextureHandle> textures;
+		for(uint i = 0; i < page.textures.size(); ++i)
+		{
+			unordered_map<Uint32, Entry>::iterator itr = m_entries.find(page.textures[i].value);
+			if(itr == m_entries.end()) continue;
+
+			Entry &entry = itr->second;
+			if(!entry.packed)
+			{
+				entry.page = -1;
+				m_queue.push_back(page.textures[i]);
+			}
+			else if(m_updateCount - entry.lastUsed > m_evictionAge)
+			{
+				m_entries.erase(itr);
+				evicted = true;
+			}
+			else
+			{
+				textures.push_back(page.textures[i]);
+			}
+		}
+
+		// Repack what is left. Evicting makes room, so the page can be tried again
+		page.textures.swap(textures);
+		page.full = !evicted;
+		page.dirty = evicted;
+		return;
+	}
+
+	// Upload the page and move the textures to their new regions
+	page.texture->updatePixmap(Pixmap(m_pageSize, m_pageSize, &result.pixels[0]));
+	for(uint i = 0; i < result.rectangles.size(); ++i)
+	{
+		unordered_map<Uint32, Entry>::iterator itr = m_entries.find(result.rectangles[i].first.value);
+		if(itr == m_entries.end() || itr->second.page != int(pageIndex)) continue;
+
+		const Rect<uint> &rect = result.rectangles[i].second;
+		Entry &entry = itr->second;
+		entry.packed = true;
+		entry.region.setRegion(
+			float(rect.getX()) / m_pageSize, float(rect.getY()) / m_pageSize,
+			float(rect.getX() + rect.getWidth()) / m_pageSize, float(rect.getY() + rect.getHeight()) / m_pageSize
+			);
+	}
+}
+
+void AutoAtlas::removeFromPage(const TextureHandle texture)
+{
+	const Entry &entry = m_entries[texture.value];
+	if(entry.page < 0) return;
+
+	// The page is repacked without the texture to free its space
+	Page &page = m_pages[entry.page];
+	page.textures.erase(std::remove(page.textures.begin(), page.textures.end(), texture), page.textures.end());
+	page.full = false;
+	page.dirty = true;
+}
+
+END_SAUCE_NAMESPACE
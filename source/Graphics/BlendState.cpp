@@ -42,4 +42,14 @@ BlendState::BlendState(const BlendFactor csrc, const BlendFactor cdst, const Ble
 {
 }
 
+bool BlendState::operator==(const BlendState &other) const
+{
+	return m_src == other.m_src && m_dst == other.m_dst && m_alphaSrc == other.m_alphaSrc && m_alphaDst == other.m_alphaDst;
+}
+
+bool BlendState::operator!=(const BlendState &other) const
+{
+	return !(*this == other);
+}
+
 END_SAUCE_NAMESPACE
@@ -0,0 +1,363 @@
+//     _____                        ______             _            
+//    / ____|                      |  ____|           (_)           
+//   | (___   __ _ _   _  ___ ___  | |__   _ __   __ _ _ _ __   ___ 
+//    \___ \ / _` | | | |/ __/ _ \ |  __| | '_ \ / _` | | '_ \ / _ \
+//    ____) | (_| | |_| | (_|  __/ | |____| | | | (_| | | | | |  __/
+//   |_____/ \__,_|\__,_|\___\___| |______|_| |_|\__, |_|_| |_|\___|
+//                                                __/ |             
+//                                               |___/              
+// Made by Marcus "Bitsauce" Loo Vergara
+// 2011-2018 (C)
+
+#include <Sauce/Common.h>
+#include <Sauce/graphics.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+// Bits of the sort key. The command index is in the lowest bits while sorting
+const uint SORT_KEY_INDEX_BITS = 24;
+const uint SORT_KEY_TEXTURE_SHIFT = 24, SORT_KEY_TEXTURE_MAX = 0xFFF;
+const uint SORT_KEY_SHADER_SHIFT = 36, SORT_KEY_SHADER_MAX = 0xFFF;
+const uint SORT_KEY_BLEND_STATE_SHIFT = 48, SORT_KEY_BLEND_STATE_MAX = 0xFF;
+const uint SORT_KEY_LAYER_SHIFT = 56;
+
+CommandBuffer::CommandBuffer() :
+	m_shader(0),
+	m_texture(0),
+	m_blendState(0),
+	m_transform(0),
+	m_layer(0)
+{
+	reset();
+}
+
+void CommandBuffer::setShader(shared_ptr<Shader> shader)
+{
+	for(uint i = 0; i < m_shaders.size(); ++i)
+	{
+		if(m_shaders[i] == shader)
+		{
+			m_shader = i;
+			return;
+		}
+	}
+	m_shader = m_shaders.size();
+	m_shaders.push_back(shader);
+}
+
+void CommandBuffer::setTexture(shared_ptr<Texture2D> texture)
+{
+	for(uint i = 0; i < m_textures.size(); ++i)
+	{
+		if(m_textures[i] == texture)
+		{
+			m_texture = i;
+			return;
+		}
+	}
+	m_texture = m_textures.size();
+	m_textures.push_back(texture);
+}
+
+void CommandBuffer::setBlendState(const BlendState &blendState)
+{
+	for(uint i = 0; i < m_blendStates.size(); ++i)
+	{
+		if(m_blendStates[i] == blendState)
+		{
+			m_blendState = i;
+			return;
+		}
+	}
+	m_blendState = m_blendStates.size();
+	m_blendStates.push_back(blendState);
+}
+
+void CommandBuffer::setTransformationMatrix(const Matrix4 &matrix)
+{
+	m_transform = m_transforms.size();
+	m_transforms.push_back(matrix);
+}
+
+void CommandBuffer::setLayer(const uchar layer)
+{
+	m_layer = layer;
+}
+
+void CommandBuffer::pushRenderTarget(RenderTarget2D *renderTarget)
+{
+	Command command;
+	command.type = PUSH_RENDER_TARGET;
+	command.renderTarget = renderTarget;
+	m_order.push_back(m_commands.size());
+	m_commands.push_back(command);
+}
+
+void CommandBuffer::popRenderTarget()
+{
+	Command command;
+	command.type = POP_RENDER_TARGET;
+	m_order.push_back(m_commands.size());
+	m_commands.push_back(command);
+}
+
+void CommandBuffer::clear(const uint mask, const Color &fillColor)
+{
+	Command command;
+	command.type = CLEAR;
+	command.clearMask = mask;
+	command.clearColor = fillColor;
+	m_order.push_back(m_commands.size());
+	m_commands.push_back(command);
+}
+
+void CommandBuffer::drawPrimitives(const GraphicsContext::PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount)
+{
+	if(vertexCount == 0) return;
+
+	Command &command = addDraw(DRAW, type);
+	command.format = addFormat(fmt);
+	command.vertexOffset = m_vertexData.size();
+	command.vertexCount = vertexCount;
+
+	const uint size = vertexCount * fmt.getVertexSizeInBytes();
+	m_vertexData.resize(m_vertexData.size() + size);
+	memcpy(&m_vertexData[command.vertexOffset], vertexData, size);
+}
+
+void CommandBuffer::drawIndexedPrimitives(const GraphicsContext::PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount, const uint *indices, const uint indexCount)
+{
+	if(vertexCount == 0 || indexCount == 0) return;
+
+	Command &command = addDraw(DRAW_INDEXED, type);
+	command.format = addFormat(fmt);
+	command.vertexOffset = m_vertexData.size();
+	command.vertexCount = vertexCount;
+	command.indexOffset = m_indices.size();
+	command.indexCount = indexCount;
+
+	const uint size = vertexCount * fmt.getVertexSizeInBytes();
+	m_vertexData.resize(m_vertexData.size() + size);
+	memcpy(&m_vertexData[command.vertexOffset], vertexData, size);
+	m_indices.insert(m_indices.end(), indices, indices + indexCount);
+}
+
+void CommandBuffer::drawPrimitives(const GraphicsContext::PrimitiveType type, const VertexBuffer *vbo)
+{
+	Command &command = addDraw(DRAW_BUFFER, type);
+	command.vertexBuffer = vbo;
+}
+
+void CommandBuffer::drawIndexedPrimitives(const GraphicsContext::PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo, const uint indexStart, const uint indexCount)
+{
+	if(indexCount == 0) return;
+
+	Command &command = addDraw(DRAW_INDEXED_BUFFER, type);
+	command.vertexBuffer = vbo;
+	command.indexBuffer = ibo;
+	command.indexOffset = indexStart;
+	command.indexCount = indexCount;
+}
+
+CommandBuffer::Command &CommandBuffer::addDraw(const CommandType type, const GraphicsContext::PrimitiveType primitiveType)
+{
+	Command command;
+	command.type = type;
+	command.primitiveType = primitiveType;
+	command.layer = m_layer;
+	command.shader = m_shader;
+	command.texture = m_texture;
+	command.blendState = m_blendState;
+	command.transform = m_transform;
+	m_order.push_back(m_commands.size());
+	m_commands.push_back(command);
+	return m_commands.back();
+}
+
+uint CommandBuffer::addFormat(const VertexFormat &fmt)
+{
+	// Draws usually share one or two formats, so the last one is checked first
+	for(int i = m_formats.size() - 1; i >= 0; --i)
+	{
+		if(m_formats[i] == fmt)
+		{
+			return i;
+		}
+	}
+	m_formats.push_back(fmt);
+	return m_formats.size() - 1;
+}
+
+bool CommandBuffer::isDraw(const Command &command)
+{
+	return command.type == DRAW || command.type == DRAW_INDEXED || command.type == DRAW_BUFFER || command.type == DRAW_INDEXED_BUFFER;
+}
+
+Uint64 CommandBuffer::getSortKey(const uint index) const
+{
+	const Command &command = m_commands[index];
+	if(!isDraw(command)) return 0;
+
+	// Blend states change the result the most, then shaders, then textures.
+	// State indices past the max share a key, and keep their submission order
+	return (Uint64(command.layer) << SORT_KEY_LAYER_SHIFT) |
+		(Uint64(min(command.blendState, SORT_KEY_BLEND_STATE_MAX)) << SORT_KEY_BLEND_STATE_SHIFT) |
+		(Uint64(min(command.shader, SORT_KEY_SHADER_MAX)) << SORT_KEY_SHADER_SHIFT) |
+		(Uint64(min(command.texture, SORT_KEY_TEXTURE_MAX)) << SORT_KEY_TEXTURE_SHIFT);
+}
+
+void CommandBuffer::sort()
+{
+	if(m_commands.size() > MAX_SORTED_COMMANDS)
+	{
+		LOG("CommandBuffer::sort(): Too many commands to sort (%i)", (int) m_commands.size());
+		return;
+	}
+
+	// Sort each run of draws between render target pushes, pops and clears
+	vector<Uint64> keys;
+	uint runStart = 0;
+	for(uint i = 0; i <= m_commands.size(); ++i)
+	{
+		if(i < m_commands.size() && isDraw(m_commands[i])) continue;
+
+		if(i - runStart > 1)
+		{
+			keys.resize(i - runStart);
+			for(uint j = runStart; j < i; ++j)
+			{
+				keys[j - runStart] = getSortKey(j) | j;
+			}
+			util::radixSort(&keys[0], keys.size());
+			for(uint j = runStart; j < i; ++j)
+			{
+				m_order[j] = uint(keys[j - runStart] & ((1 << SORT_KEY_INDEX_BITS) - 1));
+			}
+		}
+		runStart = i + 1;
+	}
+}
+
+void CommandBuffer::execute(GraphicsContext *graphicsContext) const
+{
+	// The state applied to the context, as indices into the state tables.
+	// Saved when a render target is pushed, as popping it restores the context's state
+	struct AppliedState
+	{
+		int shader;
+		int texture;
+		int blendState;
+		int transform;
+	};
+	AppliedState applied = { -1, -1, -1, -1 };
+	vector<AppliedState> savedStates;
+
+	graphicsContext->pushState();
+	for(uint i = 0; i < m_order.size(); ++i)
+	{
+		const Command &command = m_commands[m_order[i]];
+		switch(command.type)
+		{
+			case PUSH_RENDER_TARGET:
+				savedStates.push_back(applied);
+				graphicsContext->pushRenderTarget(command.renderTarget);
+				continue;
+
+			case POP_RENDER_TARGET:
+				if(savedStates.empty())
+				{
+					LOG("CommandBuffer::execute(): Render target popped without being pushed");
+					continue;
+				}
+				graphicsContext->popRenderTarget();
+				applied = savedStates.back();
+				savedStates.pop_back();
+				continue;
+
+			case CLEAR:
+				graphicsContext->clear(command.clearMask, command.clearColor);
+				continue;
+
+			default:
+				break;
+		}
+
+		// Apply the state of the draw
+		if(applied.shader != int(command.shader))
+		{
+			graphicsContext->setShader(m_shaders[command.shader]);
+			applied.shader = command.shader;
+		}
+		if(applied.texture != int(command.texture))
+		{
+			graphicsContext->setTexture(m_textures[command.texture]);
+			applied.texture = command.texture;
+		}
+		if(applied.blendState != int(command.blendState))
+		{
+			graphicsContext->setBlendState(m_blendStates[command.blendState]);
+			applied.blendState = command.blendState;
+		}
+		if(applied.transform != int(command.transform))
+		{
+			if(applied.transform >= 0)
+			{
+				graphicsContext->popMatrix();
+			}
+			graphicsContext->pushMatrix(m_transforms[command.transform]);
+			applied.transform = command.transform;
+		}
+
+		switch(command.type)
+		{
+			case DRAW:
+				graphicsContext->drawPrimitives(command.primitiveType, m_formats[command.format], &m_vertexData[command.vertexOffset], command.vertexCount);
+				break;
+
+			case DRAW_INDEXED:
+				graphicsContext->drawIndexedPrimitives(command.primitiveType, m_formats[command.format], &m_vertexData[command.vertexOffset], command.vertexCount, &m_indices[command.indexOffset], command.indexCount);
+				break;
+
+			case DRAW_BUFFER:
+				graphicsContext->drawPrimitives(command.primitiveType, command.vertexBuffer);
+				break;
+
+			case DRAW_INDEXED_BUFFER:
+				graphicsContext->drawIndexedPrimitives(command.primitiveType, command.vertexBuffer, command.indexBuffer, command.indexOffset, command.indexCount);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	// Pop render targets left pushed by the commands
+	if(!savedStates.empty())
+	{
+		LOG("CommandBuffer::execute(): %i render targets were not popped", (int) savedStates.size());
+		for(uint i = 0; i < savedStates.size(); ++i)
+		{
+			graphicsContext->popRenderTarget();
+		}
+	}
+	graphicsContext->popState();
+}
+
+void CommandBuffer::reset()
+{
+	m_commands.clear();
+	m_order.clear();
+	m_vertexData.clear();
+	m_indices.clear();
+	m_formats.clear();
+
+	// Index 0 of each state table is the default state
+	m_shaders.assign(1, shared_ptr<Shader>());
+	m_textures.assign(1, shared_ptr<Texture2D>());
+	m_blendStates.assign(1, BlendState(BlendState::PRESET_ALPHA_BLEND));
+	m_transforms.assign(1, Matrix4());
+	m_shader = m_texture = m_blendState = m_transform = 0;
+	m_layer = 0;
+}
+
+END_SAUCE_NAMESPACE
@@ -258,17 +258,25 @@ int Font::findTextChar(const char *text, int start, int length, int ch)
 
 void Font::drawInternal(SpriteBatch *spriteBatch, float x, float y, const string &text, int count, float spacing)
 {
+	// Glyphs are drawn in runs of the same page
 	int page = -1;
-
-	Sprite sprite(m_pages[0]);
-	sprite.setColor(m_color);
-	sprite.setDepth(m_depth);
+	m_glyphs.clear();
 	for (int n = 0; n < count; )
 	{
 		int charId = getTextChar(text, n, &n);
 		CharDescr *ch = getChar(charId);
 		if (ch == 0) ch = &m_defChar;
 
+		if (ch->page != page)
+		{
+			if (!m_glyphs.empty())
+			{
+				spriteBatch->drawGlyphRun(TextureRegistry::add(m_pages[page]), &m_glyphs[0], m_glyphs.size(), m_color, m_depth);
+				m_glyphs.clear();
+			}
+			page = ch->page;
+		}
+
 		// Map the center of the texel to the corners
 		// in order to get pixel perfect mapping
 		float u = float(ch->srcX) / m_scaleW;
@@ -282,18 +290,19 @@ void Font::drawInternal(SpriteBatch *spriteBatch, float x, float y, const string
 		float ox = m_scale * float(ch->xOff);
 		float oy = m_scale * float(ch->yOff);
 
-		sprite.setRegion(TextureRegion(u, v, u2, v2));
-		sprite.setPosition(x + ox, y + oy);
-		sprite.setSize(w, h);
-
-		if (ch->page != page)
+		// Whitespace has no quad
+		if (ch->srcW > 0 && ch->srcH > 0)
 		{
-			page = ch->page;
-			sprite.setTexture(m_pages[page]);
+			GlyphQuad glyph;
+			glyph.x0 = x + ox;
+			glyph.y0 = y + oy;
+			glyph.x1 = glyph.x0 + w;
+			glyph.y1 = glyph.y0 + h;
+			glyph.u0 = u; glyph.v0 = v;
+			glyph.u1 = u2; glyph.v1 = v2;
+			m_glyphs.push_back(glyph);
 		}
 
-		spriteBatch->drawSprite(sprite);
-
 		x += a;
 		if (charId == ' ')
 			x += spacing;
@@ -301,6 +310,11 @@ void Font::drawInternal(SpriteBatch *spriteBatch, float x, float y, const string
 		if (n < count)
 			x += adjustForKerningPairs(charId, getTextChar(text, n));
 	}
+
+	if (!m_glyphs.empty())
+	{
+		spriteBatch->drawGlyphRun(TextureRegistry::add(m_pages[page]), &m_glyphs[0], m_glyphs.size(), m_color, m_depth);
+	}
 }
 
 void Font::draw(SpriteBatch *spriteBatch, float x, float y, const string &text, FontAlign mode)
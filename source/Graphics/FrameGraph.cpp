@@ -0,0 +1,377 @@
+//     _____                        ______             _            
+//    / ____|                      |  ____|           (_)           
+//   | (___   __ _ _   _  ___ ___  | |__   _ __   __ _ _ _ __   ___ 
+//    \___ \ / _` | | | |/ __/ _ \ |  __| | '_ \ / _` | | '_ \ / _ \
+//    ____) | (_| | |_| | (_|  __/ | |____| | | | (_| | | | | |  __/
+//   |_____/ \__,_|\__,_|\___\___| |______|_| |_|\__, |_|_| |_|\___|
+//                                                __/ |             
+//                                               |___/              
+// Made by Marcus "Bitsauce" Loo Vergara
+// 2011-2018 (C)
+
+#include <Sauce/Common.h>
+#include <Sauce/graphics.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+bool FrameGraph::TargetDesc::operator<(const TargetDesc &other) const
+{
+	if(width != other.width) return width < other.width;
+	if(height != other.height) return height < other.height;
+	if(components != other.components) return components < other.components;
+	return dataType < other.dataType;
+}
+
+uint FrameGraph::TargetDesc::getSizeInBytes() const
+{
+	return width * height * PixelFormat(components, dataType).getPixelSizeInBytes();
+}
+
+FrameGraph::FrameGraph() :
+	m_compiled(false),
+	m_frame(0),
+	m_evictionAge(60)
+{
+}
+
+FrameGraph::~FrameGraph()
+{
+	for(map<TargetDesc, vector<PooledTarget>>::iterator itr = m_pool.begin(); itr != m_pool.end(); ++itr)
+	{
+		for(uint i = 0; i < itr->second.size(); ++i)
+		{
+			delete itr->second[i].renderTarget;
+		}
+	}
+}
+
+uint FrameGraph::createRenderTarget(const string &name, const uint width, const uint height, const PixelFormat &fmt)
+{
+	m_renderTargets.push_back(Target(name, TargetDesc(width, height, fmt)));
+	m_compiled = false;
+	return m_renderTargets.size() - 1;
+}
+
+uint FrameGraph::importRenderTarget(const string &name, RenderTarget2D *renderTarget)
+{
+	m_renderTargets.push_back(Target(name, TargetDesc(renderTarget->getWidth(), renderTarget->getHeight(), PixelFormat())));
+	m_renderTargets.back().imported = renderTarget;
+	m_compiled = false;
+	return m_renderTargets.size() - 1;
+}
+
+uint FrameGraph::addPass(const string &name, PassFunction function)
+{
+	m_passes.push_back(Pass(name, function));
+	m_compiled = false;
+	return m_passes.size() - 1;
+}
+
+void FrameGraph::read(const uint pass, const uint renderTarget)
+{
+	if(pass >= m_passes.size() || renderTarget >= m_renderTargets.size())
+	{
+		LOG("FrameGraph::read(): Invalid pass or render target");
+		return;
+	}
+
+	m_passes[pass].reads.push_back(renderTarget);
+	m_compiled = false;
+}
+
+void FrameGraph::write(const uint pass, const uint renderTarget)
+{
+	if(pass >= m_passes.size() || renderTarget >= m_renderTargets.size())
+	{
+		LOG("FrameGraph::write(): Invalid pass or render target");
+		return;
+	}
+
+	if(m_passes[pass].write >= 0)
+	{
+		LOG("FrameGraph::write(): Pass '%s' already writes a render target", m_passes[pass].name.c_str());
+		return;
+	}
+
+	m_passes[pass].write = renderTarget;
+	m_renderTargets[renderTarget].writers.push_back(pass);
+	m_compiled = false;
+}
+
+void FrameGraph::setOutput(const uint renderTarget)
+{
+	if(renderTarget >= m_renderTargets.size()) return;
+	m_renderTargets[renderTarget].output = true;
+	m_compiled = false;
+}
+
+bool FrameGraph::compile()
+{
+	m_order.clear();
+	m_physicalTargets.clear();
+	m_statistics = Statistics();
+	m_compiled = false;
+
+	if(!orderPasses())
+	{
+		LOG("FrameGraph::compile(): The passes depend on each other in a cycle");
+		m_order.clear();
+		return false;
+	}
+
+	cullPasses();
+	assignPhysicalTargets();
+
+	m_statistics.passCount = m_passes.size();
+	m_statistics.culledPassCount = m_passes.size() - m_order.size();
+	for(map<TargetDesc, vector<PooledTarget>>::const_iterator itr = m_pool.begin(); itr != m_pool.end(); ++itr)
+	{
+		m_statistics.pooledTargetCount += itr->second.size();
+	}
+
+	m_compiled = true;
+	return true;
+}
+
+bool FrameGraph::orderPasses()
+{
+	// Writers of a target run in declaration order, and passes only reading
+	// the target run after the last writer
+	vector<vector<uint>> dependents(m_passes.size());
+	vector<uint> dependencyCount(m_passes.size(), 0);
+	for(uint i = 0; i < m_renderTargets.size(); ++i)
+	{
+		const vector<uint> &writers = m_renderTargets[i].writers;
+		for(uint j = 1; j < writers.size(); ++j)
+		{
+			dependents[writers[j - 1]].push_back(writers[j]);
+			dependencyCount[writers[j]]++;
+		}
+	}
+
+	for(uint i = 0; i < m_passes.size(); ++i)
+	{
+		const Pass &pass = m_passes[i];
+		for(uint j = 0; j < pass.reads.size(); ++j)
+		{
+			const uint target = pass.reads[j];
+			const vector<uint> &writers = m_renderTargets[target].writers;
+			if(writers.empty() || pass.write == int(target)) continue;
+			dependents[writers.back()].push_back(i);
+			dependencyCount[i]++;
+		}
+	}
+
+	// Take the first declared pass with no dependencies left, so independent passes keep their order
+	vector<bool> ordered(m_passes.size(), false);
+	while(m_order.size() < m_passes.size())
+	{
+		int next = -1;
+		for(uint i = 0; i < m_passes.size(); ++i)
+		{
+			if(!ordered[i] && dependencyCount[i] == 0)
+			{
+				next = i;
+				break;
+			}
+		}
+
+		if(next < 0) return false;
+
+		ordered[next] = true;
+		m_order.push_back(next);
+		for(uint i = 0; i < dependents[next].size(); ++i)
+		{
+			dependencyCount[dependents[next][i]]--;
+		}
+	}
+	return true;
+}
+
+void FrameGraph::cullPasses()
+{
+	// Walk the passes backwards, tracking which targets have contents that are used later.
+	// A pass is kept if it writes nothing or writes a target whose contents are used. A kept
+	// pass that writes a target without reading it overwrites it, so what the earlier passes
+	// wrote to the target is not used
+	vector<bool> used(m_renderTargets.size(), false);
+	for(uint i = 0; i < m_renderTargets.size(); ++i)
+	{
+		used[i] = m_renderTargets[i].imported || m_renderTargets[i].output;
+	}
+
+	for(int i = m_order.size() - 1; i >= 0; --i)
+	{
+		Pass &pass = m_passes[m_order[i]];
+		pass.culled = pass.write >= 0 && !used[pass.write];
+		if(pass.culled) continue;
+
+		if(pass.write >= 0)
+		{
+			used[pass.write] = false;
+		}
+
+		for(uint j = 0; j < pass.reads.size(); ++j)
+		{
+			used[pass.reads[j]] = true;
+		}
+	}
+
+	vector<uint> order;
+	for(uint i = 0; i < m_order.size(); ++i)
+	{
+		if(!m_passes[m_order[i]].culled)
+		{
+			order.push_back(m_order[i]);
+		}
+	}
+	m_order.swap(order);
+}
+
+void FrameGraph::assignPhysicalTargets()
+{
+	// Find the lifetimes of the transient targets
+	for(uint i = 0; i < m_renderTargets.size(); ++i)
+	{
+		m_renderTargets[i].physicalTarget = -1;
+		m_renderTargets[i].firstUse = m_renderTargets[i].lastUse = -1;
+	}
+
+	for(uint i = 0; i < m_order.size(); ++i)
+	{
+		const Pass &pass = m_passes[m_order[i]];
+		vector<uint> targets = pass.reads;
+		if(pass.write >= 0) targets.push_back(pass.write);
+		for(uint j = 0; j < targets.size(); ++j)
+		{
+			Target &target = m_renderTargets[targets[j]];
+			if(target.imported) continue;
+			if(target.firstUse < 0) target.firstUse = i;
+			target.lastUse = i;
+		}
+	}
+
+	// Outputs are read after the graph, so they live to the end of it and are never aliased
+	for(uint i = 0; i < m_renderTargets.size(); ++i)
+	{
+		Target &target = m_renderTargets[i];
+		if(target.output && target.firstUse >= 0)
+		{
+			target.lastUse = m_order.size();
+		}
+	}
+
+	// Hand out render targets in pass order. A target is free again after its last
+	// use, so later targets with the same size and format alias it
+	map<TargetDesc, vector<uint>> freeTargets;
+	for(uint i = 0; i < m_order.size(); ++i)
+	{
+		for(uint j = 0; j < m_renderTargets.size(); ++j)
+		{
+			Target &target = m_renderTargets[j];
+			if(target.firstUse != int(i)) continue;
+
+			vector<uint> &free = freeTargets[target.desc];
+			if(free.empty())
+			{
+				target.physicalTarget = m_physicalTargets.size();
+				m_physicalTargets.push_back(PhysicalTarget(target.desc));
+				m_statistics.physicalBytes += target.desc.getSizeInBytes();
+			}
+			else
+			{
+				target.physicalTarget = free.back();
+				free.pop_back();
+			}
+
+			m_statistics.transientTargetCount++;
+			m_statistics.transientBytes += target.desc.getSizeInBytes();
+		}
+
+		for(uint j = 0; j < m_renderTargets.size(); ++j)
+		{
+			const Target &target = m_renderTargets[j];
+			if(target.lastUse == int(i))
+			{
+				freeTargets[target.desc].push_back(target.physicalTarget);
+			}
+		}
+	}
+	m_statistics.physicalTargetCount = m_physicalTargets.size();
+}
+
+void FrameGraph::execute(GraphicsContext *graphicsContext)
+{
+	if(!m_compiled && !compile()) return;
+
+	m_frame++;
+
+	// Get the render targets from the pool
+	map<TargetDesc, uint> poolIndices;
+	for(uint i = 0; i < m_physicalTargets.size(); ++i)
+	{
+		PhysicalTarget &physicalTarget = m_physicalTargets[i];
+		vector<PooledTarget> &pooledTargets = m_pool[physicalTarget.desc];
+		uint &poolIndex = poolIndices[physicalTarget.desc];
+		if(poolIndex == pooledTargets.size())
+		{
+			const TargetDesc &desc = physicalTarget.desc;
+			PooledTarget pooledTarget;
+			pooledTarget.renderTarget = graphicsContext->createRenderTarget(desc.width, desc.height, 1, PixelFormat(desc.components, desc.dataType));
+			pooledTargets.push_back(pooledTarget);
+		}
+
+		pooledTargets[poolIndex].lastUsed = m_frame;
+		physicalTarget.renderTarget = pooledTargets[poolIndex++].renderTarget;
+	}
+
+	for(uint i = 0; i < m_order.size(); ++i)
+	{
+		const Pass &pass = m_passes[m_order[i]];
+		RenderTarget2D *renderTarget = pass.write >= 0 ? getRenderTarget(pass.write) : nullptr;
+		if(renderTarget) graphicsContext->pushRenderTarget(renderTarget);
+		if(pass.function) pass.function(graphicsContext);
+		if(renderTarget) graphicsContext->popRenderTarget();
+	}
+
+	// Delete the pooled targets that have not been used for a while
+	for(map<TargetDesc, vector<PooledTarget>>::iterator itr = m_pool.begin(); itr != m_pool.end();)
+	{
+		vector<PooledTarget> &pooledTargets = itr->second;
+		while(!pooledTargets.empty() && m_frame - pooledTargets.back().lastUsed > m_evictionAge)
+		{
+			delete pooledTargets.back().renderTarget;
+			pooledTargets.pop_back();
+		}
+
+		if(pooledTargets.empty())
+		{
+			itr = m_pool.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+}
+
+void FrameGraph::reset()
+{
+	m_renderTargets.clear();
+	m_passes.clear();
+	m_order.clear();
+	m_physicalTargets.clear();
+	m_compiled = false;
+}
+
+RenderTarget2D *FrameGraph::getRenderTarget(const uint renderTarget) const
+{
+	if(renderTarget >= m_renderTargets.size()) return nullptr;
+
+	const Target &target = m_renderTargets[renderTarget];
+	if(target.imported) return target.imported;
+	if(target.physicalTarget < 0) return nullptr;
+	return m_physicalTargets[target.physicalTarget].renderTarget;
+}
+
+END_SAUCE_NAMESPACE
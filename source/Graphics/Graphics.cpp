@@ -34,6 +34,6 @@ Vector2F QUAD_TEXCOORD[4] = {
 };
 
 // Standard position, color and texCoord vertex format
-VertexFormat VertexFormat::s_vct;
+VertexFormat VertexFormat::s_vct = VertexPCT::getFormat();
 
 END_SAUCE_NAMESPACE
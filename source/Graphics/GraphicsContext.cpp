@@ -1,5 +1,11 @@
 #include <Sauce/Graphics.h>
 
+#if defined(SAUCE_USE_SSE)
+	#include <xmmintrin.h>
+#elif defined(SAUCE_USE_NEON)
+	#include <arm_neon.h>
+#endif
+
 BEGIN_SAUCE_NAMESPACE
 
 // Default shader. Used when no shader is set.
@@ -17,11 +23,92 @@ Vertex *GraphicsContext::getVertices(const uint vertexCount)
 	return &m_vertices[0];
 }
 
-GraphicsContext::GraphicsContext()
+const IndexBuffer *GraphicsContext::getQuadIndexBuffer(const uint quadCount)
+{
+	if(quadCount > m_quadIndexBufferCapacity)
+	{
+		// Grow to the next power of two, so the buffer is rebuilt only a few times
+		uint capacity = max(m_quadIndexBufferCapacity, 1024u);
+		while(capacity < quadCount) capacity *= 2;
+
+		vector<uint> indices(capacity * 6);
+		for(uint i = 0; i < capacity; ++i)
+		{
+			for(int j = 0; j < 6; j++)
+			{
+				indices[i * 6 + j] = i * 4 + QUAD_INDICES[j];
+			}
+		}
+
+		if(!m_quadIndexBuffer)
+		{
+			m_quadIndexBuffer = new StaticIndexBuffer(this);
+		}
+		m_quadIndexBuffer->setData(&indices[0], indices.size());
+		m_quadIndexBufferCapacity = capacity;
+	}
+	return m_quadIndexBuffer;
+}
+
+// Max number of vertices in a batch of shapes
+const uint MAX_BATCH_VERTICES = 1 << 16;
+
+// Max distance in pixels between a curve and its segments when the segment count is picked automatically
+const float AUTO_SEGMENTS_TOLERANCE = 0.25f;
+const uint AUTO_SEGMENTS_MIN = 8;
+const uint AUTO_SEGMENTS_MAX = 256;
+
+// Scales and translates \p count x, y pairs. dst can be src
+static inline void scaleAndTranslate(const float *src, float *dst, const uint count, const float sx, const float sy, const float tx, const float ty)
+{
+	uint i = 0;
+#if defined(SAUCE_USE_SSE)
+	const __m128 scale = _mm_setr_ps(sx, sy, sx, sy);
+	const __m128 offset = _mm_setr_ps(tx, ty, tx, ty);
+	for(; i + 2 <= count; i += 2)
+	{
+		_mm_storeu_ps(dst + i * 2, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i * 2), scale), offset));
+	}
+#elif defined(SAUCE_USE_NEON)
+	const float scaleData[4] = { sx, sy, sx, sy };
+	const float offsetData[4] = { tx, ty, tx, ty };
+	const float32x4_t scale = vld1q_f32(scaleData);
+	const float32x4_t offset = vld1q_f32(offsetData);
+	for(; i + 2 <= count; i += 2)
+	{
+		vst1q_f32(dst + i * 2, vmlaq_f32(offset, vld1q_f32(src + i * 2), scale));
+	}
+#endif
+	for(; i < count; ++i)
+	{
+		dst[i * 2] = src[i * 2] * sx + tx;
+		dst[i * 2 + 1] = src[i * 2 + 1] * sy + ty;
+	}
+}
+
+// Initial sizes of the state and matrix stacks. They grow when pushed past these
+const uint INITIAL_STATE_STACK_SIZE = 16;
+const uint INITIAL_MATRIX_STACK_SIZE = 64;
+
+GraphicsContext::GraphicsContext() :
+	m_stateStack(INITIAL_STATE_STACK_SIZE),
+	m_stateDepth(0),
+	m_matrixStack(INITIAL_MATRIX_STACK_SIZE),
+	m_matrixCount(1),
+	m_textureStack(INITIAL_STATE_STACK_SIZE),
+	m_textureCount(1),
+	m_shaderStack(INITIAL_STATE_STACK_SIZE),
+	m_shaderCount(1),
+	m_projectionStack(INITIAL_STATE_STACK_SIZE),
+	m_projectionCount(1),
+	m_modelViewProjectionDirty(true),
+	m_primitiveBatchingEnabled(true),
+	m_quadIndexBuffer(nullptr),
+	m_quadIndexBufferCapacity(0)
 {
-	State state;
-	m_stateStack.push(state);
-	m_currentState = &m_stateStack.top();
+	m_currentState = &m_stateStack[0];
+	m_matrixStack[0].matrix = Matrix4();
+	m_matrixStack[0].previous = 0;
 }
 
 GraphicsContext::~GraphicsContext()
@@ -30,6 +117,8 @@ GraphicsContext::~GraphicsContext()
 
 void GraphicsContext::pushRenderTarget(RenderTarget2D *renderTarget)
 {
+	flushPrimitives();
+
 	// Unbind previous render target
 	if(m_currentState->renderTarget)
 	{
@@ -50,6 +139,8 @@ void GraphicsContext::pushRenderTarget(RenderTarget2D *renderTarget)
 
 void GraphicsContext::popRenderTarget()
 {
+	flushPrimitives();
+
 	// Unbind previous render target
 	if(m_currentState->renderTarget)
 	{
@@ -77,61 +168,123 @@ void GraphicsContext::popRenderTarget()
 
 void GraphicsContext::pushState()
 {
-	m_stateStack.push(*m_currentState);
-	m_currentState = &m_stateStack.top();
+	if(m_stateDepth + 1 == m_stateStack.size())
+	{
+		const uint size = m_stateStack.size() * 2;
+		m_stateStack.resize(size);
+		m_textureStack.resize(size);
+		m_shaderStack.resize(size);
+		m_projectionStack.resize(size);
+	}
+
+	m_stateStack[m_stateDepth + 1] = m_stateStack[m_stateDepth];
+	m_currentState = &m_stateStack[++m_stateDepth];
+
+	// The matrices are not copied. The new state shares the matrices of the
+	// state below, and pushes its own matrices to the end of the matrix stack.
+	// The texture, shader and projection slots are shared the same way
+	m_currentState->matrixBase = m_matrixCount;
 }
 
 void GraphicsContext::popState()
 {
-	m_stateStack.pop();
-	if(m_stateStack.empty()) THROW("GraphicsContext: State stack should not be empty.");
-	m_currentState = &m_stateStack.top();
+	if(m_stateDepth == 0) THROW("GraphicsContext: State stack should not be empty.");
+
+	// Free the matrices of the state, and the slots it has set. A slot the state
+	// has set is the last one in use, and its texture and shader aren't kept alive
+	const State &below = m_stateStack[m_stateDepth - 1];
+	m_matrixCount = m_currentState->matrixBase;
+	if(m_currentState->texture != below.texture)
+	{
+		m_textureStack[m_currentState->texture].reset();
+		m_textureCount = m_currentState->texture;
+	}
+	if(m_currentState->shader != below.shader)
+	{
+		m_shaderStack[m_currentState->shader].reset();
+		m_shaderCount = m_currentState->shader;
+	}
+	if(m_currentState->projection != below.projection)
+	{
+		m_projectionCount = m_currentState->projection;
+	}
+
+	m_currentState = &m_stateStack[--m_stateDepth];
+	m_modelViewProjectionDirty = true;
 }
 
 void GraphicsContext::pushMatrix(const Matrix4 &mat)
 {
-	m_currentState->transformationMatrixStack.push(m_currentState->transformationMatrixStack.top() * mat);
+	if(m_matrixCount == m_matrixStack.size())
+	{
+		m_matrixStack.resize(m_matrixStack.size() * 2);
+	}
+
+	MatrixStackEntry &entry = m_matrixStack[m_matrixCount];
+	entry.matrix = m_matrixStack[m_currentState->matrixTop].matrix * mat;
+	entry.previous = m_currentState->matrixTop;
+	m_currentState->matrixTop = m_matrixCount++;
+	m_modelViewProjectionDirty = true;
 }
 
 bool GraphicsContext::popMatrix()
 {
-	if(m_currentState->transformationMatrixStack.size() > 1)
+	const uint top = m_currentState->matrixTop;
+	if(top == 0)
 	{
-		m_currentState->transformationMatrixStack.pop();
-		return true;
+		return false;
 	}
-	return false;
+
+	// Slots owned by the state are always at the end of the matrix stack. Slots of the
+	// states below are left as they are, so they are intact when this state is popped
+	m_currentState->matrixTop = m_matrixStack[top].previous;
+	if(top >= m_currentState->matrixBase)
+	{
+		m_matrixCount = top;
+	}
+	m_modelViewProjectionDirty = true;
+	return true;
 }
 
 Matrix4 GraphicsContext::topMatrix() const
 {
-	if(m_currentState->transformationMatrixStack.empty()) return Matrix4();
-	return m_currentState->transformationMatrixStack.top();
+	return m_matrixStack[m_currentState->matrixTop].matrix;
 }
 
 void GraphicsContext::clearMatrixStack()
 {
-	while(popMatrix());
+	m_currentState->matrixTop = 0;
+	m_matrixCount = m_currentState->matrixBase;
+	m_modelViewProjectionDirty = true;
 }
 
-void GraphicsContext::setTexture(shared_ptr<Texture2D> texture)
+const Matrix4 &GraphicsContext::getModelViewProjectionMatrix()
 {
-	m_currentState->texture = texture;
+	if(m_modelViewProjectionDirty)
+	{
+		m_modelViewProjection = m_projectionStack[m_currentState->projection] * m_matrixStack[m_currentState->matrixTop].matrix;
+		m_modelViewProjectionDirty = false;
+	}
+	return m_modelViewProjection;
 }
 
-shared_ptr<Texture2D> GraphicsContext::getTexture() const
+void GraphicsContext::setTexture(shared_ptr<Texture2D> texture)
 {
-	return m_currentState->texture;
+	// Take a slot of our own if the slot is shared with the state below
+	if(m_stateDepth > 0 && m_currentState->texture == m_stateStack[m_stateDepth - 1].texture)
+	{
+		m_currentState->texture = m_textureCount++;
+	}
+	m_textureStack[m_currentState->texture] = texture;
 }
 
 void GraphicsContext::setShader(shared_ptr<Shader> shader)
 {
-	m_currentState->shader = shader;
-}
-
-shared_ptr<Shader> GraphicsContext::getShader() const
-{
-	return m_currentState->shader;
+	if(m_stateDepth > 0 && m_currentState->shader == m_stateStack[m_stateDepth - 1].shader)
+	{
+		m_currentState->shader = m_shaderCount++;
+	}
+	m_shaderStack[m_currentState->shader] = shader;
 }
 
 void GraphicsContext::setBlendState(const BlendState &blendState)
@@ -157,33 +310,23 @@ void GraphicsContext::setSize(const uint w, const uint h)
 
 void GraphicsContext::setProjectionMatrix(const Matrix4 matrix)
 {
-	m_currentState->projectionMatrix = matrix;
+	if(m_stateDepth > 0 && m_currentState->projection == m_stateStack[m_stateDepth - 1].projection)
+	{
+		m_currentState->projection = m_projectionCount++;
+	}
+	m_projectionStack[m_currentState->projection] = matrix;
+	m_modelViewProjectionDirty = true;
 }
 
 void GraphicsContext::drawRectangle(const float x, const float y, const float width, const float height, const Color &color, const TextureRegion &textureRegion)
 {
-	// Make sure we have enough vertices
-	if(m_vertices.size() < 4)
-	{
-		m_vertices.resize(4);
-	}
-
-	m_vertices[0].set2f(VERTEX_POSITION, x, y);
-	m_vertices[1].set2f(VERTEX_POSITION, x, y + height);
-	m_vertices[2].set2f(VERTEX_POSITION, x + width, y);
-	m_vertices[3].set2f(VERTEX_POSITION, x + width, y + height);
+	VertexPCT vertices[4];
+	vertices[0].set(x, y, color, textureRegion.uv0.x, textureRegion.uv0.y);
+	vertices[1].set(x, y + height, color, textureRegion.uv0.x, textureRegion.uv1.y);
+	vertices[2].set(x + width, y, color, textureRegion.uv1.x, textureRegion.uv0.y);
+	vertices[3].set(x + width, y + height, color, textureRegion.uv1.x, textureRegion.uv1.y);
 
-	m_vertices[0].set4ub(VERTEX_COLOR, color.getR(), color.getG(), color.getB(), color.getA());
-	m_vertices[1].set4ub(VERTEX_COLOR, color.getR(), color.getG(), color.getB(), color.getA());
-	m_vertices[2].set4ub(VERTEX_COLOR, color.getR(), color.getG(), color.getB(), color.getA());
-	m_vertices[3].set4ub(VERTEX_COLOR, color.getR(), color.getG(), color.getB(), color.getA());
-
-	m_vertices[0].set2f(VERTEX_TEX_COORD, textureRegion.uv0.x, textureRegion.uv0.y);
-	m_vertices[1].set2f(VERTEX_TEX_COORD, textureRegion.uv0.x, textureRegion.uv1.y);
-	m_vertices[2].set2f(VERTEX_TEX_COORD, textureRegion.uv1.x, textureRegion.uv0.y);
-	m_vertices[3].set2f(VERTEX_TEX_COORD, textureRegion.uv1.x, textureRegion.uv1.y);
-
-	drawPrimitives(PRIMITIVE_TRIANGLE_STRIP, &m_vertices[0], 4);
+	batchPrimitives(PRIMITIVE_TRIANGLE_STRIP, vertices, 4);
 }
 
 void GraphicsContext::drawRectangle(const Vector2F &pos, const Vector2F &size, const Color &color, const TextureRegion &textureRegion)
@@ -198,31 +341,20 @@ void GraphicsContext::drawRectangle(const Rect<float> &rect, const Color &color,
 
 void GraphicsContext::drawRectangleOutline(const float x, const float y, const float width, const float height, const Color &color, const TextureRegion &textureRegion)
 {
-	// Make sure we have enough vertices
-	if(m_vertices.size() < 8)
-	{
-		m_vertices.resize(8);
-	}
+	VertexPCT vertices[8];
+	vertices[0].set(x, y, color);
+	vertices[1].set(x, y + height, color);
 
-	m_vertices[0].set2f(VERTEX_POSITION, x, y);
-	m_vertices[1].set2f(VERTEX_POSITION, x, y + height);
+	vertices[2].set(x, y + height, color);
+	vertices[3].set(x + width, y + height, color);
 
-	m_vertices[2].set2f(VERTEX_POSITION, x, y + height);
-	m_vertices[3].set2f(VERTEX_POSITION, x + width, y + height);
-	
-	m_vertices[4].set2f(VERTEX_POSITION, x + width, y + height);
-	m_vertices[5].set2f(VERTEX_POSITION, x + width, y);
+	vertices[4].set(x + width, y + height, color);
+	vertices[5].set(x + width, y, color);
 
-	m_vertices[6].set2f(VERTEX_POSITION, x + width, y);
-	m_vertices[7].set2f(VERTEX_POSITION, x, y);
+	vertices[6].set(x + width, y, color);
+	vertices[7].set(x, y, color);
 
-	for(int i = 0; i < 8; i++)
-	{
-		m_vertices[i].set4ub(VERTEX_COLOR, color.getR(), color.getG(), color.getB(), color.getA());
-		m_vertices[i].set2f(VERTEX_TEX_COORD, 0.0f, 0.0f);
-	}
-
-	drawPrimitives(PRIMITIVE_LINES, &m_vertices[0], 8);
+	batchPrimitives(PRIMITIVE_LINES, vertices, 8);
 }
 
 void GraphicsContext::drawRectangleOutline(const Vector2F &pos, const Vector2F &size, const Color &color, const TextureRegion &textureRegion)
@@ -235,27 +367,74 @@ void GraphicsContext::drawRectangleOutline(const Rect<float> &rect, const Color
 	drawRectangleOutline(rect.position.x, rect.position.y, rect.size.x, rect.size.y, color, textureRegion);
 }
 
-void GraphicsContext::drawCircleGradient(const float x, const float y, const float radius, const uint segments, const Color &center, const Color &outer)
+const float *GraphicsContext::getUnitCircle(const uint segments)
+{
+	// Only the counts AUTO_SEGMENTS can pick are cached, so the number of tables is bounded.
+	// Tables of other counts are computed into a scratch table every time they are needed
+	const bool cached = segments >= AUTO_SEGMENTS_MIN && segments <= AUTO_SEGMENTS_MAX && segments % 4 == 0;
+	vector<float> &points = cached ? m_unitCircles[segments] : m_unitCircleScratch;
+	if(!cached || points.empty())
+	{
+		points.resize((segments + 1) * 2);
+		for(uint i = 0; i < segments; ++i)
+		{
+			const float r = (2.0f * PI * i) / segments;
+			points[i * 2] = cos(r);
+			points[i * 2 + 1] = sin(r);
+		}
+		points[segments * 2] = points[0];
+		points[segments * 2 + 1] = points[1];
+	}
+	return &points[0];
+}
+
+uint GraphicsContext::getSegmentCount(const float radius, const uint segments)
 {
+	if(segments != AUTO_SEGMENTS) return max(segments, 3u);
+
+	// Get the radius in pixels from the scale of the model-view-projection matrix
+	const Matrix4 &mvp = getModelViewProjectionMatrix();
+	const float halfWidth = m_currentState->width * 0.5f, halfHeight = m_currentState->height * 0.5f;
+	const float scaleX = sqrt(mvp[0] * mvp[0] * halfWidth * halfWidth + mvp[4] * mvp[4] * halfHeight * halfHeight);
+	const float scaleY = sqrt(mvp[1] * mvp[1] * halfWidth * halfWidth + mvp[5] * mvp[5] * halfHeight * halfHeight);
+	const float pixelRadius = fabs(radius) * max(scaleX, scaleY);
+	if(pixelRadius <= AUTO_SEGMENTS_TOLERANCE) return AUTO_SEGMENTS_MIN;
+
+	// A segment spanning 2 * acos(1 - tolerance / radius) radians stays within the tolerance.
+	// The count is rounded up to a multiple of 4, so that it has a cached table
+	const uint count = (uint) ceil(PI / acos(1.0f - AUTO_SEGMENTS_TOLERANCE / pixelRadius));
+	return min(max((count + 3) & ~3u, AUTO_SEGMENTS_MIN), AUTO_SEGMENTS_MAX);
+}
+
+void GraphicsContext::drawCircleGradient(const float x, const float y, const float radius, const uint segmentCount, const Color &center, const Color &outer)
+{
+	const uint segments = getSegmentCount(radius, segmentCount);
+	const float *circle = getUnitCircle(segments);
+
 	// Make sure we have enough vertices
-	if(m_vertices.size() < segments + 2)
+	if(m_shapeVertices.size() < segments + 2)
 	{
-		m_vertices.resize(segments + 2);
+		m_shapeVertices.resize(segments + 2);
 	}
 
-	m_vertices[0].set2f(VERTEX_POSITION, x, y);
-	m_vertices[0].set4ub(VERTEX_COLOR, center.getR(), center.getG(), center.getB(), center.getA());
-	m_vertices[0].set2f(VERTEX_TEX_COORD, 0.5f, 0.5f);
+	if(m_shapePositions.size() < (segments + 1) * 4)
+	{
+		m_shapePositions.resize((segments + 1) * 4);
+	}
+
+	// Positions and texture coordinates are the unit circle scaled and translated
+	float *positions = &m_shapePositions[0];
+	float *texCoords = &m_shapePositions[(segments + 1) * 2];
+	scaleAndTranslate(circle, positions, segments + 1, radius, radius, x, y);
+	scaleAndTranslate(circle, texCoords, segments + 1, 0.5f, 0.5f, 0.5f, 0.5f);
 
-	for(uint i = 1; i < segments + 2; ++i)
+	m_shapeVertices[0].set(x, y, center, 0.5f, 0.5f);
+	for(uint i = 0; i < segments + 1; ++i)
 	{
-		float r = (2.0f * PI * i) / segments;
-		m_vertices[i].set2f(VERTEX_POSITION, x + cos(r) * radius, y + sin(r) * radius);
-		m_vertices[i].set4ub(VERTEX_COLOR, outer.getR(), outer.getG(), outer.getB(), outer.getA());
-		m_vertices[i].set2f(VERTEX_TEX_COORD, (1.0f + cos(r)) / 2.0f, (1.0f + sin(r)) / 2.0f);
+		m_shapeVertices[i + 1].set(positions[i * 2], positions[i * 2 + 1], outer, texCoords[i * 2], texCoords[i * 2 + 1]);
 	}
 
-	drawPrimitives(PRIMITIVE_TRIANGLE_FAN, &m_vertices[0], segments + 2);
+	batchPrimitives(PRIMITIVE_TRIANGLE_FAN, &m_shapeVertices[0], segments + 2);
 }
 
 void GraphicsContext::drawCircleGradient(const Vector2F &pos, const float radius, const uint segments, const Color &center, const Color &outer)
@@ -273,13 +452,116 @@ void GraphicsContext::drawCircle(const Vector2F &pos, const float radius, const
 	drawCircleGradient(pos.x, pos.y, radius, segments, color, color);
 }
 
-void GraphicsContext::drawArrow(const float x0, const float y0, const float x1, const float y1, const Color &color)
+void GraphicsContext::drawRoundedRectangle(const float x, const float y, const float width, const float height, const float radius, const uint segmentCount, const Color &color)
 {
-	// Make sure we have enough vertices
-	if(m_vertices.size() < 6) m_vertices.resize(6);
+	const float r = min(radius, min(width, height) * 0.5f);
+	if(r <= 0.0f)
+	{
+		drawRectangle(x, y, width, height, color);
+		return;
+	}
+
+	// Each corner is a quarter of the unit circle, so the segment count has to be a multiple of 4
+	const uint segments = (getSegmentCount(r, segmentCount) + 3) & ~3u;
+	const uint cornerPointCount = segments / 4 + 1;
+	const float *circle = getUnitCircle(segments);
+
+	// Center, the corners and the first corner point again to close the fan
+	const uint vertexCount = cornerPointCount * 4 + 2;
+	if(m_shapeVertices.size() < vertexCount)
+	{
+		m_shapeVertices.resize(vertexCount);
+	}
+
+	if(m_shapePositions.size() < cornerPointCount * 8)
+	{
+		m_shapePositions.resize(cornerPointCount * 8);
+	}
+
+	// Going clockwise from the bottom-right corner, which is the quarter from 0 to 90 degrees
+	const float corners[8] = {
+		x + width - r, y + height - r,
+		x + r, y + height - r,
+		x + r, y + r,
+		x + width - r, y + r
+	};
+
+	float *positions = &m_shapePositions[0];
+	for(uint i = 0; i < 4; ++i)
+	{
+		scaleAndTranslate(circle + i * (cornerPointCount - 1) * 2, positions + i * cornerPointCount * 2, cornerPointCount, r, r, corners[i * 2], corners[i * 2 + 1]);
+	}
+
+	m_shapeVertices[0].set(x + width * 0.5f, y + height * 0.5f, color, 0.5f, 0.5f);
+	for(uint i = 0; i < cornerPointCount * 4; ++i)
+	{
+		const float px = positions[i * 2], py = positions[i * 2 + 1];
+		m_shapeVertices[i + 1].set(px, py, color, (px - x) / width, (py - y) / height);
+	}
+	m_shapeVertices[vertexCount - 1] = m_shapeVertices[1];
+
+	batchPrimitives(PRIMITIVE_TRIANGLE_FAN, &m_shapeVertices[0], vertexCount);
+}
+
+void GraphicsContext::drawRoundedRectangle(const Rect<float> &rect, const float radius, const uint segments, const Color &color)
+{
+	drawRoundedRectangle(rect.position.x, rect.position.y, rect.size.x, rect.size.y, radius, segments, color);
+}
+
+void GraphicsContext::drawArc(const float x, const float y, const float radius, const float startAngle, const float endAngle, const uint segmentCount, const Color &color)
+{
+	const uint segments = getSegmentCount(radius, segmentCount);
+	const float *circle = getUnitCircle(segments);
+
+	const float start = min(startAngle, endAngle);
+	const float end = min(max(startAngle, endAngle), start + 2.0f * PI);
+
+	// The arc goes through the points of the unit circle between the angles,
+	// and only the two end points are computed
+	const float step = (2.0f * PI) / segments;
+	const int first = (int) ceil(start / step), last = (int) floor(end / step);
+	const uint pointCount = max(last - first + 1, 0) + 2;
+	if(m_shapeVertices.size() < pointCount)
+	{
+		m_shapeVertices.resize(pointCount);
+	}
+
+	if(m_shapePositions.size() < pointCount * 2)
+	{
+		m_shapePositions.resize(pointCount * 2);
+	}
+
+	float *points = &m_shapePositions[0];
+	points[0] = cos(start);
+	points[1] = sin(start);
+	for(int i = first; i <= last; ++i)
+	{
+		const uint index = ((i % int(segments)) + int(segments)) % int(segments);
+		points[(i - first + 1) * 2] = circle[index * 2];
+		points[(i - first + 1) * 2 + 1] = circle[index * 2 + 1];
+	}
+	points[(pointCount - 1) * 2] = cos(end);
+	points[(pointCount - 1) * 2 + 1] = sin(end);
+	scaleAndTranslate(points, points, pointCount, radius, radius, x, y);
+
+	for(uint i = 0; i < pointCount; ++i)
+	{
+		m_shapeVertices[i].set(points[i * 2], points[i * 2 + 1], color);
+	}
+
+	batchPrimitives(PRIMITIVE_LINE_STRIP, &m_shapeVertices[0], pointCount);
+}
+
+void GraphicsContext::drawArc(const Vector2F &pos, const float radius, const float startAngle, const float endAngle, const uint segments, const Color &color)
+{
+	drawArc(pos.x, pos.y, radius, startAngle, endAngle, segments, color);
+}
 
-	m_vertices[0].set2f(VERTEX_POSITION, x0, y0); m_vertices[0].set4ub(VERTEX_COLOR, color.x, color.y, color.z, color.w); m_vertices[0].set2f(VERTEX_TEX_COORD, 0.f, 0.f);
-	m_vertices[1].set2f(VERTEX_POSITION, x1, y1); m_vertices[1].set4ub(VERTEX_COLOR, color.x, color.y, color.z, color.w); m_vertices[1].set2f(VERTEX_TEX_COORD, 0.f, 0.f);
+void GraphicsContext::drawArrow(const float x0, const float y0, const float x1, const float y1, const Color &color)
+{
+	VertexPCT vertices[6];
+	vertices[0].set(x0, y0, color);
+	vertices[1].set(x1, y1, color);
 
 	Vector2F p0 = (Vector2F(x0, y0) - Vector2F(x1, y1)).normalized() * 10;
 	Vector2F p1 = p0;
@@ -290,13 +572,179 @@ void GraphicsContext::drawArrow(const float x0, const float y0, const float x1,
 	p0 += Vector2F(x1, y1);
 	p1 += Vector2F(x1, y1);
 
-	m_vertices[2].set2f(VERTEX_POSITION, x1, y1); m_vertices[2].set4ub(VERTEX_COLOR, color.x, color.y, color.z, color.w); m_vertices[2].set2f(VERTEX_TEX_COORD, 0.f, 0.f);
-	m_vertices[3].set2f(VERTEX_POSITION, p0.x, p0.y); m_vertices[3].set4ub(VERTEX_COLOR, color.x, color.y, color.z, color.w); m_vertices[3].set2f(VERTEX_TEX_COORD, 0.f, 0.f);
+	vertices[2].set(x1, y1, color);
+	vertices[3].set(p0.x, p0.y, color);
+
+	vertices[4].set(x1, y1, color);
+	vertices[5].set(p1.x, p1.y, color);
+
+	batchPrimitives(PRIMITIVE_LINES, vertices, 6);
+}
+
+void GraphicsContext::batchPrimitives(const PrimitiveType type, const VertexPCT *vertices, const uint vertexCount)
+{
+	if(vertexCount == 0) return;
+
+	if(!m_primitiveBatchingEnabled)
+	{
+		drawPrimitives(type, VertexPCT::getFormat(), vertices, vertexCount);
+		return;
+	}
+
+	// Lines and triangles go in separate batches
+	const PrimitiveType batchType = type == PRIMITIVE_LINES || type == PRIMITIVE_LINE_STRIP || type == PRIMITIVE_LINE_LOOP ? PRIMITIVE_LINES : PRIMITIVE_TRIANGLES;
+
+	// Draw the batch if the state has changed since it was started
+	PrimitiveBatch &batch = m_primitiveBatch;
+	if(!batch.indices.empty() &&
+	   (batch.type != batchType ||
+		batch.texture != getTexture() ||
+		batch.shader != getShader() ||
+		batch.blendState != m_currentState->blendState ||
+		batch.renderTarget != m_currentState->renderTarget ||
+		batch.transformationMatrix != m_matrixStack[m_currentState->matrixTop].matrix ||
+		batch.projectionMatrix != getProjectionMatrix() ||
+		batch.vertices.size() + vertexCount > MAX_BATCH_VERTICES))
+	{
+		flushPrimitives();
+	}
 
-	m_vertices[4].set2f(VERTEX_POSITION, x1, y1); m_vertices[4].set4ub(VERTEX_COLOR, color.x, color.y, color.z, color.w); m_vertices[4].set2f(VERTEX_TEX_COORD, 0.f, 0.f);
-	m_vertices[5].set2f(VERTEX_POSITION, p1.x, p1.y); m_vertices[5].set4ub(VERTEX_COLOR, color.x, color.y, color.z, color.w); m_vertices[5].set2f(VERTEX_TEX_COORD, 0.f, 0.f);
+	if(batch.indices.empty())
+	{
+		batch.type = batchType;
+		batch.texture = getTexture();
+		batch.shader = getShader();
+		batch.blendState = m_currentState->blendState;
+		batch.renderTarget = m_currentState->renderTarget;
+		batch.transformationMatrix = m_matrixStack[m_currentState->matrixTop].matrix;
+		batch.projectionMatrix = getProjectionMatrix();
+
+		// Changing the texture or a uniform of the shader draws the batch first
+		if(batch.texture) batch.texture->m_batchingContext = this;
+		if(batch.shader) batch.shader->m_batchingContext = this;
+	}
+
+	const uint first = batch.vertices.size();
+	batch.vertices.insert(batch.vertices.end(), vertices, vertices + vertexCount);
+
+	// Add the indices of the primitives as a triangle or line list
+	switch(type)
+	{
+		case PRIMITIVE_TRIANGLE_STRIP:
+		{
+			// Every other triangle of a strip is flipped to keep the winding
+			for(uint i = 0; i + 2 < vertexCount; ++i)
+			{
+				batch.indices.push_back(first + (i % 2 == 0 ? i : i + 1));
+				batch.indices.push_back(first + (i % 2 == 0 ? i + 1 : i));
+				batch.indices.push_back(first + i + 2);
+			}
+		}
+		break;
+
+		case PRIMITIVE_TRIANGLE_FAN:
+		{
+			for(uint i = 1; i + 1 < vertexCount; ++i)
+			{
+				batch.indices.push_back(first);
+				batch.indices.push_back(first + i);
+				batch.indices.push_back(first + i + 1);
+			}
+		}
+		break;
+
+		case PRIMITIVE_LINE_STRIP:
+		case PRIMITIVE_LINE_LOOP:
+		{
+			for(uint i = 0; i + 1 < vertexCount; ++i)
+			{
+				batch.indices.push_back(first + i);
+				batch.indices.push_back(first + i + 1);
+			}
+
+			if(type == PRIMITIVE_LINE_LOOP && vertexCount > 2)
+			{
+				batch.indices.push_back(first + vertexCount - 1);
+				batch.indices.push_back(first);
+			}
+		}
+		break;
+
+		default:
+		{
+			for(uint i = 0; i < vertexCount; ++i)
+			{
+				batch.indices.push_back(first + i);
+			}
+		}
+		break;
+	}
+}
+
+void GraphicsContext::flushPrimitives()
+{
+	if(m_primitiveBatch.indices.empty()) return;
+
+	// Move the batch out before drawing, as the backends flush before every draw
+	PrimitiveBatch &batch = m_primitiveBatch;
+	m_flushVertices.swap(batch.vertices);
+	m_flushIndices.swap(batch.indices);
+	batch.vertices.clear();
+	batch.indices.clear();
+
+	// Draw with the state the shapes were drawn with, by swapping it into the current
+	// slots and back. The render target can't differ, as pushing and popping render
+	// targets flushes the batch
+	State &state = *m_currentState;
+	shared_ptr<Texture2D> &texture = m_textureStack[state.texture];
+	shared_ptr<Shader> &shader = m_shaderStack[state.shader];
+	Matrix4 &topMatrix = m_matrixStack[state.matrixTop].matrix;
+	Matrix4 &projectionMatrix = m_projectionStack[state.projection];
+	texture.swap(batch.texture);
+	shader.swap(batch.shader);
+	swap(state.blendState, batch.blendState);
+	swap(topMatrix, batch.transformationMatrix);
+	swap(projectionMatrix, batch.projectionMatrix);
+	m_modelViewProjectionDirty = true;
+
+	drawIndexedPrimitives(batch.type, VertexPCT::getFormat(), &m_flushVertices[0], m_flushVertices.size(), &m_flushIndices[0], m_flushIndices.size());
+
+	texture.swap(batch.texture);
+	shader.swap(batch.shader);
+	swap(state.blendState, batch.blendState);
+	swap(topMatrix, batch.transformationMatrix);
+	swap(projectionMatrix, batch.projectionMatrix);
+	m_modelViewProjectionDirty = true;
+
+	// Don't keep the texture and shader alive
+	if(batch.texture) batch.texture->m_batchingContext = nullptr;
+	if(batch.shader) batch.shader->m_batchingContext = nullptr;
+	batch.texture.reset();
+	batch.shader.reset();
+}
+
+void GraphicsContext::setPrimitiveBatchingEnabled(const bool enabled)
+{
+	flushPrimitives();
+	m_primitiveBatchingEnabled = enabled;
+}
+
+void GraphicsContext::drawIndexedPrimitives(const PrimitiveType type, const Vertex *vertices, const uint vertexCount, const uint *indices, const uint indexCount)
+{
+	// If there are no vertices to draw, do nothing
+	if(vertexCount == 0 || indexCount == 0) return;
+
+	Vertex::pack(vertices, vertexCount, m_packedVertices);
+	drawIndexedPrimitives(type, vertices->getFormat(), &m_packedVertices[0], vertexCount, indices, indexCount);
+}
+
+void GraphicsContext::drawPrimitives(const PrimitiveType type, const Vertex *vertices, const uint vertexCount)
+{
+	// If there are no vertices to draw, do nothing
+	if(vertexCount == 0) return;
 
-	drawPrimitives(PRIMITIVE_LINES, &m_vertices[0], 6);
+	Vertex::pack(vertices, vertexCount, m_packedVertices);
+	drawPrimitives(type, vertices->getFormat(), &m_packedVertices[0], vertexCount);
 }
 
 Texture2D *GraphicsContext::createTexture(const uint width, const uint height, const void *data, const PixelFormat & format)
@@ -0,0 +1,379 @@
+//     _____                        ______             _            
+//    / ____|                      |  ____|           (_)           
+//   | (___   __ _ _   _  ___ ___  | |__   _ __   __ _ _ _ __   ___ 
+//    \___ \ / _` | | | |/ __/ _ \ |  __| | '_ \ / _` | | '_ \ / _ \
+//    ____) | (_| | |_| | (_|  __/ | |____| | | | (_| | | | | |  __/
+//   |_____/ \__,_|\__,_|\___\___| |______|_| |_|\__, |_|_| |_|\___|
+//                                                __/ |             
+//                                               |___/              
+// Made by Marcus "Bitsauce" Loo Vergara
+// 2011-2018 (C)
+
+#include <Sauce/Common.h>
+#include <Sauce/graphics.h>
+#include <Sauce/Graphics/Headless/HeadlessContext.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+HeadlessTexture2D::HeadlessTexture2D(HeadlessContext *graphicsContext, const Pixmap &pixmap) :
+	m_graphicsContext(graphicsContext)
+{
+	m_filter = NEAREST;
+	m_wrapping = CLAMP_TO_BORDER;
+	m_mipmaps = false;
+	m_pixelFormat = pixmap.getFormat();
+	updatePixmap(pixmap);
+}
+
+Pixmap HeadlessTexture2D::getPixmap() const
+{
+	return Pixmap(m_width, m_height, m_data.empty() ? nullptr : &m_data[0], m_pixelFormat);
+}
+
+void HeadlessTexture2D::updatePixmap(const Pixmap &pixmap)
+{
+	flushPrimitives();
+	m_version++;
+
+	m_width = pixmap.getWidth();
+	m_height = pixmap.getHeight();
+	m_pixelFormat = pixmap.getFormat();
+
+	const uint size = m_width * m_height * m_pixelFormat.getPixelSizeInBytes();
+	m_data.assign(pixmap.getData(), pixmap.getData() + size);
+	m_mipmapsGenerated = false;
+
+	m_graphicsContext->record(HeadlessContext::Call::UPLOAD_TEXTURE, size);
+}
+
+void HeadlessTexture2D::updatePixmap(const uint x, const uint y, const Pixmap &pixmap)
+{
+	if(x >= m_width || y >= m_height)
+	{
+		LOG("HeadlessTexture2D::updatePixmap(): Position out of texture bounds.");
+		return;
+	}
+
+	flushPrimitives();
+	m_version++;
+
+	// Copy the rows of the pixmap that are inside the texture
+	const uint pixelSize = m_pixelFormat.getPixelSizeInBytes();
+	const uint width = min(pixmap.getWidth(), m_width - x);
+	const uint height = min(pixmap.getHeight(), m_height - y);
+	for(uint row = 0; row < height; ++row)
+	{
+		memcpy(&m_data[((y + row) * m_width + x) * pixelSize], pixmap.getData() + row * pixmap.getWidth() * pixelSize, width * pixelSize);
+	}
+	m_mipmapsGenerated = false;
+
+	m_graphicsContext->record(HeadlessContext::Call::UPLOAD_TEXTURE, width * height * pixelSize);
+}
+
+void HeadlessTexture2D::clear()
+{
+	flushPrimitives();
+	m_version++;
+	fill(m_data.begin(), m_data.end(), 0);
+}
+
+void HeadlessTexture2D::updateFiltering()
+{
+}
+
+HeadlessRenderTarget2D::HeadlessRenderTarget2D(HeadlessContext *graphicsContext, const uint width, const uint height, const uint targetCount, const PixelFormat &fmt) :
+	RenderTarget2D(graphicsContext, width, height, targetCount, fmt),
+	m_graphicsContext(graphicsContext)
+{
+}
+
+void HeadlessRenderTarget2D::bind()
+{
+	m_graphicsContext->record(HeadlessContext::Call::BIND_RENDER_TARGET, 0, this);
+}
+
+void HeadlessRenderTarget2D::unbind()
+{
+	m_graphicsContext->record(HeadlessContext::Call::UNBIND_RENDER_TARGET, 0, this);
+}
+
+HeadlessContext *HeadlessContext::s_current = nullptr;
+
+HeadlessContext::Call::Call(const Type type) :
+	type(type),
+	primitiveType(PRIMITIVE_TRIANGLES),
+	vertexCount(0),
+	indexCount(0),
+	instanceCount(0),
+	texture(nullptr),
+	shader(nullptr),
+	blendState(BlendState::PRESET_ALPHA_BLEND),
+	renderTarget(nullptr),
+	uploadedBytes(0),
+	clearMask(0)
+{
+}
+
+HeadlessContext::HeadlessContext(const Mode mode) :
+	m_mode(mode),
+	m_capabilities(0),
+	m_bufferCount(0),
+	m_previousDraw(Call::DRAW_PRIMITIVES),
+	m_hasPreviousDraw(false),
+	m_drawCount(0),
+	m_uploadedBytes(0),
+	m_stateChangeCount(0)
+{
+	if(s_current)
+	{
+		THROW("HeadlessContext(): Only one headless context can exist at a time.");
+	}
+	s_current = this;
+
+	// Create the defaults used when no shader or texture is set
+	if(!s_defaultShader)
+	{
+		s_defaultShader = shared_ptr<Shader>(new HeadlessShader());
+	}
+
+	if(!s_defaultTexture)
+	{
+		uchar pixel[] = { 255, 255, 255, 255 };
+		s_defaultTexture = shared_ptr<Texture2D>(new HeadlessTexture2D(this, Pixmap(1, 1, pixel)));
+	}
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	delete m_quadIndexBuffer;
+	m_quadIndexBuffer = nullptr;
+
+	if(dynamic_cast<HeadlessShader*>(s_defaultShader.get()))
+	{
+		s_defaultShader.reset();
+	}
+
+	if(dynamic_cast<HeadlessTexture2D*>(s_defaultTexture.get()))
+	{
+		s_defaultTexture.reset();
+	}
+
+	s_current = nullptr;
+}
+
+void HeadlessContext::clearCalls()
+{
+	m_calls.clear();
+	m_hasPreviousDraw = false;
+	m_drawCount = 0;
+	m_uploadedBytes = 0;
+	m_stateChangeCount = 0;
+}
+
+void HeadlessContext::record(const Call::Type type, const uint uploadedBytes, const RenderTarget2D *renderTarget)
+{
+	if(m_mode != RECORDING_MODE) return;
+
+	Call call(type);
+	call.uploadedBytes = uploadedBytes;
+	call.renderTarget = renderTarget;
+	m_calls.push_back(call);
+	m_uploadedBytes += uploadedBytes;
+}
+
+void HeadlessContext::recordDraw(Call &call, const uint uploadedBytes)
+{
+	// Draw the batched shapes first, so the calls stay in order
+	flushPrimitives();
+
+	// Capture the state the draw is issued with
+	call.texture = getTexture() ? getTexture().get() : s_defaultTexture.get();
+	call.shader = getShader() ? getShader().get() : s_defaultShader.get();
+	call.blendState = m_currentState->blendState;
+	call.modelViewProjection = getModelViewProjectionMatrix();
+	call.renderTarget = m_currentState->renderTarget;
+	call.uploadedBytes = uploadedBytes;
+
+	// Count state changes from the previous draw, which may be from an earlier frame
+	if(!m_hasPreviousDraw || m_previousDraw.texture != call.texture || m_previousDraw.shader != call.shader || m_previousDraw.blendState != call.blendState)
+	{
+		m_stateChangeCount++;
+	}
+	m_previousDraw = call;
+	m_hasPreviousDraw = true;
+
+	m_calls.push_back(call);
+	m_drawCount++;
+	m_uploadedBytes += uploadedBytes;
+}
+
+void HeadlessContext::enable(const Capability cap)
+{
+	m_capabilities |= 1 << cap;
+}
+
+void HeadlessContext::disable(const Capability cap)
+{
+	m_capabilities &= ~(1 << cap);
+}
+
+bool HeadlessContext::isEnabled(const Capability cap)
+{
+	return (m_capabilities & (1 << cap)) != 0;
+}
+
+void HeadlessContext::clear(const uint mask, const Color &fillColor)
+{
+	flushPrimitives();
+	if(m_mode != RECORDING_MODE) return;
+
+	Call call(Call::CLEAR);
+	call.clearMask = mask;
+	call.clearColor = fillColor;
+	call.renderTarget = m_currentState->renderTarget;
+	m_calls.push_back(call);
+}
+
+Matrix4 HeadlessContext::createOrtographicMatrix(const float l, const float r, const float t, const float b, const float n, const float f) const
+{
+	// Same matrix as the OpenGL backend, so recorded transforms can be compared
+	Matrix4 mat(
+		2.0f / (r - l), 0.0f,            0.0f,           -((r + l) / (r - l)),
+		0.0f,           2.0f / (t - b),  0.0f,           -((t + b) / (t - b)),
+		0.0f,           0.0f,           -2.0f / (f - n), -((f + n) / (f - n)),
+		0.0f,           0.0f,            0.0f,            1.0f);
+	return mat;
+}
+
+Matrix4 HeadlessContext::createPerspectiveMatrix(const float fov, const float aspectRatio, const float zNear, const float zFar) const
+{
+	const float s = tanf(math::degToRad(fov / 2.0f));
+	Matrix4 mat(
+		1.0f / (s * aspectRatio),    0.0f,      0.0f,                             0.0f,
+		0.0f,                        1.0f / s,  0.0f,                             0.0f,
+		0.0f,                        0.0f,     -(zFar + zNear) / (zFar - zNear), -(2 * zFar * zNear) / (zFar - zNear) ,
+		0.0f,                        0.0f,     -1.0f,                             0.0f);
+	return mat;
+}
+
+Matrix4 HeadlessContext::createLookAtMatrix(const Vector3F &position, const Vector3F &fwd) const
+{
+	const Vector3F worldUp(0.0f, 1.0f, 0.0f);
+	const Vector3F right = math::normalize(math::cross(worldUp, fwd));
+	const Vector3F up = math::cross(fwd, right);
+	Matrix4 cameraMatrix(
+		right.x, right.y, right.z, 0.0f,
+		up.x, up.y, up.z, 0.0f,
+		fwd.x, fwd.y, fwd.z, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+	Matrix4 cameraTranslate(
+		1, 0, 0, -position.x,
+		0, 1, 0, -position.y,
+		0, 0, 1, -position.z,
+		0.0f, 0.0f, 0.0f, 1.0f);
+	return cameraMatrix * cameraTranslate;
+}
+
+void HeadlessContext::drawIndexedPrimitives(const PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount, const uint *indices, const uint indexCount)
+{
+	if(m_mode != RECORDING_MODE || !vertexData || vertexCount == 0 || !indices || indexCount == 0) return;
+
+	Call call(Call::DRAW_INDEXED_PRIMITIVES);
+	call.primitiveType = type;
+	call.format = fmt;
+	call.vertexCount = vertexCount;
+	call.indexCount = indexCount;
+	recordDraw(call, vertexCount * fmt.getVertexSizeInBytes() + indexCount * sizeof(uint));
+}
+
+void HeadlessContext::drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo)
+{
+	if(!vbo || !ibo) return;
+	drawIndexedPrimitives(type, vbo, ibo, 0, ibo->getSize());
+}
+
+void HeadlessContext::drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo, const uint /*indexStart*/, const uint indexCount)
+{
+	if(m_mode != RECORDING_MODE || !vbo || !ibo || indexCount == 0) return;
+
+	Call call(Call::DRAW_INDEXED_PRIMITIVES);
+	call.primitiveType = type;
+	call.format = vbo->getVertexFormat();
+	call.vertexCount = vbo->getSize();
+	call.indexCount = indexCount;
+	recordDraw(call, 0);
+}
+
+void HeadlessContext::drawPrimitives(const PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount)
+{
+	if(m_mode != RECORDING_MODE || !vertexData || vertexCount == 0) return;
+
+	Call call(Call::DRAW_PRIMITIVES);
+	call.primitiveType = type;
+	call.format = fmt;
+	call.vertexCount = vertexCount;
+	recordDraw(call, vertexCount * fmt.getVertexSizeInBytes());
+}
+
+void HeadlessContext::drawPrimitives(const PrimitiveType type, const VertexBuffer *vbo)
+{
+	if(m_mode != RECORDING_MODE || !vbo || vbo->getSize() == 0) return;
+
+	Call call(Call::DRAW_PRIMITIVES);
+	call.primitiveType = type;
+	call.format = vbo->getVertexFormat();
+	call.vertexCount = vbo->getSize();
+	recordDraw(call, 0);
+}
+
+void HeadlessContext::drawSpriteInstances(const SpriteInstance *instances, const uint instanceCount)
+{
+	if(m_mode != RECORDING_MODE || !instances || instanceCount == 0) return;
+
+	Call call(Call::DRAW_SPRITE_INSTANCES);
+	call.primitiveType = PRIMITIVE_TRIANGLE_STRIP;
+	call.vertexCount = 4;
+	call.instanceCount = instanceCount;
+	recordDraw(call, instanceCount * sizeof(SpriteInstance));
+}
+
+Texture2D *HeadlessContext::createTexture(const Pixmap &pixmap)
+{
+	return static_cast<Texture2D*>(new HeadlessTexture2D(this, pixmap));
+}
+
+Shader *HeadlessContext::createShader(const string &/*vertexSource*/, const string &/*fragmentSource*/, const string &/*geometrySource*/)
+{
+	return static_cast<Shader*>(new HeadlessShader());
+}
+
+RenderTarget2D *HeadlessContext::createRenderTarget(const uint width, const uint height, const uint targetCount, const PixelFormat &format)
+{
+	return static_cast<RenderTarget2D*>(new HeadlessRenderTarget2D(this, width, height, targetCount, format));
+}
+
+void HeadlessContext::swapBuffers()
+{
+	m_calls.clear();
+}
+
+void HeadlessContext::setBufferData(const BufferTarget target, const uint /*buffer*/, const void * /*data*/, const uint size, const bool /*dynamic*/)
+{
+	record(target == VERTEX_BUFFER_TARGET ? Call::UPLOAD_VERTEX_BUFFER : Call::UPLOAD_INDEX_BUFFER, size);
+}
+
+void HeadlessContext::setBufferSubData(const BufferTarget target, const uint /*buffer*/, const uint /*offset*/, const void * /*data*/, const uint size)
+{
+	record(target == VERTEX_BUFFER_TARGET ? Call::UPLOAD_VERTEX_BUFFER : Call::UPLOAD_INDEX_BUFFER, size);
+}
+
+Window *HeadlessContext::createWindow(const string &title, const int x, const int y, const int w, const int h, const Uint32 flags)
+{
+	// The window is never shown, it only gives the game something to poll events from
+	m_window = new Window(this, title, x, y, w, h, SDL_WINDOW_HIDDEN | flags);
+	setSize(w, h);
+	setProjectionMatrix(createOrtographicMatrix(0.0f, (float) w, 0.0f, (float) h));
+	return m_window;
+}
+
+END_SAUCE_NAMESPACE
@@ -33,9 +33,19 @@ void checkError(const string &info)
 #endif
 
 // Global GL objects for easy rendering
+OpenGLContext::GLState OpenGLContext::s_glState;
+uint OpenGLContext::s_issuedStateCalls = 0;
+uint OpenGLContext::s_skippedStateCalls = 0;
+map<OpenGLContext::VertexArrayKey, GLuint> OpenGLContext::s_vertexArrays;
+GLuint OpenGLContext::s_currentVertexArray = 0;
+uint OpenGLContext::s_vertexArrayCacheHits = 0;
+uint OpenGLContext::s_vertexArrayCacheMisses = 0;
 GLuint OpenGLContext::s_vao = 0;
 GLuint OpenGLContext::s_vbo = 0;
 GLuint OpenGLContext::s_ibo = 0;
+shared_ptr<Shader> OpenGLContext::s_spriteInstanceShader = 0;
+shared_ptr<Shader> OpenGLContext::s_multiTextureShader = 0;
+uint OpenGLContext::s_textureSlotCount = 0;
 
 OpenGLContext::OpenGLContext(const int major, const int minor) :
 	m_majorVersion(major),
@@ -45,13 +55,25 @@ OpenGLContext::OpenGLContext(const int major, const int minor) :
 
 OpenGLContext::~OpenGLContext()
 {
+	delete m_quadIndexBuffer;
+	m_quadIndexBuffer = nullptr;
+
+	for(map<VertexArrayKey, GLuint>::iterator itr = s_vertexArrays.begin(); itr != s_vertexArrays.end(); ++itr)
+	{
+		glDeleteVertexArrays(1, &itr->second);
+	}
+	s_vertexArrays.clear();
+	s_currentVertexArray = 0;
+
 	glDeleteBuffers(1, &s_vbo);
+	glDeleteBuffers(1, &s_ibo);
 	glDeleteVertexArrays(1, &s_vao);
 	SDL_GL_DeleteContext(m_context);
 }
 
 void OpenGLContext::enable(const Capability cap)
 {
+	flushPrimitives();
 	switch(cap) {
 		case BLEND: glEnable(GL_BLEND); break;
 		case DEPTH_TEST: glEnable(GL_DEPTH_TEST); break;
@@ -73,6 +95,7 @@ void OpenGLContext::enable(const Capability cap)
 
 void OpenGLContext::disable(const Capability cap)
 {
+	flushPrimitives();
 	switch(cap) {
 		case BLEND: glDisable(GL_BLEND); break;
 		case DEPTH_TEST: glDisable(GL_DEPTH_TEST); break;
@@ -94,21 +117,44 @@ void OpenGLContext::disable(const Capability cap)
 
 bool OpenGLContext::isEnabled(const Capability cap)
 {
-	return (bool)glIsEnabled(cap);
+	switch(cap) {
+		case BLEND: return glIsEnabled(GL_BLEND) == GL_TRUE;
+		case DEPTH_TEST: return glIsEnabled(GL_DEPTH_TEST) == GL_TRUE;
+		case FACE_CULLING: return glIsEnabled(GL_CULL_FACE) == GL_TRUE;
+		case LINE_SMOOTH: return glIsEnabled(GL_LINE_SMOOTH) == GL_TRUE;
+		case POLYGON_SMOOTH: return glIsEnabled(GL_POLYGON_SMOOTH) == GL_TRUE;
+		case MULTISAMPLE: return glIsEnabled(GL_MULTISAMPLE) == GL_TRUE;
+		case TEXTURE_1D: return glIsEnabled(GL_TEXTURE_1D) == GL_TRUE;
+		case TEXTURE_2D: return glIsEnabled(GL_TEXTURE_2D) == GL_TRUE;
+		case TEXTURE_3D: return glIsEnabled(GL_TEXTURE_3D) == GL_TRUE;
+		case VSYNC:
+			return SDL_GL_GetSwapInterval() != 0;
+		case WIREFRAME:
+		{
+			GLint polygonMode[2];
+			glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+			return polygonMode[0] == GL_LINE;
+		}
+	}
+	return false;
 }
 
 void OpenGLContext::setPointSize(const float pointSize)
 {
+	flushPrimitives();
 	glPointSize(pointSize);
 }
 
 void OpenGLContext::setLineWidth(const float lineWidth)
 {
+	flushPrimitives();
 	glLineWidth(lineWidth);
 }
 
 void OpenGLContext::clear(const uint mask, const Color &fillColor)
 {
+	flushPrimitives();
+
 	if(mask & COLOR_BUFFER) glClearColor(fillColor.getR() / 255.0f, fillColor.getG() / 255.0f, fillColor.getB() / 255.0f, fillColor.getA() / 255.0f);
 	if(mask & DEPTH_BUFFER) glClearDepth(fillColor.getR() / 255.0f);
 	if(mask & STENCIL_BUFFER) glClearStencil(fillColor.getR() / 255.0f);
@@ -120,17 +166,21 @@ void OpenGLContext::clear(const uint mask, const Color &fillColor)
 
 void OpenGLContext::enableScissor(const int x, const int y, const int w, const int h)
 {
+	flushPrimitives();
 	glEnable(GL_SCISSOR_TEST);
 	glScissor(x, y, w, h);
 }
 
 void OpenGLContext::disableScissor()
 {
+	flushPrimitives();
 	glDisable(GL_SCISSOR_TEST);
 }
 
 void OpenGLContext::saveScreenshot(string path)
 {
+	flushPrimitives();
+
 	// Get frame buffer data
 	uchar *data = new uchar[m_currentState->width * m_currentState->height * 4];
 	glReadBuffer(GL_FRONT);
@@ -148,6 +198,7 @@ void OpenGLContext::saveScreenshot(string path)
 // Orthographic projection
 void OpenGLContext::setViewportSize(const uint w, const uint h)
 {
+	flushPrimitives();
 	// Set viewport
 	glViewport(0, 0, w, h);
 }
@@ -244,6 +295,7 @@ Window *OpenGLContext::createWindow(const string &title, const int x, const int
 	// Init graphics
 	glGenVertexArrays(1, &s_vao);
 	glBindVertexArray(s_vao);
+	s_currentVertexArray = s_vao;
 	glGenBuffers(1, &s_vbo);
 	glGenBuffers(1, &s_ibo);
 
@@ -300,6 +352,93 @@ Window *OpenGLContext::createWindow(const string &title, const int x, const int
 	OpenGLShader::s_glslVersion = getGLSLVersion();
 	s_defaultShader = shared_ptr<Shader>(new OpenGLShader(vertexShader, fragmentShader, ""));
 
+	// Create sprite instancing shader. Expands a triangle strip quad from
+	// gl_VertexID using the 2x3 affine transform of each instance
+	if(isInstancingSupported())
+	{
+		string instanceVertexShader =
+			"\n"
+			"in vec3 in_InstanceTransformX;\n"
+			"in vec3 in_InstanceTransformY;\n"
+			"in vec4 in_InstanceTexRegion;\n"
+			"in vec4 in_InstanceColor;\n"
+			"in float in_InstanceZ;\n"
+			"\n"
+			"out vec2 v_TexCoord;\n"
+			"out vec4 v_VertexColor;\n"
+			"\n"
+			"uniform mat4 u_ModelViewProj;\n"
+			"\n"
+			"void main()\n"
+			"{\n"
+			"	vec3 corner = vec3(float(gl_VertexID & 1), float(gl_VertexID >> 1), 1.0);\n"
+			"	vec2 position = vec2(dot(in_InstanceTransformX, corner), dot(in_InstanceTransformY, corner));\n"
+			"	gl_Position = vec4(position, in_InstanceZ, 1.0) * u_ModelViewProj;\n"
+			"	v_TexCoord = mix(in_InstanceTexRegion.xy, in_InstanceTexRegion.zw, corner.xy);\n"
+			"	v_VertexColor = in_InstanceColor;\n"
+			"}\n";
+		s_spriteInstanceShader = shared_ptr<Shader>(new OpenGLShader(instanceVertexShader, fragmentShader, ""));
+	}
+
+	// Create multi-texture shader. Samples the texture slot given by
+	// the third texture coordinate. The slot is the same for every vertex
+	// of a primitive, so it interpolates to itself
+	GLint textureUnitCount = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &textureUnitCount);
+	s_textureSlotCount = min(uint(max(textureUnitCount, 0)), MAX_TEXTURE_SLOTS);
+	if(s_textureSlotCount > 1)
+	{
+		string multiTextureVertexShader =
+			"\n"
+			"in vec2 in_Position;\n"
+			"in vec3 in_TexCoord;\n"
+			"in vec4 in_VertexColor;\n"
+			"\n"
+			"out vec2 v_TexCoord;\n"
+			"out float v_TexSlot;\n"
+			"out vec4 v_VertexColor;\n"
+			"\n"
+			"uniform mat4 u_ModelViewProj;\n"
+			"\n"
+			"void main()\n"
+			"{\n"
+			"	gl_Position = vec4(in_Position, 0.0, 1.0) * u_ModelViewProj;\n"
+			"	v_TexCoord = in_TexCoord.xy;\n"
+			"	v_TexSlot = in_TexCoord.z;\n"
+			"	v_VertexColor = in_VertexColor;\n"
+			"}\n";
+
+		stringstream multiTextureFragmentShader;
+		multiTextureFragmentShader <<
+			"\n"
+			"in vec2 v_TexCoord;\n"
+			"in float v_TexSlot;\n"
+			"in vec4 v_VertexColor;\n"
+			"\n"
+			"out vec4 out_FragColor;\n"
+			"\n";
+		for(uint i = 0; i < s_textureSlotCount; ++i)
+		{
+			multiTextureFragmentShader << "uniform sampler2D u_Texture" << i << ";\n";
+		}
+		multiTextureFragmentShader <<
+			"\n"
+			"void main()\n"
+			"{\n"
+			"	int slot = int(v_TexSlot + 0.5);\n"
+			"	vec4 color;\n"
+			"	";
+		for(uint i = 0; i < s_textureSlotCount - 1; ++i)
+		{
+			multiTextureFragmentShader << "if(slot == " << i << ") color = texture(u_Texture" << i << ", v_TexCoord);\n	else ";
+		}
+		multiTextureFragmentShader <<
+			"color = texture(u_Texture" << s_textureSlotCount - 1 << ", v_TexCoord);\n"
+			"	out_FragColor = color * v_VertexColor;\n"
+			"}\n";
+		s_multiTextureShader = shared_ptr<Shader>(new OpenGLShader(multiTextureVertexShader, multiTextureFragmentShader.str(), ""));
+	}
+
 	// Create blank texture
 	uchar pixel[4];
 	pixel[0] = pixel[1] = pixel[2] = pixel[3] = 255;
@@ -308,35 +447,76 @@ Window *OpenGLContext::createWindow(const string &title, const int x, const int
 	return m_window;
 }
 
+OpenGLContext::GLState::GLState() :
+	// GL_INVALID_ENUM is not a blend factor, so the first draw sets the blend function
+	blendSrc(GL_INVALID_ENUM),
+	blendDst(GL_INVALID_ENUM),
+	blendAlphaSrc(GL_INVALID_ENUM),
+	blendAlphaDst(GL_INVALID_ENUM),
+	program(0),
+	activeTextureUnit(0)
+{
+	for(uint i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		textures[i] = 0;
+	}
+}
+
 void OpenGLContext::setupContext()
 {
+	// Draw the batched shapes first, so draws stay in order
+	flushPrimitives();
+
 	// Set blend func
-	glBlendFuncSeparate(m_currentState->blendState.m_src, m_currentState->blendState.m_dst, m_currentState->blendState.m_alphaSrc, m_currentState->blendState.m_alphaDst);
-	GL_CHECK_ERROR(glBlendFuncSeparate);
+	const BlendState &blendState = m_currentState->blendState;
+	if(s_glState.blendSrc != GLenum(blendState.m_src) || s_glState.blendDst != GLenum(blendState.m_dst) ||
+	   s_glState.blendAlphaSrc != GLenum(blendState.m_alphaSrc) || s_glState.blendAlphaDst != GLenum(blendState.m_alphaDst))
+	{
+		glBlendFuncSeparate(blendState.m_src, blendState.m_dst, blendState.m_alphaSrc, blendState.m_alphaDst);
+		GL_CHECK_ERROR(glBlendFuncSeparate);
+		s_glState.blendSrc = blendState.m_src;
+		s_glState.blendDst = blendState.m_dst;
+		s_glState.blendAlphaSrc = blendState.m_alphaSrc;
+		s_glState.blendAlphaDst = blendState.m_alphaDst;
+		s_issuedStateCalls++;
+	}
+	else
+	{
+		s_skippedStateCalls++;
+	}
 
-	shared_ptr<Shader> shader = m_currentState->shader;
+	Shader *shader = getShader().get();
 	if(!shader)
 	{
-		shader = s_defaultShader;
-		shader->setSampler2D("u_Texture", m_currentState->texture == 0 ? s_defaultTexture : m_currentState->texture);
+		shader = s_defaultShader.get();
+		shader->setSampler2D("u_Texture", getTexture() ? getTexture() : s_defaultTexture);
 	}
 
-	OpenGLShader *glShader = dynamic_cast<OpenGLShader*>(shader.get());
+	OpenGLShader *glShader = dynamic_cast<OpenGLShader*>(shader);
 
 	// Enable shader
-	glUseProgram(glShader->m_id);
-	GL_CHECK_ERROR(glUseProgram);
+	if(s_glState.program != glShader->m_id)
+	{
+		glUseProgram(glShader->m_id);
+		GL_CHECK_ERROR(glUseProgram);
+		s_glState.program = glShader->m_id;
+		s_issuedStateCalls++;
+	}
+	else
+	{
+		s_skippedStateCalls++;
+	}
 
 	// Set projection matrix
-	Matrix4 modelViewProjection = m_currentState->projectionMatrix * m_currentState->transformationMatrixStack.top();
-	shader->setUniformMatrix4f("u_ModelViewProj", modelViewProjection.get());
-
-	GLuint target = 0;
+	shader->setUniformMatrix4f("u_ModelViewProj", getModelViewProjectionMatrix().get());
 
-	// Set all uniforms
-	for(map<string, OpenGLShader::Uniform*>::iterator itr = glShader->m_uniforms.begin(); itr != glShader->m_uniforms.end(); ++itr)
+	// Upload the uniforms that changed. The program keeps the values of the others
+	s_skippedStateCalls += glShader->m_uniforms.size() - glShader->m_dirtyUniforms.size();
+	s_issuedStateCalls += glShader->m_dirtyUniforms.size();
+	for(vector<OpenGLShader::Uniform*>::iterator itr = glShader->m_dirtyUniforms.begin(); itr != glShader->m_dirtyUniforms.end(); ++itr)
 	{
-		const OpenGLShader::Uniform *uniform = itr->second;
+		OpenGLShader::Uniform *uniform = *itr;
+		uniform->dirty = false;
 		switch(uniform->type)
 		{
 			case GL_INT: case GL_BOOL: glUniform1iv(uniform->loc, uniform->count, (const GLint*) uniform->data); break;
@@ -356,111 +536,112 @@ void OpenGLContext::setupContext()
 
 			case GL_FLOAT_MAT4: glUniformMatrix4fv(uniform->loc, 1, GL_FALSE, (GLfloat*) uniform->data); break;
 
+			// The texture is bound below, the uniform only holds the texture unit
 			case GL_UNSIGNED_INT_SAMPLER_2D:
 			case GL_INT_SAMPLER_2D:
-			case GL_SAMPLER_2D:
-			{
-				glActiveTexture(GL_TEXTURE0 + target);
-				glBindTexture(GL_TEXTURE_2D, ((GLuint*) uniform->data)[0]);
-				glUniform1i(uniform->loc, target++);
-			}
-			break;
+			case GL_SAMPLER_2D: glUniform1i(uniform->loc, uniform->textureUnit); break;
 		}
 		GL_CHECK_ERROR(glUniform1i);
 	}
+	glShader->m_dirtyUniforms.clear();
+
+	// Bind sampler textures. Texture units are shared by all programs, so this is checked every draw
+	for(vector<OpenGLShader::Uniform*>::iterator itr = glShader->m_samplers.begin(); itr != glShader->m_samplers.end(); ++itr)
+	{
+		bindTexture((*itr)->textureUnit, ((GLuint*) (*itr)->data)[0]);
+	}
 }
 
-void OpenGLContext::drawIndexedPrimitives(const PrimitiveType type, const Vertex *vertices, const uint vertexCount, const uint *indices, const uint indexCount)
+void OpenGLContext::bindTexture(const uint unit, const GLuint texture)
 {
-	// If there are no vertices to draw, do nothing
-	if(vertexCount == 0 || indexCount == 0) return;
-
-	setupContext();
+	if(unit < MAX_TEXTURE_UNITS && s_glState.textures[unit] == texture)
+	{
+		s_skippedStateCalls++;
+		return;
+	}
 
-	// Get vertices and vertex data
-	VertexFormat fmt = vertices->getFormat();
-	int vertexSizeInBytes = fmt.getVertexSizeInBytes();
-	char *vertexData = new char[vertexCount * vertexSizeInBytes];
-	for(uint i = 0; i < vertexCount; ++i)
+	if(s_glState.activeTextureUnit != unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit); GL_CHECK_ERROR(glActiveTexture);
+		s_glState.activeTextureUnit = unit;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture); GL_CHECK_ERROR(glBindTexture);
+	if(unit < MAX_TEXTURE_UNITS)
 	{
-		vertices[i].getData(vertexData + i * vertexSizeInBytes);
+		s_glState.textures[unit] = texture;
 	}
+	s_issuedStateCalls++;
+}
 
-	// Bind buffers
-	glBindBuffer(GL_ARRAY_BUFFER, s_vbo); GL_CHECK_ERROR(glBindBuffer);
-	glBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSizeInBytes, vertexData, GL_DYNAMIC_DRAW); GL_CHECK_ERROR(glBufferData);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_ibo); GL_CHECK_ERROR(glBindBuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint), indices, GL_DYNAMIC_DRAW); GL_CHECK_ERROR(glBufferData);
+void OpenGLContext::bindTexture(const GLuint texture)
+{
+	bindTexture(s_glState.activeTextureUnit, texture);
+}
 
-	// Set array pointers
-	for(int i = 0; i < VERTEX_ATTRIB_MAX; i++)
+void OpenGLContext::unbindTexture(const GLuint texture)
+{
+	for(uint i = 0; i < MAX_TEXTURE_UNITS; i++)
 	{
-		VertexAttribute attrib = VertexAttribute(i);
-		switch(attrib)
+		if(s_glState.textures[i] == texture)
 		{
-			case VERTEX_POSITION:
-				if(fmt.isAttributeEnabled(attrib))
-				{
-					glEnableVertexAttribArray(0); GL_CHECK_ERROR(glEnableVertexAttribArray);
-					glVertexAttribPointer(0, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_FALSE, vertexSizeInBytes, (void*) fmt.getAttributeOffset(attrib)); GL_CHECK_ERROR(glVertexAttribPointer);
-				}
-				else
-				{
-					glDisableVertexAttribArray(0); GL_CHECK_ERROR(glDisableVertexAttribArray);
-				}
-				break;
-
-			case VERTEX_COLOR:
-				if(fmt.isAttributeEnabled(attrib))
-				{
-					glEnableVertexAttribArray(1); GL_CHECK_ERROR(glEnableVertexAttribArray);
-					glVertexAttribPointer(1, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_TRUE, vertexSizeInBytes, (void*) fmt.getAttributeOffset(attrib)); GL_CHECK_ERROR(glVertexAttribPointer);
-				}
-				else
-				{
-					glDisableVertexAttribArray(1); GL_CHECK_ERROR(glDisableVertexAttribArray);
-				}
-				break;
-
-			case VERTEX_TEX_COORD:
-				if(fmt.isAttributeEnabled(attrib))
-				{
-					glEnableVertexAttribArray(2); GL_CHECK_ERROR(glEnableVertexAttribArray);
-					glVertexAttribPointer(2, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_FALSE, vertexSizeInBytes, (void*) fmt.getAttributeOffset(attrib)); GL_CHECK_ERROR(glVertexAttribPointer);
-				}
-				else
-				{
-					glDisableVertexAttribArray(2); GL_CHECK_ERROR(glDisableVertexAttribArray);
-				}
-				break;
+			s_glState.textures[i] = 0;
 		}
 	}
+}
 
-	// Draw primitives
-	glDrawElements(type, indexCount, GL_UNSIGNED_INT, 0); GL_CHECK_ERROR(glDrawElements);
-
-	// Reset vbo buffers
-	glBindBuffer(GL_ARRAY_BUFFER, 0); GL_CHECK_ERROR(glBindBuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); GL_CHECK_ERROR(glBindBuffer);
+OpenGLContext::VertexArrayKey::VertexArrayKey(const VertexFormat &fmt, const GLuint vertexBuffer, const GLuint indexBuffer) :
+	vertexBuffer(vertexBuffer),
+	indexBuffer(indexBuffer)
+{
+	for(int i = 0; i < VERTEX_ATTRIB_MAX; i++)
+	{
+		const VertexAttribute attrib = VertexAttribute(i);
+		elementCounts[i] = fmt.isAttributeEnabled(attrib) ? fmt.getElementCount(attrib) : 0;
+		dataTypes[i] = fmt.isAttributeEnabled(attrib) ? fmt.getDataType(attrib) : SAUCE_FLOAT;
+	}
+}
 
-	// Release vertex data
-	delete[] vertexData;
+bool OpenGLContext::VertexArrayKey::operator<(const VertexArrayKey &other) const
+{
+	if(vertexBuffer != other.vertexBuffer) return vertexBuffer < other.vertexBuffer;
+	if(indexBuffer != other.indexBuffer) return indexBuffer < other.indexBuffer;
+	for(int i = 0; i < VERTEX_ATTRIB_MAX; i++)
+	{
+		if(elementCounts[i] != other.elementCounts[i]) return elementCounts[i] < other.elementCounts[i];
+		if(dataTypes[i] != other.dataTypes[i]) return dataTypes[i] < other.dataTypes[i];
+	}
+	return false;
 }
 
-void OpenGLContext::drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo)
+void OpenGLContext::bindVertexArray(const VertexFormat &fmt, const GLuint vertexBuffer, const GLuint indexBuffer)
 {
-	// If one of the buffers are empty, do nothing
-	if(vbo->getSize() == 0 || ibo->getSize() == 0) return; 
+	const VertexArrayKey key(fmt, vertexBuffer, indexBuffer);
+	map<VertexArrayKey, GLuint>::iterator itr = s_vertexArrays.find(key);
+	if(itr != s_vertexArrays.end())
+	{
+		s_vertexArrayCacheHits++;
+		if(itr->second != s_currentVertexArray)
+		{
+			glBindVertexArray(itr->second); GL_CHECK_ERROR(glBindVertexArray);
+			s_currentVertexArray = itr->second;
+		}
+		return;
+	}
 
-	setupContext();
+	// Create a vertex array for the format and buffers
+	s_vertexArrayCacheMisses++;
+	GLuint vao;
+	glGenVertexArrays(1, &vao); GL_CHECK_ERROR(glGenVertexArrays);
+	glBindVertexArray(vao); GL_CHECK_ERROR(glBindVertexArray);
+	s_vertexArrays[key] = vao;
+	s_currentVertexArray = vao;
 
-	// Bind vertices and indices array
-	glBindBuffer(GL_ARRAY_BUFFER, vbo->m_id);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo->m_id);
+	// The attribute pointers refer to the buffer bound to GL_ARRAY_BUFFER when they are set
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer); GL_CHECK_ERROR(glBindBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer); GL_CHECK_ERROR(glBindBuffer);
 
 	// Set array pointers
-	VertexFormat fmt = vbo->getVertexFormat();
-	int stride = fmt.getVertexSizeInBytes();
+	const int stride = fmt.getVertexSizeInBytes();
 	for(int i = 0; i < VERTEX_ATTRIB_MAX; i++)
 	{
 		VertexAttribute attrib = VertexAttribute(i);
@@ -469,125 +650,99 @@ void OpenGLContext::drawIndexedPrimitives(const PrimitiveType type, const Vertex
 			case VERTEX_POSITION:
 				if(fmt.isAttributeEnabled(attrib))
 				{
-					glEnableVertexAttribArray(0);
-					glVertexAttribPointer(0, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_FALSE, stride, (void*) fmt.getAttributeOffset(attrib));
-				}
-				else
-				{
-					glDisableVertexAttribArray(0);
+					glEnableVertexAttribArray(0); GL_CHECK_ERROR(glEnableVertexAttribArray);
+					glVertexAttribPointer(0, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_FALSE, stride, (void*) fmt.getAttributeOffset(attrib)); GL_CHECK_ERROR(glVertexAttribPointer);
 				}
 				break;
 
 			case VERTEX_COLOR:
 				if(fmt.isAttributeEnabled(attrib))
 				{
-					glEnableVertexAttribArray(1);
-					glVertexAttribPointer(1, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_TRUE, stride, (void*) fmt.getAttributeOffset(attrib));
-				}
-				else
-				{
-					glDisableVertexAttribArray(1);
+					glEnableVertexAttribArray(1); GL_CHECK_ERROR(glEnableVertexAttribArray);
+					glVertexAttribPointer(1, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_TRUE, stride, (void*) fmt.getAttributeOffset(attrib)); GL_CHECK_ERROR(glVertexAttribPointer);
 				}
 				break;
 
 			case VERTEX_TEX_COORD:
 				if(fmt.isAttributeEnabled(attrib))
 				{
-					glEnableVertexAttribArray(2);
-					glVertexAttribPointer(2, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_FALSE, stride, (void*) fmt.getAttributeOffset(attrib));
-				}
-				else
-				{
-					glDisableVertexAttribArray(2);
+					glEnableVertexAttribArray(2); GL_CHECK_ERROR(glEnableVertexAttribArray);
+					glVertexAttribPointer(2, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_FALSE, stride, (void*) fmt.getAttributeOffset(attrib)); GL_CHECK_ERROR(glVertexAttribPointer);
 				}
 				break;
 		}
 	}
+}
 
-	// Draw vbo
-	glDrawElements(type, ibo->getSize(), GL_UNSIGNED_INT, 0);
-
-	// Reset vbo buffers
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-	GL_CHECK_ERROR(glBindBuffer);
+void OpenGLContext::deleteVertexArrays(const GLuint buffer)
+{
+	for(map<VertexArrayKey, GLuint>::iterator itr = s_vertexArrays.begin(); itr != s_vertexArrays.end();)
+	{
+		if(itr->first.vertexBuffer == buffer || itr->first.indexBuffer == buffer)
+		{
+			// Deleting the bound vertex array reverts the binding to zero
+			if(itr->second == s_currentVertexArray)
+			{
+				s_currentVertexArray = 0;
+			}
+			glDeleteVertexArrays(1, &itr->second);
+			itr = s_vertexArrays.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
 }
 
-void OpenGLContext::drawPrimitives(const PrimitiveType type, const Vertex *vertices, const uint vertexCount)
+void OpenGLContext::drawIndexedPrimitives(const PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount, const uint *indices, const uint indexCount)
 {
 	// If there are no vertices to draw, do nothing
-	if(vertexCount == 0) return;
+	if(vertexCount == 0 || indexCount == 0) return;
 
 	setupContext();
+	bindVertexArray(fmt, s_vbo, s_ibo);
 
-	// Get vertices and vertex data
-	VertexFormat fmt = vertices->getFormat();
-	int vertexSizeInBytes = fmt.getVertexSizeInBytes();
-	char *vertexData = new char[vertexCount * vertexSizeInBytes];
-	for(uint i = 0; i < vertexCount; ++i)
-	{
-		vertices[i].getData(vertexData + i * vertexSizeInBytes);
-	}
+	// Upload vertices and indices. The index buffer is bound by the vertex array
+	glBindBuffer(GL_ARRAY_BUFFER, s_vbo); GL_CHECK_ERROR(glBindBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * fmt.getVertexSizeInBytes(), vertexData, GL_DYNAMIC_DRAW); GL_CHECK_ERROR(glBufferData);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint), indices, GL_DYNAMIC_DRAW); GL_CHECK_ERROR(glBufferData);
 
-	// Bind buffer
-	glBindBuffer(GL_ARRAY_BUFFER, s_vbo);
-	glBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSizeInBytes, vertexData, GL_DYNAMIC_DRAW);
+	// Draw primitives
+	glDrawElements(type, indexCount, GL_UNSIGNED_INT, 0); GL_CHECK_ERROR(glDrawElements);
+}
 
-	// Set array pointers
-	for(int i = 0; i < VERTEX_ATTRIB_MAX; i++)
-	{
-		VertexAttribute attrib = VertexAttribute(i);
-		switch(attrib)
-		{
-			case VERTEX_POSITION:
-				if(fmt.isAttributeEnabled(attrib))
-				{
-					glEnableVertexAttribArray(0);
-					glVertexAttribPointer(0, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_FALSE, vertexSizeInBytes, (void*) fmt.getAttributeOffset(attrib));
-				}
-				else
-				{
-					glDisableVertexAttribArray(0);
-				}
-				break;
+void OpenGLContext::drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo)
+{
+	drawIndexedPrimitives(type, vbo, ibo, 0, ibo->getSize());
+}
 
-			case VERTEX_COLOR:
-				if(fmt.isAttributeEnabled(attrib))
-				{
-					glEnableVertexAttribArray(1);
-					glVertexAttribPointer(1, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_TRUE, vertexSizeInBytes, (void*) fmt.getAttributeOffset(attrib));
-				}
-				else
-				{
-					glDisableVertexAttribArray(1);
-				}
-				break;
+void OpenGLContext::drawIndexedPrimitives(const PrimitiveType type, const VertexBuffer *vbo, const IndexBuffer *ibo, const uint indexStart, const uint indexCount)
+{
+	// If one of the buffers are empty, do nothing
+	if(vbo->getSize() == 0 || indexCount == 0) return; 
 
-			case VERTEX_TEX_COORD:
-				if(fmt.isAttributeEnabled(attrib))
-				{
-					glEnableVertexAttribArray(2);
-					glVertexAttribPointer(2, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_FALSE, vertexSizeInBytes, (void*) fmt.getAttributeOffset(attrib));
-				}
-				else
-				{
-					glDisableVertexAttribArray(2);
-				}
-				break;
-		}
-	}
+	setupContext();
+	bindVertexArray(vbo->m_format, vbo->m_id, ibo->m_id);
 
-	// Draw primitives
-	glDrawArrays(type, 0, vertexCount);
+	// Draw vbo
+	glDrawElements(type, indexCount, GL_UNSIGNED_INT, (void*) (indexStart * sizeof(uint))); GL_CHECK_ERROR(glDrawElements);
+}
 
-	// Reset vbo buffers
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+void OpenGLContext::drawPrimitives(const PrimitiveType type, const VertexFormat &fmt, const void *vertexData, const uint vertexCount)
+{
+	// If there are no vertices to draw, do nothing
+	if(vertexCount == 0) return;
 
-	GL_CHECK_ERROR(glBindBuffer);
+	setupContext();
+	bindVertexArray(fmt, s_vbo, 0);
+
+	// Upload vertices
+	glBindBuffer(GL_ARRAY_BUFFER, s_vbo); GL_CHECK_ERROR(glBindBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * fmt.getVertexSizeInBytes(), vertexData, GL_DYNAMIC_DRAW); GL_CHECK_ERROR(glBufferData);
 
-	// Release vertex data
-	delete[] vertexData;
+	// Draw primitives
+	glDrawArrays(type, 0, vertexCount); GL_CHECK_ERROR(glDrawArrays);
 }
 
 void OpenGLContext::drawPrimitives(const PrimitiveType type, const VertexBuffer *vbo)
@@ -596,63 +751,66 @@ void OpenGLContext::drawPrimitives(const PrimitiveType type, const VertexBuffer
 	if(vbo->getSize() == 0) return;
 
 	setupContext();
+	bindVertexArray(vbo->m_format, vbo->m_id, 0);
 
-	// Bind vertices and indices array
-	glBindBuffer(GL_ARRAY_BUFFER, vbo->m_id);
+	// Draw vbo
+	glDrawArrays(type, 0, vbo->getSize()); GL_CHECK_ERROR(glDrawArrays);
+}
 
-	// Set array pointers
-	VertexFormat fmt = vbo->getVertexFormat();
-	int stride = fmt.getVertexSizeInBytes();
-	for(int i = 0; i < VERTEX_ATTRIB_MAX; i++)
+bool OpenGLContext::isInstancingSupported() const
+{
+	return m_majorVersion > 3 || (m_majorVersion == 3 && m_minorVersion >= 3);
+}
+
+void OpenGLContext::drawSpriteInstances(const SpriteInstance *instances, const uint instanceCount)
+{
+	// If there are no instances to draw, do nothing
+	if(instanceCount == 0) return;
+
+	if(!s_spriteInstanceShader)
 	{
-		VertexAttribute attrib = VertexAttribute(i);
-		switch(attrib)
-		{
-			case VERTEX_POSITION:
-				if(fmt.isAttributeEnabled(attrib))
-				{
-					glEnableVertexAttribArray(0);
-					glVertexAttribPointer(0, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_FALSE, stride, (void*) fmt.getAttributeOffset(attrib));
-				}
-				else
-				{
-					glDisableVertexAttribArray(0);
-				}
-				break;
+		LOG("OpenGLContext::drawSpriteInstances(): Instancing requires OpenGL 3.3");
+		return;
+	}
 
-			case VERTEX_COLOR:
-				if(fmt.isAttributeEnabled(attrib))
-				{
-					glEnableVertexAttribArray(1);
-					glVertexAttribPointer(1, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_TRUE, stride, (void*) fmt.getAttributeOffset(attrib));
-				}
-				else
-				{
-					glDisableVertexAttribArray(1);
-				}
-				break;
+	// Setup context with the instancing shader
+	shared_ptr<Shader> shader = s_spriteInstanceShader;
+	m_shaderStack[m_currentState->shader].swap(shader);
+	s_spriteInstanceShader->setSampler2D("u_Texture", getTexture() ? getTexture() : s_defaultTexture);
+	setupContext();
+	m_shaderStack[m_currentState->shader].swap(shader);
 
-			case VERTEX_TEX_COORD:
-				if(fmt.isAttributeEnabled(attrib))
-				{
-					glEnableVertexAttribArray(2);
-					glVertexAttribPointer(2, fmt.getElementCount(attrib), fmt.getDataType(attrib), GL_FALSE, stride, (void*) fmt.getAttributeOffset(attrib));
-				}
-				else
-				{
-					glDisableVertexAttribArray(2);
-				}
-				break;
-		}
+	// Instances are drawn with their own vertex array
+	if(s_currentVertexArray != s_vao)
+	{
+		glBindVertexArray(s_vao); GL_CHECK_ERROR(glBindVertexArray);
+		s_currentVertexArray = s_vao;
 	}
 
-	// Draw vbo
-	glDrawArrays(type, 0, vbo->getSize());
+	// Upload instances
+	glBindBuffer(GL_ARRAY_BUFFER, s_vbo); GL_CHECK_ERROR(glBindBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(SpriteInstance), instances, GL_DYNAMIC_DRAW); GL_CHECK_ERROR(glBufferData);
+
+	// Set instance array pointers
+	const GLsizei stride = sizeof(SpriteInstance);
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(2);
+	glEnableVertexAttribArray(3); glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*) offsetof(SpriteInstance, transform));
+	glEnableVertexAttribArray(4); glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*) (offsetof(SpriteInstance, transform) + 3 * sizeof(float)));
+	glEnableVertexAttribArray(5); glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, (void*) offsetof(SpriteInstance, uv));
+	glEnableVertexAttribArray(6); glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*) offsetof(SpriteInstance, color));
+	glEnableVertexAttribArray(7); glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, stride, (void*) offsetof(SpriteInstance, z));
+	for(GLuint i = 3; i <= 7; i++)
+	{
+		glVertexAttribDivisor(i, 1);
+	}
+	GL_CHECK_ERROR(glVertexAttribPointer);
 
-	// Reset vbo buffers
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// Draw instances
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instanceCount); GL_CHECK_ERROR(glDrawArraysInstanced);
 
-	GL_CHECK_ERROR(glBindBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, 0); GL_CHECK_ERROR(glBindBuffer);
 }
 
 RenderTarget2D *OpenGLContext::createRenderTarget(const uint width, const uint height, const uint targetCount, const PixelFormat &format)
@@ -660,6 +818,41 @@ RenderTarget2D *OpenGLContext::createRenderTarget(const uint width, const uint h
 	return static_cast<RenderTarget2D*>(new OpenGLRenderTarget2D(this, width, height, targetCount, format));
 }
 
+void OpenGLContext::swapBuffers()
+{
+	SDL_GL_SwapWindow(m_window->getSDLHandle());
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+uint OpenGLContext::createBuffer()
+{
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	return buffer;
+}
+
+void OpenGLContext::deleteBuffer(const uint buffer)
+{
+	deleteVertexArrays(buffer);
+	glDeleteBuffers(1, &buffer);
+}
+
+void OpenGLContext::setBufferData(const BufferTarget target, const uint buffer, const void *data, const uint size, const bool dynamic)
+{
+	// Index buffers are uploaded through GL_ARRAY_BUFFER too, as the element
+	// array binding belongs to whichever vertex array object is bound
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, size, data, dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void OpenGLContext::setBufferSubData(const BufferTarget target, const uint buffer, const uint offset, const void *data, const uint size)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 string OpenGLContext::getGLSLVersion() const
 {
 	switch(m_majorVersion)
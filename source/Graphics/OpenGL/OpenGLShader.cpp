@@ -101,6 +101,11 @@ void OpenGLShader::compileShader(const string &vertexSource, const string &fragm
 	glBindAttribLocation(m_id, 0, "in_Position");
 	glBindAttribLocation(m_id, 1, "in_VertexColor");
 	glBindAttribLocation(m_id, 2, "in_TexCoord");
+	glBindAttribLocation(m_id, 3, "in_InstanceTransformX");
+	glBindAttribLocation(m_id, 4, "in_InstanceTransformY");
+	glBindAttribLocation(m_id, 5, "in_InstanceTexRegion");
+	glBindAttribLocation(m_id, 6, "in_InstanceColor");
+	glBindAttribLocation(m_id, 7, "in_InstanceZ");
 	glBindFragDataLocation(m_id, 0, "out_FragColor");
 
 	link();
@@ -146,7 +151,15 @@ void OpenGLShader::compileShader(const string &vertexSource, const string &fragm
 			case GL_FLOAT_VEC4:	dataSize = FLOAT_SIZE * 4; break;
 			case GL_FLOAT_MAT4:	dataSize = FLOAT_SIZE * 16; break;
 		}
-		uniform->data = new char[dataSize * size];
+		uniform->data = new char[dataSize * size]();
+
+		// Samplers get a texture unit each
+		if(type == GL_SAMPLER_2D || type == GL_INT_SAMPLER_2D || type == GL_UNSIGNED_INT_SAMPLER_2D)
+		{
+			uniform->textureUnit = m_samplers.size();
+			m_samplers.push_back(uniform);
+		}
+		m_dirtyUniforms.push_back(uniform);
 
 		string strName = name;
 		if(strName.length() > 3 && strName.substr(strName.length() - 3) == "[0]")
@@ -210,7 +223,8 @@ void OpenGLShader::setUniform1i(const string &name, const int v0)
 		{
 			if(uniform->count == 1)
 			{
-				((GLint*) uniform->data)[0] = v0;
+				const GLint value = v0;
+				setUniformData(uniform, &value, sizeof(value));
 			}
 			else
 			{
@@ -236,8 +250,8 @@ void OpenGLShader::setUniform2i(const string &name, const int v0, const int v1)
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_INT_VEC2 || uniform->type == GL_BOOL_VEC2)
 		{
-			((GLint*) uniform->data)[0] = v0;
-			((GLint*) uniform->data)[1] = v1;
+			const GLint values[] = { v0, v1 };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -258,9 +272,8 @@ void OpenGLShader::setUniform3i(const string &name, const int v0, const int v1,
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_INT_VEC3 || uniform->type == GL_BOOL_VEC3)
 		{
-			((GLint*) uniform->data)[0] = v0;
-			((GLint*) uniform->data)[1] = v1;
-			((GLint*) uniform->data)[2] = v2;
+			const GLint values[] = { v0, v1, v2 };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -281,10 +294,8 @@ void OpenGLShader::setUniform4i(const string &name, const int v0, const int v1,
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_INT_VEC4 || uniform->type == GL_BOOL_VEC4)
 		{
-			((GLint*) uniform->data)[0] = v0;
-			((GLint*) uniform->data)[1] = v1;
-			((GLint*) uniform->data)[2] = v2;
-			((GLint*) uniform->data)[3] = v3;
+			const GLint values[] = { v0, v1, v2, v3 };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -307,7 +318,7 @@ void OpenGLShader::setUniform1iv(const string &name, const uint count, const int
 		{
 			if(uniform->count == count)
 			{
-				memcpy(uniform->data, v, 1 * uniform->count * INT_SIZE);
+				setUniformData(uniform, v, 1 * uniform->count * INT_SIZE);
 			}
 			else
 			{
@@ -335,7 +346,7 @@ void OpenGLShader::setUniform2iv(const string &name, const uint count, const int
 		{
 			if(uniform->count == count)
 			{
-				memcpy(uniform->data, v, 2 * uniform->count * INT_SIZE);
+				setUniformData(uniform, v, 2 * uniform->count * INT_SIZE);
 			}
 			else
 			{
@@ -363,7 +374,7 @@ void OpenGLShader::setUniform3iv(const string &name, const uint count, const int
 		{
 			if(uniform->count == count)
 			{
-				memcpy(uniform->data, v, 3 * uniform->count * INT_SIZE);
+				setUniformData(uniform, v, 3 * uniform->count * INT_SIZE);
 			}
 			else
 			{
@@ -391,7 +402,7 @@ void OpenGLShader::setUniform4iv(const string &name, const uint count, const int
 		{
 			if(uniform->count == count)
 			{
-				memcpy(uniform->data, v, 4 * uniform->count * INT_SIZE);
+				setUniformData(uniform, v, 4 * uniform->count * INT_SIZE);
 			}
 			else
 			{
@@ -417,7 +428,8 @@ void OpenGLShader::setUniform1ui(const string &name, const uint v0)
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_UNSIGNED_INT)
 		{
-			((GLuint*) uniform->data)[0] = v0;
+			const GLuint value = v0;
+			setUniformData(uniform, &value, sizeof(value));
 		}
 		else
 		{
@@ -438,8 +450,8 @@ void OpenGLShader::setUniform2ui(const string &name, const uint v0, const uint v
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_UNSIGNED_INT_VEC2)
 		{
-			((GLuint*) uniform->data)[0] = v0;
-			((GLuint*) uniform->data)[1] = v1;
+			const GLuint values[] = { v0, v1 };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -460,9 +472,8 @@ void OpenGLShader::setUniform3ui(const string &name, const uint v0, const uint v
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_UNSIGNED_INT_VEC3)
 		{
-			((GLuint*) uniform->data)[0] = v0;
-			((GLuint*) uniform->data)[1] = v1;
-			((GLuint*) uniform->data)[2] = v2;
+			const GLuint values[] = { v0, v1, v2 };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -483,10 +494,8 @@ void OpenGLShader::setUniform4ui(const string &name, const uint v0, const uint v
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_UNSIGNED_INT_VEC4)
 		{
-			((GLuint*) uniform->data)[0] = v0;
-			((GLuint*) uniform->data)[1] = v1;
-			((GLuint*) uniform->data)[2] = v2;
-			((GLuint*) uniform->data)[3] = v3;
+			const GLuint values[] = { v0, v1, v2, v3 };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -507,7 +516,8 @@ void OpenGLShader::setUniform1f(const string &name, const float v0)
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_FLOAT)
 		{
-			((GLfloat*) uniform->data)[0] = v0;
+			const GLfloat value = v0;
+			setUniformData(uniform, &value, sizeof(value));
 		}
 		else
 		{
@@ -528,8 +538,8 @@ void OpenGLShader::setUniform2f(const string &name, const float v0, const float
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_FLOAT_VEC2)
 		{
-			((GLfloat*) uniform->data)[0] = v0;
-			((GLfloat*) uniform->data)[1] = v1;
+			const GLfloat values[] = { v0, v1 };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -550,7 +560,7 @@ void OpenGLShader::setUniform2f(const string & name, const float *v)
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_FLOAT_VEC2)
 		{
-			memcpy(uniform->data, v,  2 * uniform->count * FLOAT_SIZE);
+			setUniformData(uniform, v, 2 * uniform->count * FLOAT_SIZE);
 		}
 		else
 		{
@@ -571,9 +581,8 @@ void OpenGLShader::setUniform3f(const string &name, const float v0, const float
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_FLOAT_VEC3)
 		{
-			((GLfloat*) uniform->data)[0] = v0;
-			((GLfloat*) uniform->data)[1] = v1;
-			((GLfloat*) uniform->data)[2] = v2;
+			const GLfloat values[] = { v0, v1, v2 };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -594,10 +603,8 @@ void OpenGLShader::setUniform4f(const string &name, const float v0, const float
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_FLOAT_VEC4)
 		{
-			((GLfloat*) uniform->data)[0] = v0;
-			((GLfloat*) uniform->data)[1] = v1;
-			((GLfloat*) uniform->data)[2] = v2;
-			((GLfloat*) uniform->data)[3] = v3;
+			const GLfloat values[] = { v0, v1, v2, v3 };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -618,7 +625,7 @@ void OpenGLShader::setUniform4f(const string &name, const float *v)
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_FLOAT_VEC4)
 		{
-			memcpy(uniform->data, v, 4 * uniform->count * FLOAT_SIZE);
+			setUniformData(uniform, v, 4 * uniform->count * FLOAT_SIZE);
 		}
 		else
 		{
@@ -639,10 +646,7 @@ void OpenGLShader::setUniformMatrix4f(const string & name, const float * v0)
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_FLOAT_MAT4)
 		{
-			for(int i = 0; i < 16; ++i)
-			{
-				((GLfloat*) uniform->data)[i] = v0[i];
-			}
+			setUniformData(uniform, v0, 16 * FLOAT_SIZE);
 		}
 		else
 		{
@@ -666,7 +670,8 @@ void OpenGLShader::setSampler2D(const string &name, shared_ptr<Texture2D> textur
 			uniform->type == GL_INT_SAMPLER_2D ||
 			uniform->type == GL_UNSIGNED_INT_SAMPLER_2D)
 		{
-			((GLuint*) uniform->data)[0] = texture != 0 ? dynamic_cast<OpenGLTexture2D*>(texture.get())->getID() : 0;
+			const GLuint value = texture != 0 ? dynamic_cast<OpenGLTexture2D*>(texture.get())->getID() : 0;
+			setUniformData(uniform, &value, sizeof(value));
 		}
 		else
 		{
@@ -687,10 +692,8 @@ void OpenGLShader::setUniformColor(const string &name, const Color &color)
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_FLOAT_VEC4)
 		{
-			((GLfloat*) uniform->data)[0] = color.getR() / 255.0f;
-			((GLfloat*) uniform->data)[1] = color.getG() / 255.0f;
-			((GLfloat*) uniform->data)[2] = color.getB() / 255.0f;
-			((GLfloat*) uniform->data)[3] = color.getA() / 255.0f;
+			const GLfloat values[] = { color.getR() / 255.0f, color.getG() / 255.0f, color.getB() / 255.0f, color.getA() / 255.0f };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -711,9 +714,8 @@ void OpenGLShader::setUniformColorRGB(const string &name, const ColorRGB &color)
 		Uniform *uniform = itr->second;
 		if(uniform->type == GL_FLOAT_VEC3)
 		{
-			((GLfloat*) uniform->data)[0] = color.getR() / 255.0f;
-			((GLfloat*) uniform->data)[1] = color.getG() / 255.0f;
-			((GLfloat*) uniform->data)[2] = color.getB() / 255.0f;
+			const GLfloat values[] = { color.getR() / 255.0f, color.getG() / 255.0f, color.getB() / 255.0f };
+			setUniformData(uniform, values, sizeof(values));
 		}
 		else
 		{
@@ -726,6 +728,21 @@ void OpenGLShader::setUniformColorRGB(const string &name, const ColorRGB &color)
 	}
 }
 
+void OpenGLShader::setUniformData(Uniform *uniform, const void *data, const size_t size)
+{
+	if(memcmp(uniform->data, data, size) == 0) return;
+
+	// Batched shapes must be drawn with the old value
+	flushPrimitives();
+
+	memcpy(uniform->data, data, size);
+	if(!uniform->dirty)
+	{
+		uniform->dirty = true;
+		m_dirtyUniforms.push_back(uniform);
+	}
+}
+
 void OpenGLShader::exportAssembly(const string & fileName)
 {
 	if(!glGetProgramBinary)
@@ -138,6 +138,7 @@ OpenGLTexture2D::OpenGLTexture2D(const Pixmap &pixmap)
 OpenGLTexture2D::~OpenGLTexture2D()
 {
 	glDeleteTextures(1, &m_id);
+	OpenGLContext::unbindTexture(m_id);
 }
 
 void OpenGLTexture2D::initialize(const Pixmap &pixmap)
@@ -159,9 +160,8 @@ Pixmap OpenGLTexture2D::getPixmap() const
 {
 	// Get texture data
 	uchar *data = new uchar[m_width * m_height * m_pixelFormat.getPixelSizeInBytes()];
-	glBindTexture(GL_TEXTURE_2D, m_id);
+	OpenGLContext::bindTexture(m_id);
 	glGetTexImage(GL_TEXTURE_2D, 0, toFormat(m_pixelFormat.getComponents(), m_pixelFormat.getDataType()), toGLDataType(m_pixelFormat.getDataType()), (GLvoid*) data);
-	glBindTexture(GL_TEXTURE_2D, 0);
 
 	// Copy data to pixmap
 	Pixmap pixmap(m_width, m_height, data, m_pixelFormat);
@@ -171,20 +171,21 @@ Pixmap OpenGLTexture2D::getPixmap() const
 
 void OpenGLTexture2D::updatePixmap(const Pixmap &pixmap)
 {
+	flushPrimitives();
+	m_version++;
+
 	// Store dimensions
 	m_width = pixmap.getWidth();
 	m_height = pixmap.getHeight();
 
 	// Set default filtering
-	glBindTexture(GL_TEXTURE_2D, m_id);
+	OpenGLContext::bindTexture(m_id);
 	//glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixmap.getData());
 	glTexImage2D(GL_TEXTURE_2D, 0, toInternalFormat(pixmap.getFormat().getComponents(), pixmap.getFormat().getDataType()), (GLsizei) m_width, (GLsizei) m_height, 0, toFormat(pixmap.getFormat().getComponents(), pixmap.getFormat().getDataType()), toGLDataType(pixmap.getFormat().getDataType()), (const GLvoid*) pixmap.getData());
-	glBindTexture(GL_TEXTURE_2D, 0);
 
 	// Regenerate mipmaps
 	m_mipmapsGenerated = false;
 
-	// NOTE: There is a litte redundancy with the glBindTexture() calls.
 	// Use default filtering options
 	updateFiltering();
 }
@@ -197,24 +198,26 @@ void OpenGLTexture2D::updatePixmap(const uint x, const uint y, const Pixmap &pix
 		return;
 	}
 
+	flushPrimitives();
+	m_version++;
+
 	// Set default filtering
-	glBindTexture(GL_TEXTURE_2D, m_id);
+	OpenGLContext::bindTexture(m_id);
 	glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint) x, (GLint) y, (GLsizei) pixmap.getWidth(), (GLsizei) pixmap.getHeight(), toFormat(pixmap.getFormat().getComponents(), pixmap.getFormat().getDataType()), toGLDataType(pixmap.getFormat().getDataType()), (const GLvoid*) pixmap.getData());
-	glBindTexture(GL_TEXTURE_2D, 0);
 
 	// Regenerate mipmaps
 	m_mipmapsGenerated = false;
 
-	// NOTE: There is a litte redunacny with the glBindTexture() calls.
 	// Use default filtering options
 	updateFiltering();
 }
 
 void OpenGLTexture2D::clear()
 {
-	glBindTexture(GL_TEXTURE_2D, m_id);
+	flushPrimitives();
+	m_version++;
+	OpenGLContext::bindTexture(m_id);
 	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_BGRA, GL_UNSIGNED_BYTE, vector<GLubyte>(m_width*m_height * 4, 0).data());
-	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void OpenGLTexture2D::updateFiltering()
@@ -224,12 +227,11 @@ void OpenGLTexture2D::updateFiltering()
 		glGenerateMipmap(GL_TEXTURE_2D);
 		m_mipmapsGenerated = true;
 	}
-	glBindTexture(GL_TEXTURE_2D, m_id);
+	OpenGLContext::bindTexture(m_id);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, m_mipmaps ? (m_filter == GL_NEAREST ? GL_NEAREST_MIPMAP_LINEAR : GL_LINEAR_MIPMAP_LINEAR) : m_filter);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, m_filter);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, m_wrapping);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, m_wrapping);
-	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 END_SAUCE_NAMESPACE
@@ -29,6 +29,7 @@ RenderTarget2D::RenderTarget2D(GraphicsContext *graphicsContext, const uint widt
 	for(uint i = 0; i < m_textureCount; ++i)
 	{
 		m_textures[i] = shared_ptr<Texture2D>(graphicsContext->createTexture(width, height, 0, fmt));
+		m_textures[i]->m_renderTarget = true;
 	}
 }
 
@@ -39,6 +40,10 @@ RenderTarget2D::RenderTarget2D(GraphicsContext *graphicsContext, shared_ptr<Text
 {
 	// Set texture variables
 	(m_textures = new shared_ptr<Texture2D>[1])[0] = target;
+
+	// Anything that copied the pixels of the texture has to copy them again
+	target->m_renderTarget = true;
+	target->m_version++;
 }
 
 RenderTarget2D::~RenderTarget2D()
@@ -14,7 +14,8 @@
 
 BEGIN_SAUCE_NAMESPACE
 
-Shader::Shader()
+Shader::Shader() :
+	m_batchingContext(nullptr)
 {
 }
 
@@ -22,6 +23,14 @@ Shader::~Shader()
 {
 }
 
+void Shader::flushPrimitives()
+{
+	if(m_batchingContext)
+	{
+		m_batchingContext->flushPrimitives();
+	}
+}
+
 void *ShaderResourceDesc::create() const
 {
 	GraphicsContext *graphicsContext = Game::Get()->getWindow()->getGraphicsContext();
@@ -12,10 +12,46 @@
 #include <Sauce/Common.h>
 #include <Sauce/graphics.h>
 
+#if defined(SAUCE_USE_SSE)
+	#include <xmmintrin.h>
+#elif defined(SAUCE_USE_NEON)
+	#include <arm_neon.h>
+#endif
+
 BEGIN_SAUCE_NAMESPACE
 
+const float DEG2RAD = 3.141593f / 180;
+
+// Transforms the 4 corners of the unit quad by the 2x3 affine transform {a, b, tx, c, d, ty}.
+// Writes the corners as interleaved x, y pairs in QUAD_VERTICES order.
+static inline void transformQuad(const float *t, float *xy)
+{
+#if defined(SAUCE_USE_SSE)
+	const __m128 qx = _mm_setr_ps(0.0f, 1.0f, 0.0f, 1.0f);
+	const __m128 qy = _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+	const __m128 x = _mm_add_ps(_mm_set1_ps(t[2]), _mm_add_ps(_mm_mul_ps(qx, _mm_set1_ps(t[0])), _mm_mul_ps(qy, _mm_set1_ps(t[1]))));
+	const __m128 y = _mm_add_ps(_mm_set1_ps(t[5]), _mm_add_ps(_mm_mul_ps(qx, _mm_set1_ps(t[3])), _mm_mul_ps(qy, _mm_set1_ps(t[4]))));
+	_mm_storeu_ps(xy, _mm_unpacklo_ps(x, y));
+	_mm_storeu_ps(xy + 4, _mm_unpackhi_ps(x, y));
+#elif defined(SAUCE_USE_NEON)
+	const float qxData[4] = { 0.0f, 1.0f, 0.0f, 1.0f };
+	const float qyData[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+	const float32x4_t qx = vld1q_f32(qxData);
+	const float32x4_t qy = vld1q_f32(qyData);
+	float32x4x2_t corners;
+	corners.val[0] = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[2]), qx, t[0]), qy, t[1]);
+	corners.val[1] = vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(t[5]), qx, t[3]), qy, t[4]);
+	vst2q_f32(xy, corners);
+#else
+	xy[0] = t[2];               xy[1] = t[5];
+	xy[2] = t[2] + t[0];        xy[3] = t[5] + t[3];
+	xy[4] = t[2] + t[1];        xy[5] = t[5] + t[4];
+	xy[6] = t[2] + t[0] + t[1]; xy[7] = t[5] + t[3] + t[4];
+#endif
+}
+
 Sprite::Sprite(shared_ptr<Texture2D> texture, const Rect<float> &rectangle, const Vector2F &origin, const float angle, const TextureRegion &region, const Color &color, const float depth, const Vector2F scale) :
-	m_texture(texture),
+	m_texture(TextureRegistry::add(texture)),
 	m_textureRegion(region),
 	m_position(rectangle.position),
 	m_size(rectangle.size),
@@ -27,10 +63,6 @@ Sprite::Sprite(shared_ptr<Texture2D> texture, const Rect<float> &rectangle, cons
 {
 }
 
-Sprite::~Sprite()
-{
-}
-
 void Sprite::setPosition(const Vector2F &pos)
 {
 	m_position = pos;
@@ -86,9 +118,10 @@ void Sprite::setRegion(const TextureRegion &textureRegion, const bool resize)
 	m_textureRegion = textureRegion;
 	if(resize)
 	{
-		m_size = m_texture != 0 ? Vector2I(
-			int(m_texture->getWidth()*m_textureRegion.uv1.x - m_texture->getWidth()*m_textureRegion.uv0.x),
-			int(m_texture->getHeight()*m_textureRegion.uv1.y - m_texture->getHeight()*m_textureRegion.uv0.y)
+		const Texture2D *texture = TextureRegistry::get(m_texture);
+		m_size = texture != 0 ? Vector2I(
+			int(texture->getWidth()*m_textureRegion.uv1.x - texture->getWidth()*m_textureRegion.uv0.x),
+			int(texture->getHeight()*m_textureRegion.uv1.y - texture->getHeight()*m_textureRegion.uv0.y)
 			) : Vector2I(0);
 	}
 }
@@ -125,16 +158,12 @@ void Sprite::scale(const float scl)
 
 void Sprite::getAABB(Vector2F *points) const
 {
-	Matrix4 mat;
-	mat.scale(m_size.x, m_size.y, 1.0f);
-	mat.translate(-m_origin.x, -m_origin.y, 0.0f);
-	mat.scale(m_scale.x, m_scale.y, 1.0f);
-	mat.rotateZ(m_angle);
-	mat.translate(m_position.x, m_position.y, 0.0f);
-
+	float transform[6], xy[8];
+	getAffineTransform(transform);
+	transformQuad(transform, xy);
 	for(int i = 0; i < 4; i++)
 	{
-		points[i] = (mat * QUAD_VERTICES[i]).getXY();
+		points[i].set(xy[i * 2], xy[i * 2 + 1]);
 	}
 }
 
@@ -206,38 +235,67 @@ TextureRegion Sprite::getRegion() const
 	return m_textureRegion;
 }
 
+void Sprite::setTexture(shared_ptr<Texture2D> texture)
+{
+	m_texture = TextureRegistry::add(texture);
+}
+
 shared_ptr<Texture2D> Sprite::getTexture() const
 {
-	return m_texture;
+	return TextureRegistry::lock(m_texture);
 }
 
-void Sprite::getVertices(Vertex *vertices, uint *indices, const uint indexOffset) const
+void Sprite::getAffineTransform(float *transform) const
 {
-	Matrix4 mat;
-	mat.scale(m_size.x, m_size.y, 1.0f);
-	mat.translate(-m_origin.x, -m_origin.y, 0.0f);
-	mat.scale(m_scale.x, m_scale.y, 1.0f);
-	mat.rotateZ(m_angle);
-	mat.translate(m_position.x, m_position.y, 0.0f);
+	// Same as scaling the unit quad by the size, translating by -origin,
+	// scaling by the scale, rotating by the angle and translating by the position
+	float c = 1.0f, s = 0.0f;
+	if(m_angle != 0.0f)
+	{
+		c = cosf(m_angle * DEG2RAD);
+		s = sinf(m_angle * DEG2RAD);
+	}
+
+	const float w = m_size.x * m_scale.x, h = m_size.y * m_scale.y;
+	const float ox = m_origin.x * m_scale.x, oy = m_origin.y * m_scale.y;
+
+	transform[0] = c * w; transform[1] = -s * h; transform[2] = m_position.x - (c * ox - s * oy);
+	transform[3] = s * w; transform[4] =  c * h; transform[5] = m_position.y - (s * ox + c * oy);
+}
 
+void Sprite::getVertices(SpriteVertex *vertices) const
+{
+	float transform[6], xy[8];
+	getAffineTransform(transform);
+	transformQuad(transform, xy);
+
+	const uchar r = m_color.getR(), g = m_color.getG(), b = m_color.getB(), a = m_color.getA();
 	for(int i = 0; i < 4; i++)
 	{
-		Vector2F pos = (mat * QUAD_VERTICES[i]).getXY();
-		vertices[i].set2f(VERTEX_POSITION, pos.x, pos.y);
-		vertices[i].set4ub(VERTEX_COLOR, m_color.getR(), m_color.getG(), m_color.getB(), m_color.getA());
+		SpriteVertex &vertex = vertices[i];
+		vertex.x = xy[i * 2];
+		vertex.y = xy[i * 2 + 1];
+		vertex.r = r; vertex.g = g; vertex.b = b; vertex.a = a;
 	}
 
-	vertices[0].set2f(VERTEX_TEX_COORD, m_textureRegion.uv0.x, m_textureRegion.uv0.y);
-	vertices[1].set2f(VERTEX_TEX_COORD, m_textureRegion.uv1.x, m_textureRegion.uv0.y);
-	vertices[2].set2f(VERTEX_TEX_COORD, m_textureRegion.uv0.x, m_textureRegion.uv1.y);
-	vertices[3].set2f(VERTEX_TEX_COORD, m_textureRegion.uv1.x, m_textureRegion.uv1.y);
-	
-	indices[0] = indexOffset + QUAD_INDICES[0];
-	indices[1] = indexOffset + QUAD_INDICES[1];
-	indices[2] = indexOffset + QUAD_INDICES[2];
-	indices[3] = indexOffset + QUAD_INDICES[3];
-	indices[4] = indexOffset + QUAD_INDICES[4];
-	indices[5] = indexOffset + QUAD_INDICES[5];
+	vertices[0].u = m_textureRegion.uv0.x; vertices[0].v = m_textureRegion.uv0.y;
+	vertices[1].u = m_textureRegion.uv1.x; vertices[1].v = m_textureRegion.uv0.y;
+	vertices[2].u = m_textureRegion.uv0.x; vertices[2].v = m_textureRegion.uv1.y;
+	vertices[3].u = m_textureRegion.uv1.x; vertices[3].v = m_textureRegion.uv1.y;
+}
+
+void Sprite::getInstance(SpriteInstance *instance) const
+{
+	getAffineTransform(instance->transform);
+	instance->uv[0] = m_textureRegion.uv0.x;
+	instance->uv[1] = m_textureRegion.uv0.y;
+	instance->uv[2] = m_textureRegion.uv1.x;
+	instance->uv[3] = m_textureRegion.uv1.y;
+	instance->color[0] = m_color.getR();
+	instance->color[1] = m_color.getG();
+	instance->color[2] = m_color.getB();
+	instance->color[3] = m_color.getA();
+	instance->z = 0.0f;
 }
 
 END_SAUCE_NAMESPACE
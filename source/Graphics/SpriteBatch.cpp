@@ -12,22 +12,208 @@
 #include <Sauce/Common.h>
 #include <Sauce/graphics.h>
 
+#if defined(SAUCE_USE_SSE)
+	#include <xmmintrin.h>
+#elif defined(SAUCE_USE_NEON)
+	#include <arm_neon.h>
+#endif
+
 BEGIN_SAUCE_NAMESPACE
 
-SpriteBatch::SpriteBatch(const uint maxSprites) :
+// Sort key layout
+const uint SORT_KEY_INDEX_BITS = 20;
+const uint SORT_KEY_TEXTURE_BITS = 12;
+const Uint64 SORT_KEY_INDEX_MASK = (Uint64(1) << SORT_KEY_INDEX_BITS) - 1;
+const uint SORT_KEY_MAX_SPRITES = 1 << SORT_KEY_INDEX_BITS;
+const uint SORT_KEY_MAX_TEXTURES = 1 << SORT_KEY_TEXTURE_BITS;
+
+// Maps a float to an unsigned integer with the same ordering
+static inline Uint32 depthToSortBits(const float depth)
+{
+	if(depth == 0.0f) return 0x80000000; // -0.0f and 0.0f are the same depth
+	Uint32 bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+}
+
+// Sprites are stored in chunks of 2^SPRITE_CHUNK_BITS sprites
+const uint SPRITE_CHUNK_BITS = 10;
+const uint SPRITE_CHUNK_SIZE = 1 << SPRITE_CHUNK_BITS;
+
+// Returns the depth buffer z of the depthIndex-th depth (front first) out of depthCount.
+// z is in (-1, 1) and a larger z is in front
+static inline float getDepthZ(const uint depthIndex, const uint depthCount)
+{
+	return 1.0f - 2.0f * (depthIndex + 1) / (depthCount + 1);
+}
+
+// Tests if the square [x - r, x + r] x [y - r, y + r] overlaps the culling bounds.
+// The bounds are stored as { maxX, maxY, -minX, -minY } so all four sides are one less-than test
+static inline bool isInsideCullBounds(const float *bounds, const float x, const float y, const float r)
+{
+#if defined(SAUCE_USE_SSE)
+	const __m128 sides = _mm_sub_ps(_mm_setr_ps(x, y, -x, -y), _mm_set1_ps(r));
+	return _mm_movemask_ps(_mm_cmplt_ps(sides, _mm_loadu_ps(bounds))) == 0xF;
+#elif defined(SAUCE_USE_NEON)
+	const float sidesData[4] = { x, y, -x, -y };
+	const uint32x4_t inside = vcltq_f32(vsubq_f32(vld1q_f32(sidesData), vdupq_n_f32(r)), vld1q_f32(bounds));
+	const uint32x2_t inside2 = vand_u32(vget_low_u32(inside), vget_high_u32(inside));
+	return (vget_lane_u32(inside2, 0) & vget_lane_u32(inside2, 1)) != 0;
+#else
+	return x - r < bounds[0] && y - r < bounds[1] && -x - r < bounds[2] && -y - r < bounds[3];
+#endif
+}
+
+// Returns true if the glyph may be inside the cull bounds. Every corner is within
+// the L1 distance of half the width plus half the height of the center
+static inline bool isInsideCullBounds(const float *bounds, const GlyphQuad &glyph)
+{
+	return isInsideCullBounds(bounds, (glyph.x0 + glyph.x1) * 0.5f, (glyph.y0 + glyph.y1) * 0.5f, (fabs(glyph.x1 - glyph.x0) + fabs(glyph.y1 - glyph.y0)) * 0.5f);
+}
+
+// Writes the 4 vertices of an axis-aligned glyph quad in QUAD_VERTICES order
+static inline void getGlyphVertices(const GlyphQuad &glyph, const Color &color, SpriteVertex *vertices)
+{
+	vertices[0].x = glyph.x0; vertices[0].y = glyph.y0; vertices[0].u = glyph.u0; vertices[0].v = glyph.v0;
+	vertices[1].x = glyph.x1; vertices[1].y = glyph.y0; vertices[1].u = glyph.u1; vertices[1].v = glyph.v0;
+	vertices[2].x = glyph.x0; vertices[2].y = glyph.y1; vertices[2].u = glyph.u0; vertices[2].v = glyph.v1;
+	vertices[3].x = glyph.x1; vertices[3].y = glyph.y1; vertices[3].u = glyph.u1; vertices[3].v = glyph.v1;
+	for(int i = 0; i < 4; i++)
+	{
+		vertices[i].r = color.getR(); vertices[i].g = color.getG(); vertices[i].b = color.getB(); vertices[i].a = color.getA();
+	}
+}
+
+// Number of sprites a worker generates vertices for at a time
+const uint WORKER_GRAIN_SIZE = 1024;
+
+// Max number of texture batches searched when placing a sprite in TEXTURE mode
+const uint TEXTURE_BATCH_SEARCH_LIMIT = 32;
+
+TextureSlotTable::TextureSlotTable(const uint slotCount) :
+	m_slotCount(max(slotCount, 1u)),
+	m_lastSlot(0)
+{
+}
+
+void TextureSlotTable::setSlotCount(const uint slotCount)
+{
+	m_slotCount = max(slotCount, 1u);
+	clear();
+}
+
+int TextureSlotTable::getSlot(const TextureHandle texture)
+{
+	// Sprites tend to come in runs of the same texture
+	if(m_lastSlot < m_textures.size() && m_textures[m_lastSlot] == texture)
+	{
+		return m_lastSlot;
+	}
+
+	for(uint i = 0; i < m_textures.size(); ++i)
+	{
+		if(m_textures[i] == texture)
+		{
+			m_lastSlot = i;
+			return i;
+		}
+	}
+
+	// Add the texture if there is room for it
+	if(m_textures.size() >= m_slotCount)
+	{
+		return -1;
+	}
+	m_textures.push_back(texture);
+	m_lastSlot = m_textures.size() - 1;
+	return m_lastSlot;
+}
+
+void TextureSlotTable::clear()
+{
+	m_textures.clear();
+	m_lastSlot = 0;
+}
+
+SpriteBatch::SpriteBatch(const uint initialCapacity) :
+	m_spriteCount(0),
+	m_maxSpriteCount(0),
 	m_graphicsContext(nullptr),
-	m_maxSpriteCount(maxSprites)
+	m_vertices(nullptr),
+	m_vertexCapacity(0),
+	m_vertexBuffer(nullptr),
+	m_slotVertices(nullptr),
+	m_slotVertexCapacity(0),
+	m_textureSlotCount(1),
+	m_instances(nullptr),
+	m_instanceCapacity(0),
+	m_instancingEnabled(false),
+	m_sortKeys(nullptr),
+	m_sortKeyCapacity(0),
+	m_prevTexture(nullptr),
+	m_prevTextureId(0),
+	m_workerPool(nullptr),
+	m_stats(),
+	m_boundTexture(nullptr),
+	m_cullingEnabled(false),
+	m_autoAtlas(nullptr)
 {
-	m_sprites = new Sprite[maxSprites];
-	m_vertices = new Vertex[maxSprites * 4];
-	m_indices = new uint[maxSprites * 6];
+	setMaxSpriteCount(SAUCE_SPRITE_BATCH_MAX_SPRITES);
+
+	// Allocate initial storage
+	while(getCapacity() < min(max(initialCapacity, 1u), SORT_KEY_MAX_SPRITES))
+	{
+		addSpriteChunk();
+	}
+	m_vertexCapacity = getCapacity();
+	m_vertices = new SpriteVertex[m_vertexCapacity * 4];
 }
 
 SpriteBatch::~SpriteBatch()
 {
-	delete[] m_sprites;
+	for(uint i = 0; i < m_spriteChunks.size(); ++i)
+	{
+		delete[] m_spriteChunks[i];
+	}
 	delete[] m_vertices;
-	delete[] m_indices;
+	delete m_vertexBuffer;
+	delete[] m_slotVertices;
+	delete[] m_instances;
+	delete[] m_sortKeys;
+}
+
+void SpriteBatch::setMaxSpriteCount(const uint maxSprites)
+{
+	// The sort keys can address at most SORT_KEY_MAX_SPRITES sprites
+	m_maxSpriteCount = maxSprites == 0 ? SORT_KEY_MAX_SPRITES : min(maxSprites, SORT_KEY_MAX_SPRITES);
+}
+
+uint SpriteBatch::getCapacity() const
+{
+	return m_spriteChunks.size() * SPRITE_CHUNK_SIZE;
+}
+
+void SpriteBatch::addSpriteChunk()
+{
+	m_spriteChunks.push_back(new Sprite[SPRITE_CHUNK_SIZE]);
+
+	// Grow sort keys geometrically, so they are not copied for every chunk
+	if(m_sortKeyCapacity < getCapacity())
+	{
+		m_sortKeyCapacity = min(max(getCapacity(), m_sortKeyCapacity * 2), SORT_KEY_MAX_SPRITES);
+		Uint64 *sortKeys = new Uint64[m_sortKeyCapacity];
+		if(m_sortKeys)
+		{
+			memcpy(sortKeys, m_sortKeys, m_spriteCount * sizeof(Uint64));
+			delete[] m_sortKeys;
+		}
+		m_sortKeys = sortKeys;
+	}
+}
+
+inline Sprite &SpriteBatch::getSprite(const uint index) const
+{
+	return m_spriteChunks[index >> SPRITE_CHUNK_BITS][index & (SPRITE_CHUNK_SIZE - 1)];
 }
 
 void SpriteBatch::begin(GraphicsContext *graphicsContext, const State &state)
@@ -41,6 +227,28 @@ void SpriteBatch::begin(GraphicsContext *graphicsContext, const State &state)
 	m_spriteCount = 0;
 	m_state = state;
 	m_graphicsContext = graphicsContext;
+	m_textureIds.clear();
+	m_prevTexture = nullptr;
+	m_textureBatches.clear();
+	m_stats = Stats();
+	m_boundTexture = nullptr;
+
+	if(m_cullingEnabled)
+	{
+		updateCullBounds();
+	}
+
+	if(m_autoAtlas)
+	{
+		m_autoAtlas->update();
+	}
+
+	// Sprites are drawn as they come in IMMEDIATE mode, so apply the state now
+	if(m_state.mode == IMMEDIATE)
+	{
+		m_graphicsContext->pushState();
+		applyState();
+	}
 }
 
 void SpriteBatch::drawSprite(const Sprite &sprite)
@@ -51,19 +259,258 @@ void SpriteBatch::drawSprite(const Sprite &sprite)
 		return;
 	}
 
-	if(!sprite.getTexture())
+	const Texture2D *texture = TextureRegistry::get(sprite.m_texture);
+	if(!texture)
 	{
 		LOG("SpriteBatch::drawSprite(): Sprite needs a texture.");
 		return;
 	}
 
-	if(m_spriteCount >= m_maxSpriteCount)
+	if(m_cullingEnabled)
+	{
+		// Every corner is within the L1 distance |dx| + |dy| of the position, no matter the angle
+		const float left = -sprite.m_origin.x * sprite.m_scale.x, right = (sprite.m_size.x - sprite.m_origin.x) * sprite.m_scale.x;
+		const float top = -sprite.m_origin.y * sprite.m_scale.y, bottom = (sprite.m_size.y - sprite.m_origin.y) * sprite.m_scale.y;
+		const float radius = max(fabs(left), fabs(right)) + max(fabs(top), fabs(bottom));
+		if(!isInsideCullBounds(m_cullBounds, sprite.m_position.x, sprite.m_position.y, radius))
+		{
+			m_stats.culledSpriteCount++;
+			return;
+		}
+	}
+
+	if(m_state.mode == IMMEDIATE)
+	{
+		sprite.getVertices(m_vertices);
+		setTexture(TextureRegistry::lock(sprite.m_texture));
+		m_graphicsContext->drawIndexedPrimitives(GraphicsContext::PRIMITIVE_TRIANGLES, VertexPCT::getFormat(), m_vertices, 4, QUAD_INDICES, 6);
+		m_stats.drawCallCount++;
+		m_stats.spriteCount++;
+		m_stats.vertexCount += 4;
+		m_stats.indexCount += 6;
+		m_stats.bytesUploaded += 4 * sizeof(SpriteVertex) + 6 * sizeof(uint);
+		return;
+	}
+
+	// Flush before looking the sprite up in the atlas, as flushing updates the atlas
+	reserveSprite();
+
+	// Draw small textures from the atlas
+	TextureHandle textureHandle = sprite.m_texture;
+	TextureRegion atlasRegion;
+	if(m_autoAtlas)
+	{
+		const TextureHandle atlasTexture = m_autoAtlas->find(sprite.m_texture, sprite.m_textureRegion, atlasRegion);
+		if(atlasTexture.isValid())
+		{
+			textureHandle = atlasTexture;
+			texture = TextureRegistry::get(atlasTexture);
+		}
+	}
+
+	const Uint64 key = getSortKey(sprite, texture);
+	m_sortKeys[m_spriteCount] = key | m_spriteCount;
+	Sprite &batchSprite = getSprite(m_spriteCount++);
+	batchSprite = sprite;
+	if(textureHandle != sprite.m_texture)
+	{
+		batchSprite.m_texture = textureHandle;
+		batchSprite.m_textureRegion = atlasRegion;
+	}
+}
+
+void SpriteBatch::drawGlyphRun(const TextureHandle textureHandle, const GlyphQuad *glyphs, const uint glyphCount, const Color &color, const float depth)
+{
+	if(!m_graphicsContext)
 	{
-		LOG("SpriteBatch::drawSprite(): No more sprites can fit!");
+		LOG("SpriteBatch::drawGlyphRun(): Called before begin()");
 		return;
 	}
 
-	m_sprites[m_spriteCount++] = sprite;
+	const Texture2D *texture = TextureRegistry::get(textureHandle);
+	if(!texture)
+	{
+		LOG("SpriteBatch::drawGlyphRun(): Glyph run needs a texture.");
+		return;
+	}
+
+	if(m_state.mode == IMMEDIATE)
+	{
+		// Draw the glyphs straight from the vertex array, as many at a time as it holds
+		if(!m_vertexBuffer)
+		{
+			m_vertexBuffer = new DynamicVertexBuffer(m_graphicsContext);
+		}
+		setTexture(TextureRegistry::lock(textureHandle));
+		for(uint runStart = 0; runStart < glyphCount; runStart += m_vertexCapacity)
+		{
+			const uint count = min(glyphCount - runStart, m_vertexCapacity);
+			uint quadCount = 0;
+			for(uint i = runStart; i < runStart + count; ++i)
+			{
+				const GlyphQuad &glyph = glyphs[i];
+				if(m_cullingEnabled && !isInsideCullBounds(m_cullBounds, glyph))
+				{
+					m_stats.culledSpriteCount++;
+					continue;
+				}
+				getGlyphVertices(glyph, color, m_vertices + quadCount++ * 4);
+			}
+			if(quadCount == 0) continue;
+
+			m_vertexBuffer->setData(VertexPCT::getFormat(), m_vertices, quadCount * 4);
+			m_graphicsContext->drawIndexedPrimitives(GraphicsContext::PRIMITIVE_TRIANGLES, m_vertexBuffer, m_graphicsContext->getQuadIndexBuffer(quadCount), 0, quadCount * 6);
+			m_stats.drawCallCount++;
+			m_stats.spriteCount += quadCount;
+			m_stats.vertexCount += quadCount * 4;
+			m_stats.indexCount += quadCount * 6;
+			m_stats.bytesUploaded += quadCount * 4 * sizeof(SpriteVertex);
+		}
+		return;
+	}
+
+	// Every glyph is a sprite with the same texture, color and depth. The sort key is
+	// computed once for the run, with the bounds of the whole run in TEXTURE mode
+	Sprite glyphSprite;
+	glyphSprite.m_texture = textureHandle;
+	glyphSprite.m_color = color;
+	glyphSprite.m_depth = depth;
+
+	Sprite runSprite = glyphSprite;
+	if(m_state.mode == TEXTURE && glyphCount > 0)
+	{
+		Vector2F runMin(glyphs[0].x0, glyphs[0].y0), runMax(glyphs[0].x1, glyphs[0].y1);
+		for(uint i = 1; i < glyphCount; ++i)
+		{
+			runMin.x = min(runMin.x, min(glyphs[i].x0, glyphs[i].x1)); runMin.y = min(runMin.y, min(glyphs[i].y0, glyphs[i].y1));
+			runMax.x = max(runMax.x, max(glyphs[i].x0, glyphs[i].x1)); runMax.y = max(runMax.y, max(glyphs[i].y0, glyphs[i].y1));
+		}
+		runSprite.m_position = runMin;
+		runSprite.m_size = runMax - runMin;
+	}
+
+	Uint64 key = 0;
+	bool hasKey = false;
+	for(uint i = 0; i < glyphCount; ++i)
+	{
+		const GlyphQuad &glyph = glyphs[i];
+		if(m_cullingEnabled && !isInsideCullBounds(m_cullBounds, glyph))
+		{
+			m_stats.culledSpriteCount++;
+			continue;
+		}
+
+		// The key is invalid after a flush
+		if(reserveSprite())
+		{
+			hasKey = false;
+		}
+
+		if(!hasKey)
+		{
+			key = getSortKey(runSprite, texture);
+			hasKey = true;
+		}
+
+		m_sortKeys[m_spriteCount] = key | m_spriteCount;
+		Sprite &batchSprite = getSprite(m_spriteCount++);
+		batchSprite = glyphSprite;
+		batchSprite.m_position.set(glyph.x0, glyph.y0);
+		batchSprite.m_size.set(glyph.x1 - glyph.x0, glyph.y1 - glyph.y0);
+		batchSprite.m_textureRegion.setRegion(glyph.u0, glyph.v0, glyph.u1, glyph.v1);
+	}
+}
+
+bool SpriteBatch::reserveSprite()
+{
+	// Draw what we have if the batch is full, or if a new texture wouldn't get a texture id.
+	// getSortKey() can then never flush between computing the key and storing the sprite
+	bool flushed = false;
+	if(m_spriteCount >= m_maxSpriteCount || m_textureIds.size() >= SORT_KEY_MAX_TEXTURES)
+	{
+		flush();
+		flushed = true;
+	}
+
+	if(m_spriteCount >= getCapacity())
+	{
+		addSpriteChunk();
+	}
+	return flushed;
+}
+
+Uint64 SpriteBatch::getSortKey(const Sprite &sprite, const Texture2D *texture)
+{
+	if(m_state.mode == TEXTURE)
+	{
+		return Uint64(getTextureBatch(sprite, texture)) << SORT_KEY_INDEX_BITS;
+	}
+
+	if(m_state.mode == BACK_TO_FRONT)
+	{
+		return Uint64(depthToSortBits(sprite.m_depth)) << 32;
+	}
+
+	// Get texture id. Sprites tend to come in runs of the same texture
+	if(texture != m_prevTexture)
+	{
+		unordered_map<const Texture2D*, uint>::iterator itr = m_textureIds.find(texture);
+		if(itr == m_textureIds.end())
+		{
+			// There is always a free id, as reserveSprite() flushes when they run out
+			itr = m_textureIds.insert(make_pair(texture, uint(m_textureIds.size()))).first;
+		}
+		m_prevTexture = texture;
+		m_prevTextureId = itr->second;
+	}
+
+	Uint32 depthBits = depthToSortBits(sprite.m_depth);
+	if(m_state.mode == FRONT_TO_BACK)
+	{
+		depthBits = ~depthBits;
+	}
+	return (Uint64(depthBits) << 32) | (Uint64(m_prevTextureId) << SORT_KEY_INDEX_BITS);
+}
+
+uint SpriteBatch::getTextureBatch(const Sprite &sprite, const Texture2D *texture)
+{
+	// Get sprite bounds
+	Vector2F points[4];
+	sprite.getAABB(points);
+	Vector2F spriteMin = points[0], spriteMax = points[0];
+	for(int i = 1; i < 4; i++)
+	{
+		spriteMin.x = min(spriteMin.x, points[i].x); spriteMin.y = min(spriteMin.y, points[i].y);
+		spriteMax.x = max(spriteMax.x, points[i].x); spriteMax.y = max(spriteMax.y, points[i].y);
+	}
+
+	// Search backwards for a batch with the same texture. We can only join it if
+	// no batch drawn after it overlaps the sprite, as that would change the result
+	const uint searchEnd = m_textureBatches.size() > TEXTURE_BATCH_SEARCH_LIMIT ? m_textureBatches.size() - TEXTURE_BATCH_SEARCH_LIMIT : 0;
+	for(uint i = m_textureBatches.size(); i-- > searchEnd;)
+	{
+		TextureBatch &batch = m_textureBatches[i];
+		if(batch.texture == texture)
+		{
+			batch.min.x = min(batch.min.x, spriteMin.x); batch.min.y = min(batch.min.y, spriteMin.y);
+			batch.max.x = max(batch.max.x, spriteMax.x); batch.max.y = max(batch.max.y, spriteMax.y);
+			return i;
+		}
+
+		if(batch.min.x < spriteMax.x && spriteMin.x < batch.max.x &&
+		   batch.min.y < spriteMax.y && spriteMin.y < batch.max.y)
+		{
+			break;
+		}
+	}
+
+	// Start a new batch
+	TextureBatch batch;
+	batch.texture = texture;
+	batch.min = spriteMin;
+	batch.max = spriteMax;
+	m_textureBatches.push_back(batch);
+	return m_textureBatches.size() - 1;
 }
 
 void SpriteBatch::drawText(const Vector2F &pos, const string &text, Font *font)
@@ -87,85 +534,344 @@ void SpriteBatch::end()
 		return;
 	}
 
-	m_graphicsContext->pushState();
-	
-	// Draw sprites
-	if(m_spriteCount > 0)
+	if(m_state.mode == IMMEDIATE)
+	{
+		// State was pushed in begin()
+		m_graphicsContext->popState();
+	}
+	else if(m_spriteCount > 0)
+	{
+		// Sprites are not drawn until end() is called. end() will apply graphics
+		// device settings and draw all the sprites in as few batches as possible.
+		// This mode allows draw*() calls to two or more instances of SpriteBatch
+		// without introducing conflicting graphics device settings.
+		m_graphicsContext->pushState();
+		applyState();
+		drawSortedSprites();
+		m_graphicsContext->popState();
+	}
+
+	m_graphicsContext = nullptr;
+}
+
+void SpriteBatch::updateCullBounds()
+{
+	// Transform the viewport corners back to sprite space
+	Matrix4 inverse = m_state.transformationMatix;
+	inverse.invert();
+	const float width = float(m_graphicsContext->getWidth()), height = float(m_graphicsContext->getHeight());
+	const float corners[4][2] = { { 0.0f, 0.0f }, { width, 0.0f }, { 0.0f, height }, { width, height } };
+	Vector2F cullMin, cullMax;
+	for(int i = 0; i < 4; i++)
+	{
+		Vector4F corner = inverse * Vector4F(corners[i][0], corners[i][1], 0.0f, 1.0f);
+		if(corner.w != 0.0f) corner /= corner.w;
+		if(i == 0 || corner.x < cullMin.x) cullMin.x = corner.x;
+		if(i == 0 || corner.y < cullMin.y) cullMin.y = corner.y;
+		if(i == 0 || corner.x > cullMax.x) cullMax.x = corner.x;
+		if(i == 0 || corner.y > cullMax.y) cullMax.y = corner.y;
+	}
+
+	m_cullBounds[0] = cullMax.x;
+	m_cullBounds[1] = cullMax.y;
+	m_cullBounds[2] = -cullMin.x;
+	m_cullBounds[3] = -cullMin.y;
+}
+
+void SpriteBatch::applyState()
+{
+	m_graphicsContext->clearMatrixStack();
+	m_graphicsContext->pushMatrix(m_state.transformationMatix);
+	m_graphicsContext->setBlendState(m_state.blendState);
+	m_graphicsContext->setShader(m_state.shader);
+}
+
+void SpriteBatch::drawSortedSprites()
+{
+	// Use the instanced path if it is enabled and can be used
+	const bool instanced = m_instancingEnabled && !m_state.shader && m_graphicsContext->isInstancingSupported();
+
+	// Otherwise, bind several textures per draw call if we can
+	const uint textureSlotCount = instanced || m_state.shader ? 1 : max(min(m_textureSlotCount, m_graphicsContext->getTextureSlotCount()), 1u);
+	const bool multiTexture = textureSlotCount > 1;
+
+	// Make sure the vertex arrays can hold every sprite
+	if(instanced)
+	{
+		if(m_instanceCapacity < m_spriteCount)
+		{
+			delete[] m_instances;
+			m_instanceCapacity = getCapacity();
+			m_instances = new SpriteInstance[m_instanceCapacity];
+		}
+	}
+	else if(multiTexture)
 	{
-		switch(m_state.mode)
+		if(m_slotVertexCapacity < m_spriteCount)
 		{
-			case DEFERRED:
+			delete[] m_slotVertices;
+			m_slotVertexCapacity = getCapacity();
+			m_slotVertices = new VertexPCTS[m_slotVertexCapacity * 4];
+		}
+		m_textureSlots.resize(m_spriteCount);
+	}
+	else if(m_vertexCapacity < m_spriteCount)
+	{
+		delete[] m_vertices;
+		m_vertexCapacity = getCapacity();
+		m_vertices = new SpriteVertex[m_vertexCapacity * 4];
+	}
+
+	Timer timer;
+	timer.start();
+	util::radixSort(m_sortKeys, m_spriteCount);
+	timer.stop();
+	m_stats.sortTime += timer.getElapsedTime() * 1000000.0;
+
+	// In FRONT_TO_BACK mode each depth gets its own z value so that
+	// the depth test can reject the fragments hidden by earlier sprites.
+	// The classic path sets z per draw call, the instanced path per sprite
+	const bool depthTest = m_state.mode == FRONT_TO_BACK;
+	uint depthCount = 1;
+	if(depthTest)
+	{
+		for(uint i = 1; i < m_spriteCount; ++i)
+		{
+			if((m_sortKeys[i] >> 32) != (m_sortKeys[i - 1] >> 32)) depthCount++;
+		}
+
+		if(instanced)
+		{
+			m_depthZ.resize(m_spriteCount);
+		}
+	}
+
+	// Find every run of sprites sharing a texture (and depth in the classic FRONT_TO_BACK path).
+	// With several texture slots, a run holds sprites of up to textureSlotCount textures
+	m_runStarts.clear();
+	m_runStarts.push_back(0);
+	m_runTextures.clear();
+	m_textureSlotTable.setSlotCount(textureSlotCount);
+	uint depthIndex = 0;
+	for(uint i = 0; i < m_spriteCount; ++i)
+	{
+		const bool depthChanged = i > 0 && (m_sortKeys[i] >> 32) != (m_sortKeys[i - 1] >> 32);
+		if(depthTest && depthChanged) depthIndex++;
+		if(depthTest && instanced) m_depthZ[i] = getDepthZ(depthIndex, depthCount);
+
+		const TextureHandle texture = getSprite(m_sortKeys[i] & SORT_KEY_INDEX_MASK).m_texture;
+		if(multiTexture)
+		{
+			int slot = m_textureSlotTable.getSlot(texture);
+			if(slot < 0 || (depthTest && depthChanged))
 			{
-				// Sprites are not drawn until end() is called. end() will apply graphics
-				// device settings and draw all the sprites in one batch, in the same
-				// order calls to draw*() were recieved. This mode allows draw*() calls
-				// to two or more instances of SpriteBatch without introducing conflicting
-				// graphics device settings. SpriteBatch defaults to DEFERRED mode.
-
-				m_graphicsContext->clearMatrixStack();
-				m_graphicsContext->pushMatrix(m_state.transformationMatix);
-				m_graphicsContext->setBlendState(m_state.blendState);
-				m_graphicsContext->setShader(m_state.shader);
-
-				// Separate sprites by depth and texture
-				map<float, map<shared_ptr<Texture2D>, list<Sprite*>>> layerTextureMap;
-				for(uint i = 0; i < m_spriteCount; ++i)
-				{
-					Sprite *sprite = &m_sprites[i];
-					layerTextureMap[sprite->m_depth][sprite->m_texture].push_back(sprite);
-				}
+				// Start a new run with an empty slot table
+				addRunTextures();
+				m_runStarts.push_back(i);
+				slot = m_textureSlotTable.getSlot(texture);
+			}
+			m_textureSlots[i] = uchar(slot);
+		}
+		else if(i > 0 && (texture != getSprite(m_sortKeys[i - 1] & SORT_KEY_INDEX_MASK).m_texture || (depthTest && !instanced && depthChanged)))
+		{
+			m_runStarts.push_back(i);
+		}
+	}
+	m_runStarts.push_back(m_spriteCount);
+	if(multiTexture)
+	{
+		addRunTextures();
+	}
 
-				// For each depth
-				for(map<float, map<shared_ptr<Texture2D>, list<Sprite*>>>::iterator itr1 = layerTextureMap.begin(); itr1 != layerTextureMap.end(); ++itr1)
+	// Generate vertex data. Every sprite writes to its own slots, so this can be split between workers
+	timer.start();
+	if(m_workerPool)
+	{
+		if(instanced) m_workerPool->parallelFor(m_spriteCount, WORKER_GRAIN_SIZE, [this](uint begin, uint end) { generateInstances(begin, end); });
+		else if(multiTexture) m_workerPool->parallelFor(m_spriteCount, WORKER_GRAIN_SIZE, [this](uint begin, uint end) { generateSlotVertices(begin, end); });
+		else m_workerPool->parallelFor(m_spriteCount, WORKER_GRAIN_SIZE, [this](uint begin, uint end) { generateVertices(begin, end); });
+	}
+	else
+	{
+		if(instanced) generateInstances(0, m_spriteCount);
+		else if(multiTexture) generateSlotVertices(0, m_spriteCount);
+		else generateVertices(0, m_spriteCount);
+	}
+	timer.stop();
+	m_stats.vertexGenerationTime += timer.getElapsedTime() * 1000000.0;
+
+	// Upload all vertices at once. Every run indexes into them with the shared quad index buffer
+	const IndexBuffer *quadIndexBuffer = nullptr;
+	if(!instanced)
+	{
+		if(!m_vertexBuffer)
+		{
+			m_vertexBuffer = new DynamicVertexBuffer(m_graphicsContext);
+		}
+		if(multiTexture)
+		{
+			m_vertexBuffer->setData(VertexPCTS::getFormat(), m_slotVertices, m_spriteCount * 4);
+			m_stats.bytesUploaded += m_spriteCount * 4 * sizeof(VertexPCTS);
+		}
+		else
+		{
+			m_vertexBuffer->setData(VertexPCT::getFormat(), m_vertices, m_spriteCount * 4);
+			m_stats.bytesUploaded += m_spriteCount * 4 * sizeof(SpriteVertex);
+		}
+		quadIndexBuffer = m_graphicsContext->getQuadIndexBuffer(m_spriteCount);
+	}
+
+	// The multi-texture shader samples the texture in the slot given by each vertex
+	shared_ptr<Shader> multiTextureShader;
+	if(multiTexture)
+	{
+		multiTextureShader = m_graphicsContext->getMultiTextureShader();
+		m_graphicsContext->setShader(multiTextureShader);
+		while(m_textureSlotNames.size() < textureSlotCount)
+		{
+			m_textureSlotNames.push_back("u_Texture" + util::intToStr(m_textureSlotNames.size()));
+		}
+	}
+
+	const bool depthTestEnabled = depthTest && m_graphicsContext->isEnabled(GraphicsContext::DEPTH_TEST);
+	if(depthTest && !depthTestEnabled)
+	{
+		m_graphicsContext->enable(GraphicsContext::DEPTH_TEST);
+	}
+
+	// Textures bound to each slot by the previous run
+	const TextureHandle noTexture = { 0 };
+	vector<TextureHandle> slotTextures(multiTexture ? textureSlotCount : 0, noTexture);
+
+	// Draw every run
+	depthIndex = 0;
+	for(uint run = 0; run + 1 < m_runStarts.size(); ++run)
+	{
+		const uint runStart = m_runStarts[run], runEnd = m_runStarts[run + 1];
+		const uint spriteCount = runEnd - runStart;
+		if(depthTest && !instanced && run > 0 && (m_sortKeys[runStart] >> 32) != (m_sortKeys[runStart - 1] >> 32))
+		{
+			depthIndex++;
+		}
+
+		// Sprites only hold texture handles. Skip the run if its texture was deleted after the sprites were drawn
+		const shared_ptr<Texture2D> texture = TextureRegistry::lock(multiTexture ? m_runTextures[run * textureSlotCount] : getSprite(m_sortKeys[runStart] & SORT_KEY_INDEX_MASK).m_texture);
+		if(!texture)
+		{
+			continue;
+		}
+
+		if(multiTexture)
+		{
+			// Bind the run's textures. Unused slots get the first texture
+			const TextureHandle *runTextures = &m_runTextures[run * textureSlotCount];
+			for(uint slot = 0; slot < textureSlotCount; ++slot)
+			{
+				const shared_ptr<Texture2D> slotTexture = slot == 0 ? texture : TextureRegistry::lock(runTextures[slot]);
+				if(slotTexture)
 				{
-					// For each texture
-					uint spriteCount = 0;
-					for(map<shared_ptr<Texture2D>, list<Sprite*>>::iterator itr2 = itr1->second.begin(); itr2 != itr1->second.end(); ++itr2)
+					multiTextureShader->setSampler2D(m_textureSlotNames[slot], slotTexture);
+					if(runTextures[slot] != slotTextures[slot])
 					{
-						// Batch all sprite vertex data
-						for(list<Sprite*>::iterator itr3 = itr2->second.begin(); itr3 != itr2->second.end(); ++itr3)
-						{
-							(*itr3)->getVertices(m_vertices + spriteCount * 4, m_indices + spriteCount * 6, spriteCount * 4);
-							spriteCount++;
-						}
-
-						// If we have sprites
-						if(spriteCount > 0)
-						{
-							// Draw textured primitives
-							m_graphicsContext->setTexture(itr2->first);
-							m_graphicsContext->drawIndexedPrimitives(GraphicsContext::PRIMITIVE_TRIANGLES, m_vertices, spriteCount * 4, m_indices, spriteCount * 6);
-							spriteCount = 0;
-						}
+						m_stats.textureBindCount++;
 					}
+					slotTextures[slot] = runTextures[slot];
+				}
+				else
+				{
+					multiTextureShader->setSampler2D(m_textureSlotNames[slot], texture);
+					slotTextures[slot] = runTextures[0];
 				}
 			}
-			break;
+		}
+		else
+		{
+			setTexture(texture);
+		}
 
-			case TEXTURE:
+		if(instanced)
+		{
+			// Draw instanced quads
+			m_graphicsContext->drawSpriteInstances(m_instances + runStart, spriteCount);
+			m_stats.bytesUploaded += spriteCount * sizeof(SpriteInstance);
+		}
+		else
+		{
+			// Place the run in front of all the depths that come after it
+			if(depthTest)
 			{
-				// Sort sprites by texture. Draw forwards and batch together
-				// similar textures, as long as they don't overlap a different texture.
-				/*uint prevIndex = 0;
-				Texture2DPtr prevTexture = m_sprites[0].texture;
-				for(uint i = 0; i < m_spriteCount; ++i)
-				{
-					if(m_sprites[i].texture != prevTexture)
-					{
-						m_graphicsContext.setTexture(m_sprites[i].texture);
-						m_graphicsContext.drawIndexedPrimitives(GraphicsContext::PRIMITIVE_TRIANGLES, m_vertices + prevIndex * 4, (i - prevIndex) * 4, m_indices + prevIndex * 6, (i - prevIndex) * 6);
-						prevIndex = i;
-					}
-				}
-				m_graphicsContext.setTexture(m_sprites[prevIndex].texture);
-				m_graphicsContext.drawIndexedPrimitives(GraphicsContext::PRIMITIVE_TRIANGLES, m_vertices + prevIndex * 4, (m_spriteCount - prevIndex) * 4, m_indices + prevIndex * 6, (m_spriteCount - prevIndex) * 6);*/
+				Matrix4 mat;
+				mat.translate(0.0f, 0.0f, getDepthZ(depthIndex, depthCount));
+				m_graphicsContext->pushMatrix(mat);
+			}
+
+			// Draw textured primitives
+			m_graphicsContext->drawIndexedPrimitives(GraphicsContext::PRIMITIVE_TRIANGLES, m_vertexBuffer, quadIndexBuffer, runStart * 6, spriteCount * 6);
+			m_stats.indexCount += spriteCount * 6;
+
+			if(depthTest)
+			{
+				m_graphicsContext->popMatrix();
 			}
-			break;
 		}
+		m_stats.drawCallCount++;
+		m_stats.spriteCount += spriteCount;
+		m_stats.vertexCount += spriteCount * 4;
+	}
+
+	if(depthTest && !depthTestEnabled)
+	{
+		m_graphicsContext->disable(GraphicsContext::DEPTH_TEST);
+	}
+}
+
+void SpriteBatch::generateVertices(const uint begin, const uint end) const
+{
+	for(uint i = begin; i < end; ++i)
+	{
+		getSprite(m_sortKeys[i] & SORT_KEY_INDEX_MASK).getVertices(m_vertices + i * 4);
+	}
+}
+
+void SpriteBatch::generateSlotVertices(const uint begin, const uint end) const
+{
+	SpriteVertex vertices[4];
+	for(uint i = begin; i < end; ++i)
+	{
+		getSprite(m_sortKeys[i] & SORT_KEY_INDEX_MASK).getVertices(vertices);
+		VertexPCTS *slotVertices = m_slotVertices + i * 4;
+		const float slot = float(m_textureSlots[i]);
+		for(int j = 0; j < 4; j++)
+		{
+			memcpy(&slotVertices[j], &vertices[j], sizeof(SpriteVertex));
+			slotVertices[j].slot = slot;
+		}
+	}
+}
+
+void SpriteBatch::addRunTextures()
+{
+	// Store the textures of the run in slot order, and start a new slot table
+	for(uint slot = 0; slot < m_textureSlotTable.getSlotCount(); ++slot)
+	{
+		TextureHandle texture = { 0 };
+		if(slot < m_textureSlotTable.getTextureCount())
+		{
+			texture = m_textureSlotTable.getTexture(slot);
+		}
+		m_runTextures.push_back(texture);
+	}
+	m_textureSlotTable.clear();
+}
+
+void SpriteBatch::generateInstances(const uint begin, const uint end) const
+{
+	const bool depthTest = m_state.mode == FRONT_TO_BACK;
+	for(uint i = begin; i < end; ++i)
+	{
+		getSprite(m_sortKeys[i] & SORT_KEY_INDEX_MASK).getInstance(m_instances + i);
+		if(depthTest) m_instances[i].z = m_depthZ[i];
 	}
-		
-	m_graphicsContext->popState();
-	m_graphicsContext = nullptr;
 }
 
 void SpriteBatch::flush()
@@ -176,39 +882,23 @@ void SpriteBatch::flush()
 		return;
 	}
 
-	// Draw current and begin new batch using the same state
+	// Draw current and begin new batch using the same state. The counters
+	// are kept after end() has added the flushed sprites to them
 	GraphicsContext *graphicsContext = m_graphicsContext;
 	end();
+	const Stats stats = m_stats;
 	begin(graphicsContext, m_state);
+	m_stats = stats;
 }
 
-// TODO: Can we make this more efficient?
-uint SpriteBatch::getTextureSwapCount() const
+void SpriteBatch::setTexture(const shared_ptr<Texture2D> &texture)
 {
-	// Separate sprites by depth and texture
-	map<float, map<shared_ptr<Texture2D>, list<Sprite*>>> layerTextureMap;
-	for(uint i = 0; i < m_spriteCount; ++i)
+	if(texture.get() != m_boundTexture)
 	{
-		Sprite *sprite = &m_sprites[i];
-		layerTextureMap[sprite->m_depth][sprite->m_texture].push_back(sprite);
+		m_boundTexture = texture.get();
+		m_stats.textureBindCount++;
 	}
-
-	// For each depth
-	uint textureSwapCount = 0;
-	for(map<float, map<shared_ptr<Texture2D>, list<Sprite*>>>::iterator itr1 = layerTextureMap.begin(); itr1 != layerTextureMap.end(); ++itr1)
-	{
-		// For each texture
-		for(map<shared_ptr<Texture2D>, list<Sprite*>>::iterator itr2 = itr1->second.begin(); itr2 != itr1->second.end(); ++itr2)
-		{
-			// If we have sprites
-			if(itr2->second.size() > 0)
-			{
-				++textureSwapCount;
-			}
-		}
-	}
-
-	return textureSwapCount;
+	m_graphicsContext->setTexture(texture);
 }
 
 END_SAUCE_NAMESPACE
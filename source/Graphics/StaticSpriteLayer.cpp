@@ -0,0 +1,236 @@
+//     _____                        ______             _            
+//    / ____|                      |  ____|           (_)           
+//   | (___   __ _ _   _  ___ ___  | |__   _ __   __ _ _ _ __   ___ 
+//    \___ \ / _` | | | |/ __/ _ \ |  __| | '_ \ / _` | | '_ \ / _ \
+//    ____) | (_| | |_| | (_|  __/ | |____| | | | (_| | | | | |  __/
+//   |_____/ \__,_|\__,_|\___\___| |______|_| |_|\__, |_|_| |_|\___|
+//                                                __/ |             
+//                                               |___/              
+// Made by Marcus "Bitsauce" Loo Vergara
+// 2011-2018 (C)
+
+#include <Sauce/Common.h>
+#include <Sauce/graphics.h>
+
+BEGIN_SAUCE_NAMESPACE
+
+// Number of sprites per region of the buffers. Dirty regions are uploaded as a whole
+const uint REGION_SIZE = 64;
+
+StaticSpriteLayer::StaticSpriteLayer() :
+	m_spriteCount(0),
+	m_vertexBuffer(nullptr),
+	m_hasDirtyRegions(false),
+	m_needsRebuild(false)
+{
+}
+
+StaticSpriteLayer::~StaticSpriteLayer()
+{
+	delete m_vertexBuffer;
+}
+
+uint StaticSpriteLayer::addSprite(const Sprite &sprite)
+{
+	uint id;
+	if(!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	else
+	{
+		id = m_entries.size();
+		m_entries.push_back(Entry());
+	}
+
+	m_entries[id].sprite = sprite;
+	m_entries[id].alive = true;
+	m_spriteCount++;
+	m_needsRebuild = true;
+	return id;
+}
+
+void StaticSpriteLayer::removeSprite(const uint id)
+{
+	if(id >= m_entries.size() || !m_entries[id].alive)
+	{
+		LOG("StaticSpriteLayer::removeSprite(): Invalid sprite id %i", id);
+		return;
+	}
+
+	m_entries[id].alive = false;
+	m_entries[id].sprite = Sprite();
+	m_freeIds.push_back(id);
+	m_spriteCount--;
+	m_needsRebuild = true;
+}
+
+void StaticSpriteLayer::setSprite(const uint id, const Sprite &sprite)
+{
+	if(id >= m_entries.size() || !m_entries[id].alive)
+	{
+		LOG("StaticSpriteLayer::setSprite(): Invalid sprite id %i", id);
+		return;
+	}
+
+	Entry &entry = m_entries[id];
+	entry.sprite = sprite;
+	if(m_needsRebuild) return;
+
+	// The sprite can be updated in place if it has a slot and keeps its place in the sort order
+	if(entry.builtTexture.isValid() && entry.builtTexture == sprite.m_texture && entry.builtDepth == sprite.m_depth)
+	{
+		m_dirtyRegions[entry.slot / REGION_SIZE] = true;
+		m_hasDirtyRegions = true;
+	}
+	else
+	{
+		m_needsRebuild = true;
+	}
+}
+
+const Sprite &StaticSpriteLayer::getSprite(const uint id) const
+{
+	if(id >= m_entries.size() || !m_entries[id].alive)
+	{
+		THROW("StaticSpriteLayer::getSprite(): Invalid sprite id %i", id);
+	}
+	return m_entries[id].sprite;
+}
+
+void StaticSpriteLayer::clear()
+{
+	m_entries.clear();
+	m_freeIds.clear();
+	m_spriteCount = 0;
+	m_needsRebuild = true;
+}
+
+void StaticSpriteLayer::draw(GraphicsContext *graphicsContext, const SpriteBatch::State &state)
+{
+	if(m_needsRebuild)
+	{
+		rebuild(graphicsContext);
+	}
+	else if(m_hasDirtyRegions)
+	{
+		updateDirtyRegions();
+	}
+
+	if(m_runs.empty()) return;
+
+	graphicsContext->pushState();
+	graphicsContext->clearMatrixStack();
+	graphicsContext->pushMatrix(state.transformationMatix);
+	graphicsContext->setBlendState(state.blendState);
+	graphicsContext->setShader(state.shader);
+
+	// Slot i is quad i of the shared quad index buffer
+	const IndexBuffer *quadIndexBuffer = graphicsContext->getQuadIndexBuffer(m_slotIds.size());
+	for(uint i = 0; i < m_runs.size(); ++i)
+	{
+		const Run &run = m_runs[i];
+		graphicsContext->setTexture(run.texture);
+		graphicsContext->drawIndexedPrimitives(GraphicsContext::PRIMITIVE_TRIANGLES, m_vertexBuffer, quadIndexBuffer, run.indexStart, run.indexCount);
+	}
+
+	graphicsContext->popState();
+}
+
+void StaticSpriteLayer::rebuild(GraphicsContext *graphicsContext)
+{
+	m_needsRebuild = false;
+	m_hasDirtyRegions = false;
+
+	// Collect sprites. Textures are ordered by first use
+	unordered_map<Uint32, uint> textureOrder;
+	m_slotIds.clear();
+	for(uint id = 0; id < m_entries.size(); ++id)
+	{
+		Entry &entry = m_entries[id];
+		entry.builtTexture.value = 0;
+		if(!entry.alive || !TextureRegistry::get(entry.sprite.m_texture)) continue;
+		textureOrder.insert(make_pair(entry.sprite.m_texture.value, uint(textureOrder.size())));
+		m_slotIds.push_back(id);
+	}
+
+	// Sort by depth, then texture, then id
+	sort(m_slotIds.begin(), m_slotIds.end(), [this, &textureOrder](const uint a, const uint b)
+	{
+		const Sprite &spriteA = m_entries[a].sprite, &spriteB = m_entries[b].sprite;
+		if(spriteA.m_depth != spriteB.m_depth) return spriteA.m_depth < spriteB.m_depth;
+		const uint textureA = textureOrder[spriteA.m_texture.value], textureB = textureOrder[spriteB.m_texture.value];
+		if(textureA != textureB) return textureA < textureB;
+		return a < b;
+	});
+
+	// Generate geometry and runs
+	const uint slotCount = m_slotIds.size();
+	m_vertices.resize(slotCount * 4);
+	m_runs.clear();
+	for(uint slot = 0; slot < slotCount; ++slot)
+	{
+		Entry &entry = m_entries[m_slotIds[slot]];
+		entry.slot = slot;
+		entry.builtTexture = entry.sprite.m_texture;
+		entry.builtDepth = entry.sprite.m_depth;
+
+		entry.sprite.getVertices(&m_vertices[slot * 4]);
+
+		if(m_runs.empty() || m_runs.back().texture->getHandle() != entry.sprite.m_texture)
+		{
+			// The layer keeps the textures of its runs alive
+			Run run;
+			run.texture = TextureRegistry::lock(entry.sprite.m_texture);
+			run.indexStart = slot * 6;
+			run.indexCount = 0;
+			m_runs.push_back(run);
+		}
+		m_runs.back().indexCount += 6;
+	}
+
+	m_dirtyRegions.assign((slotCount + REGION_SIZE - 1) / REGION_SIZE, false);
+
+	// Upload geometry
+	if(!m_vertexBuffer)
+	{
+		m_vertexBuffer = new StaticVertexBuffer(graphicsContext);
+	}
+
+	if(slotCount > 0)
+	{
+		m_vertexBuffer->setData(VertexPCT::getFormat(), &m_vertices[0], m_vertices.size());
+	}
+}
+
+void StaticSpriteLayer::updateDirtyRegions()
+{
+	m_hasDirtyRegions = false;
+
+	const uint slotCount = m_slotIds.size();
+	for(uint region = 0; region < m_dirtyRegions.size();)
+	{
+		if(!m_dirtyRegions[region])
+		{
+			region++;
+			continue;
+		}
+
+		// Merge neighbouring dirty regions into one upload
+		const uint slotStart = region * REGION_SIZE;
+		while(region < m_dirtyRegions.size() && m_dirtyRegions[region])
+		{
+			m_dirtyRegions[region++] = false;
+		}
+		const uint slotEnd = min(region * REGION_SIZE, slotCount);
+
+		for(uint slot = slotStart; slot < slotEnd; ++slot)
+		{
+			m_entries[m_slotIds[slot]].sprite.getVertices(&m_vertices[slot * 4]);
+		}
+		m_vertexBuffer->setSubData(slotStart * 4, &m_vertices[slotStart * 4], (slotEnd - slotStart) * 4);
+	}
+}
+
+END_SAUCE_NAMESPACE
@@ -16,6 +16,109 @@
 
 BEGIN_SAUCE_NAMESPACE
 
+// Texture handle layout
+const uint TEXTURE_HANDLE_SLOT_BITS = 20;
+const uint TEXTURE_HANDLE_SLOT_MASK = (1 << TEXTURE_HANDLE_SLOT_BITS) - 1;
+const uint TEXTURE_HANDLE_GENERATION_MASK = (1 << (32 - TEXTURE_HANDLE_SLOT_BITS)) - 1;
+
+// Registry slots per chunk
+const uint TEXTURE_REGISTRY_CHUNK_BITS = 10;
+const uint TEXTURE_REGISTRY_CHUNK_SIZE = 1 << TEXTURE_REGISTRY_CHUNK_BITS;
+const uint TEXTURE_REGISTRY_CHUNK_COUNT = 1 << (TEXTURE_HANDLE_SLOT_BITS - TEXTURE_REGISTRY_CHUNK_BITS);
+
+TextureRegistry::Entry *TextureRegistry::s_chunks[TEXTURE_REGISTRY_CHUNK_COUNT] = { 0 };
+uint TextureRegistry::s_slotCount = 0;
+queue<uint> TextureRegistry::s_freeSlots;
+uint TextureRegistry::s_retiredSlotCount = 0;
+mutex TextureRegistry::s_mutex;
+
+TextureHandle TextureRegistry::add(const shared_ptr<Texture2D> &texture)
+{
+	TextureHandle handle = { 0 };
+	if(!texture) return handle;
+	if(texture->m_handle.isValid()) return texture->m_handle;
+
+	lock_guard<mutex> lock(s_mutex);
+	if(texture->m_handle.isValid()) return texture->m_handle;
+
+	// Reuse a free slot or take a new one
+	uint slot;
+	if(!s_freeSlots.empty())
+	{
+		slot = s_freeSlots.front();
+		s_freeSlots.pop();
+	}
+	else
+	{
+		if(s_slotCount >= TEXTURE_REGISTRY_CHUNK_SIZE * TEXTURE_REGISTRY_CHUNK_COUNT)
+		{
+			LOG("TextureRegistry::add(): Out of texture handles.");
+			return handle;
+		}
+
+		slot = s_slotCount++;
+		if(!s_chunks[slot >> TEXTURE_REGISTRY_CHUNK_BITS])
+		{
+			s_chunks[slot >> TEXTURE_REGISTRY_CHUNK_BITS] = new Entry[TEXTURE_REGISTRY_CHUNK_SIZE];
+		}
+	}
+
+	Entry &entry = s_chunks[slot >> TEXTURE_REGISTRY_CHUNK_BITS][slot & (TEXTURE_REGISTRY_CHUNK_SIZE - 1)];
+	entry.texture = texture.get();
+	entry.owner = texture;
+	handle.value = (entry.generation << TEXTURE_HANDLE_SLOT_BITS) | slot;
+	texture->m_handle = handle;
+	return handle;
+}
+
+TextureRegistry::Entry *TextureRegistry::getEntry(const TextureHandle handle)
+{
+	const uint slot = handle.value & TEXTURE_HANDLE_SLOT_MASK;
+	Entry *chunk = s_chunks[slot >> TEXTURE_REGISTRY_CHUNK_BITS];
+	if(!chunk) return nullptr;
+	Entry *entry = &chunk[slot & (TEXTURE_REGISTRY_CHUNK_SIZE - 1)];
+	return entry->generation == (handle.value >> TEXTURE_HANDLE_SLOT_BITS) ? entry : nullptr;
+}
+
+Texture2D *TextureRegistry::get(const TextureHandle handle)
+{
+	const Entry *entry = getEntry(handle);
+	return entry ? entry->texture : nullptr;
+}
+
+shared_ptr<Texture2D> TextureRegistry::lock(const TextureHandle handle)
+{
+	const Entry *entry = getEntry(handle);
+	return entry ? entry->owner.lock() : nullptr;
+}
+
+uint TextureRegistry::getTextureCount()
+{
+	lock_guard<mutex> lock(s_mutex);
+	return s_slotCount - s_freeSlots.size() - s_retiredSlotCount;
+}
+
+void TextureRegistry::remove(const TextureHandle handle)
+{
+	lock_guard<mutex> lock(s_mutex);
+	Entry *entry = getEntry(handle);
+	if(!entry) return;
+
+	// Bump the generation so that old handles no longer match. Generation 0 is never
+	// used, so that a valid handle is never 0
+	entry->texture = nullptr;
+	entry->owner.reset();
+	entry->generation = (entry->generation + 1) & TEXTURE_HANDLE_GENERATION_MASK;
+	if(entry->generation == 0)
+	{
+		// Reusing the slot would bring back generations that old handles may still
+		// have, making them resolve to an unrelated texture. Never use the slot again
+		s_retiredSlotCount++;
+		return;
+	}
+	s_freeSlots.push(handle.value & TEXTURE_HANDLE_SLOT_MASK);
+}
+
 Texture2D::Texture2D():
 	m_filter(NEAREST),
 	m_wrapping(CLAMP_TO_BORDER),
@@ -23,18 +126,27 @@ Texture2D::Texture2D():
 	m_mipmapsGenerated(false),
 	m_width(0),
 	m_height(0),
-	m_pixelFormat()
+	m_pixelFormat(),
+	m_version(0),
+	m_renderTarget(false),
+	m_batchingContext(nullptr)
 {
+	m_handle.value = 0;
 }
 
 Texture2D::~Texture2D()
 {
+	if(m_handle.isValid())
+	{
+		TextureRegistry::remove(m_handle);
+	}
 }
 
 void Texture2D::enableMipmaps()
 {
 	if(!m_mipmaps)
 	{
+		flushPrimitives();
 		m_mipmaps = true;
 		updateFiltering();
 	}
@@ -48,6 +160,7 @@ void Texture2D::disableMipmaps()
 {
 	if(m_mipmaps)
 	{
+		flushPrimitives();
 		m_mipmaps = false;
 		updateFiltering();
 	}
@@ -61,6 +174,7 @@ void Texture2D::setFiltering(const TextureFilter filter)
 {
 	if(m_filter != filter)
 	{
+		flushPrimitives();
 		m_filter = filter;
 		updateFiltering();
 	}
@@ -79,6 +193,7 @@ void Texture2D::setWrapping(const TextureWrapping wrapping)
 {
 	if(m_wrapping != wrapping)
 	{
+		flushPrimitives();
 		m_wrapping = wrapping;
 		updateFiltering();
 	}
@@ -89,6 +204,14 @@ Texture2D::TextureWrapping Texture2D::getWrapping() const
 	return TextureWrapping(m_wrapping);
 }
 
+void Texture2D::flushPrimitives()
+{
+	if(m_batchingContext)
+	{
+		m_batchingContext->flushPrimitives();
+	}
+}
+
 uint Texture2D::getWidth() const
 {
 	return m_width;
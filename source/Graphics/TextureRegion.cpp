@@ -31,29 +31,6 @@ TextureRegion::TextureRegion(const float u0, const float v0, const float u1, con
 {
 }
 
-TextureRegion::TextureRegion(const TextureRegion &other) :
-	uv0(0.0f),
-	uv1(0.0f)
-{
-	*this = other;
-}
-
-TextureRegion &TextureRegion::operator=(const TextureRegion &other)
-{
-	if(this == &other) {
-		return *this;
-	}
-	
-	uv0 = other.uv0;
-	uv1 = other.uv1;
-	
-	return *this;
-}
-
-TextureRegion::~TextureRegion()
-{
-}
-	
 void TextureRegion::setRegion(const Vector2F &uv0, const Vector2F &uv1)
 {
 	this->uv0 = uv0;
@@ -128,35 +128,28 @@ bool VertexFormat::operator==(const VertexFormat &other)
 **	Vertex															**
 **********************************************************************/
 
-Vertex::Vertex() :
-	m_data(0)
+Vertex::Vertex()
 {
 	setFormat(VertexFormat::s_vct);
 }
 
 Vertex::Vertex(const Vertex &other) :
-	m_data(0)
+	m_format(other.m_format)
 {
-	setFormat(other.m_format);
 	memcpy(m_data, other.m_data, m_format.getVertexSizeInBytes());
 }
 
-Vertex::Vertex(const VertexFormat &fmt) :
-	m_data(0),
-	m_format(fmt)
+Vertex::Vertex(const VertexFormat &fmt)
 {
 	setFormat(fmt);
 }
 
 Vertex::~Vertex()
 {
-	delete[] m_data;
 }
 
 void Vertex::setFormat(const VertexFormat &fmt)
 {
-	delete[] m_data;
-	m_data = new char[fmt.getVertexSizeInBytes()];
 	memset(m_data, 0, fmt.getVertexSizeInBytes());
 	m_format = fmt;
 }
@@ -544,7 +537,7 @@ void Vertex::set4b(const VertexAttribute attrib, const char v0, const char v1, c
 	}
 }
 
-void Vertex::setData(const char *data) const
+void Vertex::setData(const char *data)
 {
 	memcpy(m_data, data, m_format.getVertexSizeInBytes());
 }
@@ -554,12 +547,23 @@ void Vertex::getData(char *data) const
 	memcpy(data, m_data, m_format.getVertexSizeInBytes());
 }
 
+void Vertex::pack(const Vertex *vertices, const uint vertexCount, vector<char> &data)
+{
+	const uint vertexSizeInBytes = vertices->m_format.getVertexSizeInBytes();
+	if(data.size() < vertexCount * vertexSizeInBytes)
+	{
+		data.resize(vertexCount * vertexSizeInBytes);
+	}
+
+	for(uint i = 0; i < vertexCount; ++i)
+	{
+		memcpy(&data[i * vertexSizeInBytes], vertices[i].m_data, vertexSizeInBytes);
+	}
+}
+
 Vertex &Vertex::operator=(const Vertex &other)
 {
 	m_format = other.m_format;
-
-	delete[] m_data;
-	m_data = new char[m_format.getVertexSizeInBytes()];
 	memcpy(m_data, other.m_data, m_format.getVertexSizeInBytes());
 
 	return *this;
@@ -14,83 +14,90 @@
 
 BEGIN_SAUCE_NAMESPACE
 
-VertexBuffer::VertexBuffer(const BufferType type) :
+VertexBuffer::VertexBuffer(GraphicsContext *graphicsContext, const BufferType type) :
+	m_graphicsContext(graphicsContext),
+	m_id(graphicsContext->createBuffer()),
 	m_format(),
 	m_type(type),
 	m_size(0)
 {
-	glGenBuffers(1, &m_id);
 }
 
 VertexBuffer::~VertexBuffer()
 {
-	glDeleteBuffers(1, &m_id);
+	m_graphicsContext->deleteBuffer(m_id);
 }
 
+// Vertex data packed by the Vertex overloads. Buffers are only used from the thread owning the graphics context
+static vector<char> s_packedVertices;
+
 void VertexBuffer::setData(const Vertex *vertices, const uint vertexCount)
 {
-	// Get vertex data
-	m_format = vertices->getFormat();
-	char *vertexData = new char[vertexCount * m_format.getVertexSizeInBytes()];
-	for(uint i = 0; i < vertexCount; ++i)
+	if(vertexCount == 0)
 	{
-		vertices[i].getData(vertexData + i * m_format.getVertexSizeInBytes());
+		setData(vertices ? vertices->getFormat() : m_format, nullptr, 0);
+		return;
 	}
 
+	Vertex::pack(vertices, vertexCount, s_packedVertices);
+	setData(vertices->getFormat(), &s_packedVertices[0], vertexCount);
+}
+
+void VertexBuffer::setData(const VertexFormat &fmt, const void *vertexData, const uint vertexCount)
+{
+	m_format = fmt;
+
+	// Upload vertex data
 	if(vertexCount > 0)
 	{
-		// Upload vertex data
-		glBindBuffer(GL_ARRAY_BUFFER, m_id);
-		glBufferData(GL_ARRAY_BUFFER, vertexCount * m_format.getVertexSizeInBytes(), vertexData, m_type);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		m_graphicsContext->setBufferData(GraphicsContext::VERTEX_BUFFER_TARGET, m_id, vertexData, vertexCount * m_format.getVertexSizeInBytes(), m_type == DYNAMIC_BUFFER);
 	}
 
-	delete[] vertexData;
-
 	m_size = vertexCount;
 }
 
+void VertexBuffer::setSubData(const uint startIdx, const void *vertexData, const uint vertexCount)
+{
+	if(startIdx + vertexCount > m_size)
+	{
+		LOG("VertexBuffer::setSubData(): Range is out of bounds");
+		return;
+	}
+
+	m_graphicsContext->setBufferSubData(GraphicsContext::VERTEX_BUFFER_TARGET, m_id, startIdx * m_format.getVertexSizeInBytes(), vertexData, vertexCount * m_format.getVertexSizeInBytes());
+}
+
 VertexFormat VertexBuffer::getVertexFormat() const
 {
 	return m_format;
 }
 
-DynamicVertexBuffer::DynamicVertexBuffer() :
-	VertexBuffer(DYNAMIC_BUFFER)
+DynamicVertexBuffer::DynamicVertexBuffer(GraphicsContext *graphicsContext) :
+	VertexBuffer(graphicsContext, DYNAMIC_BUFFER)
 {
 }
 
-DynamicVertexBuffer::DynamicVertexBuffer(const Vertex *vertices, const uint vertexCount) :
-	VertexBuffer(DYNAMIC_BUFFER)
+DynamicVertexBuffer::DynamicVertexBuffer(GraphicsContext *graphicsContext, const Vertex *vertices, const uint vertexCount) :
+	VertexBuffer(graphicsContext, DYNAMIC_BUFFER)
 {
 	setData(vertices, vertexCount);
 }
 
 void DynamicVertexBuffer::modifyData(const uint startIdx, Vertex *vertices, const uint vertexCount)
 {
-	if(!(m_format == vertices->getFormat())) return;
-
-	// Get vertex data
-	char *vertexData = new char[vertexCount * m_format.getVertexSizeInBytes()];
-	for(uint i = 0; i < vertexCount; ++i)
-	{
-		vertices[i].getData(vertexData + i * m_format.getVertexSizeInBytes());
-	}
-
-	glBindBuffer(GL_ARRAY_BUFFER, m_id);
-	glBufferSubData(GL_ARRAY_BUFFER, startIdx * getVertexFormat().getVertexSizeInBytes(), vertexCount * getVertexFormat().getVertexSizeInBytes(), vertexData);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if(vertexCount == 0 || !(m_format == vertices->getFormat())) return;
 
-	delete[] vertexData;
+	Vertex::pack(vertices, vertexCount, s_packedVertices);
+	setSubData(startIdx, &s_packedVertices[0], vertexCount);
 }
 
-StaticVertexBuffer::StaticVertexBuffer() :
-	VertexBuffer(STATIC_BUFFER)
+StaticVertexBuffer::StaticVertexBuffer(GraphicsContext *graphicsContext) :
+	VertexBuffer(graphicsContext, STATIC_BUFFER)
 {
 }
 
-StaticVertexBuffer::StaticVertexBuffer(const Vertex *vertices, const uint vertexCount) :
-	VertexBuffer(STATIC_BUFFER)
+StaticVertexBuffer::StaticVertexBuffer(GraphicsContext *graphicsContext, const Vertex *vertices, const uint vertexCount) :
+	VertexBuffer(graphicsContext, STATIC_BUFFER)
 {
 	setData(vertices, vertexCount);
 }
@@ -98,56 +105,64 @@ StaticVertexBuffer::StaticVertexBuffer(const Vertex *vertices, const uint vertex
 
 // -------------------------------------------------------------------------------------
 
-IndexBuffer::IndexBuffer(const BufferType type) :
+IndexBuffer::IndexBuffer(GraphicsContext *graphicsContext, const BufferType type) :
+	m_graphicsContext(graphicsContext),
+	m_id(graphicsContext->createBuffer()),
 	m_type(type),
 	m_size(0)
 {
-	glGenBuffers(1, &m_id);
 }
 
 IndexBuffer::~IndexBuffer()
 {
-	glDeleteBuffers(1, &m_id);
+	m_graphicsContext->deleteBuffer(m_id);
 }
 
 void IndexBuffer::setData(const uint *indices, const uint indexCount)
 {
+	// Upload index data
 	if(indexCount > 0)
 	{
-		// Upload index data
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_id);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(uint), indices, m_type);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		m_graphicsContext->setBufferData(GraphicsContext::INDEX_BUFFER_TARGET, m_id, indices, indexCount * sizeof(uint), m_type == DYNAMIC_BUFFER);
 	}
 	
 	m_size = indexCount;
 }
 
-DynamicIndexBuffer::DynamicIndexBuffer() :
-	IndexBuffer(DYNAMIC_BUFFER)
+void IndexBuffer::setSubData(const uint startIdx, const uint *indices, const uint indexCount)
+{
+	if(startIdx + indexCount > m_size)
+	{
+		LOG("IndexBuffer::setSubData(): Range is out of bounds");
+		return;
+	}
+
+	m_graphicsContext->setBufferSubData(GraphicsContext::INDEX_BUFFER_TARGET, m_id, startIdx * sizeof(uint), indices, indexCount * sizeof(uint));
+}
+
+DynamicIndexBuffer::DynamicIndexBuffer(GraphicsContext *graphicsContext) :
+	IndexBuffer(graphicsContext, DYNAMIC_BUFFER)
 {
 }
 
-DynamicIndexBuffer::DynamicIndexBuffer(const uint *indices, const uint indexCount) :
-	IndexBuffer(DYNAMIC_BUFFER)
+DynamicIndexBuffer::DynamicIndexBuffer(GraphicsContext *graphicsContext, const uint *indices, const uint indexCount) :
+	IndexBuffer(graphicsContext, DYNAMIC_BUFFER)
 {
 	setData(indices, indexCount);
 }
 
 void DynamicIndexBuffer::modifyData(const uint startIdx, uint *indices, const uint indexCount)
 {
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_id);
-	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, startIdx * sizeof(uint), indexCount * sizeof(uint), indices);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	setSubData(startIdx, indices, indexCount);
 }
 
-StaticIndexBuffer::StaticIndexBuffer() :
-	IndexBuffer(STATIC_BUFFER)
+StaticIndexBuffer::StaticIndexBuffer(GraphicsContext *graphicsContext) :
+	IndexBuffer(graphicsContext, STATIC_BUFFER)
 {
 }
 
-StaticIndexBuffer::StaticIndexBuffer(const uint *indices, const uint indexCount) :
-	IndexBuffer(STATIC_BUFFER)
+StaticIndexBuffer::StaticIndexBuffer(GraphicsContext *graphicsContext, const uint *indices, const uint indexCount) :
+	IndexBuffer(graphicsContext, STATIC_BUFFER)
 {
 	setData(indices, indexCount);
 }
@@ -34,6 +34,12 @@ const RectanglePacker::Result RectanglePacker::pack()
 		}
 	}
 
+	// The tallest rectangle must fit
+	if(m_maxHeight > 0 && maxHeight > (uint) m_maxHeight)
+	{
+		return Result();
+	}
+
 	// Setup loop vars
 	uint canvasWidth = m_maxWidth, canvasHeight = maxHeight;
 	vector<Rect<int>> cells;
@@ -62,6 +68,12 @@ const RectanglePacker::Result RectanglePacker::pack()
 
 		if(bestCellIdx < 0)
 		{
+			// Narrower canvases only get taller, so stop at the max height
+			if(m_maxHeight > 0 && canvasHeight >= (uint) m_maxHeight)
+			{
+				break;
+			}
+
 			// If no cell was found, add more to the height and retry
 			cells.clear();
 			cells.push_back(Rect<int>(0, 0, canvasWidth, ++canvasHeight));